@@ -408,3 +408,101 @@ ms_crc32c (const uint8_t* input, int length, uint32_t previousCRC32C)
   else
     return s_crc32c_sb8(input, length, previousCRC32C);
 } /* End of ms_crc32c() */
+
+
+/* Multiply two polynomials modulo the CRC-32C polynomial, in the
+ * reflected bit order of the CRC where x^0 is the high bit. */
+static uint32_t s_crc32c_multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLYNOMIAL : b >> 1;
+    }
+
+    return p;
+}
+
+/* Calculate x^(8 * count) modulo the CRC-32C polynomial, the operator
+ * for appending count zero bytes to a message. */
+static uint32_t s_crc32c_zerobytes(uint64_t count) {
+    uint32_t p = (uint32_t)1 << 31; /* x^0 */
+    uint32_t sq = (uint32_t)1 << 23; /* x^8 */
+
+    while (count) {
+        if (count & 1)
+            p = s_crc32c_multmodp(sq, p);
+        sq = s_crc32c_multmodp(sq, sq);
+        count >>= 1;
+    }
+
+    return p;
+}
+
+
+/************************************************************************
+ *
+ * Update the CRC-32C of a buffer for a change of bytes within it,
+ * without calculating over the entire buffer.
+ *
+ * The CRC is linear: the CRCs of two equal-length buffers differ by
+ * the unconditioned CRC of their difference.  The difference is
+ * non-zero only over the changed bytes, so it is calculated over those
+ * bytes and then advanced over the bytes that follow them in the
+ * buffer, which takes time logarithmic in that length.
+ *
+ * The crc is the CRC-32C of the buffer with the old data, count bytes
+ * are changed from olddata to newdata and trailing is the number of
+ * bytes in the buffer after the changed bytes.
+ *
+ * Return the CRC value of the buffer with the new data.
+ ************************************************************************/
+uint32_t
+ms_crc32c_patch (uint32_t crc, const uint8_t *olddata, const uint8_t *newdata,
+                 int count, uint64_t trailing)
+{
+  uint32_t delta = 0;
+  int idx;
+
+  if (!olddata || !newdata || count <= 0)
+    return crc;
+
+  for (idx = 0; idx < count; idx++)
+    delta = CRC32C_TABLE[0][(delta ^ olddata[idx] ^ newdata[idx]) & 0xff] ^ (delta >> 8);
+
+  if (delta == 0)
+    return crc;
+
+  return crc ^ s_crc32c_multmodp(s_crc32c_zerobytes(trailing), delta);
+} /* End of ms_crc32c_patch() */
+
+
+/************************************************************************
+ *
+ * Combine the CRC-32C values of two consecutive buffers, without
+ * calculating over the data.
+ *
+ * Following the same linearity used by ms_crc32c_patch(), the CRC of
+ * the first buffer is advanced over the length of the second buffer
+ * and added to the CRC of the second buffer, which takes time
+ * logarithmic in that length.
+ *
+ * The crc1 is the CRC-32C of the first buffer, crc2 the CRC-32C of the
+ * second buffer of length2 bytes.
+ *
+ * Return the CRC value of the first buffer followed by the second.
+ ************************************************************************/
+uint32_t
+ms_crc32c_combine (uint32_t crc1, uint32_t crc2, uint64_t length2)
+{
+  if (length2 == 0)
+    return crc1;
+
+  return s_crc32c_multmodp(s_crc32c_zerobytes(length2), crc1) ^ crc2;
+} /* End of ms_crc32c_combine() */
@@ -28,6 +28,7 @@
 
 #include "libmseed.h"
 #include "msio.h"
+#include "unpack.h"
 
 /* Skip length in bytes when skipping non-data */
 #define SKIPLEN 1
@@ -39,6 +40,7 @@ MS3FileParam gMS3FileParam = MS3FileParam_INITIALIZER;
 #define MSFP_RANGEAPPLIED 0x0001  //!< Byte ranging has been applied
 
 static char *parse_pathname_range (const char *string, int64_t *start, int64_t *end);
+static int skip_nondata (const char *buffer, int length);
 
 /*****************************************************************/ /**
  * @brief Run-time test for URL support in libmseed.
@@ -97,6 +99,8 @@ ms3_mstl_init_fd (int fd)
     return NULL;
   }
 
+  msfp->readsize = (int)msio_readsize (&msfp->input);
+
   return msfp;
 }
 
@@ -188,6 +192,52 @@ ms3_shift_msfp (MS3FileParam *msfp, int shift)
   return;
 } /* End of ms3_shift_msfp() */
 
+/* Initial size of the read buffer, grown as needed up to MAXRECLEN */
+#define READBUFFER_MINSIZE 65536
+
+/***************************************************************************
+ * Grow the read buffer of a ::MS3FileParam to at least 'needed' bytes.
+ *
+ * The buffer starts at READBUFFER_MINSIZE and doubles, rounded to a
+ * multiple of the preferred read size, so that streams of small
+ * records never use more than a few blocks of memory.  The size is
+ * bounded by MAXRECLEN plus one preferred read.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+grow_readbuffer (MS3FileParam *msfp, size_t needed, size_t prefsize)
+{
+  size_t maxsize = MAXRECLEN + prefsize;
+  size_t newsize;
+  char *newbuffer;
+
+  newsize = (msfp->readbuffersize > 0) ? (size_t)msfp->readbuffersize : READBUFFER_MINSIZE;
+
+  while (newsize < needed)
+    newsize *= 2;
+
+  if (newsize % prefsize)
+    newsize += prefsize - (newsize % prefsize);
+
+  if (newsize > maxsize)
+    newsize = maxsize;
+
+  if (newsize <= (size_t)msfp->readbuffersize)
+    return 0;
+
+  if ((newbuffer = (char *)libmseed_memory.realloc (msfp->readbuffer, newsize)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for read buffer\n");
+    return -1;
+  }
+
+  msfp->readbuffer     = newbuffer;
+  msfp->readbuffersize = (int)newsize;
+
+  return 0;
+} /* End of grow_readbuffer() */
+
 /* Macro to calculate length of unprocessed buffer */
 #define MSFPBUFLEN(MSFP) (MSFP->readlength - MSFP->readoffset)
 
@@ -265,6 +315,15 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
   int readsize  = 0;
   int readcount = 0;
   int retcode   = MS_NOERROR;
+  size_t prefsize;
+  size_t needed;
+
+  /* Header fields for selection */
+  char sid[LM_SIDLEN];
+  nstime_t starttime;
+  nstime_t endtime;
+  uint8_t pubversion;
+  int64_t reclen;
 
   if (!ppmsr || !ppmsfp)
   {
@@ -317,16 +376,6 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
     return MS_NOERROR;
   }
 
-  /* Allocate reading buffer */
-  if (msfp->readbuffer == NULL)
-  {
-    if (!(msfp->readbuffer = (char *)libmseed_memory.malloc (MAXRECLEN)))
-    {
-      ms_log (2, "Cannot allocate memory for read buffer\n");
-      return MS_GENERROR;
-    }
-  }
-
   /* Open the stream if needed, use stdin if path is "-" */
   if (msfp->input.handle == NULL)
   {
@@ -368,6 +417,9 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
         msfp->streampos = msfp->startoffset;
       }
     }
+
+    /* Determine preferred read size once, avoiding a stat() per read */
+    msfp->readsize = (int)msio_readsize (&msfp->input);
   }
 
   /* Defer data unpacking if selections are used by unsetting MSF_UNPACKDATA */
@@ -400,8 +452,22 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
         ms3_shift_msfp (msfp, msfp->readoffset);
       }
 
-      /* Determine read size */
-      readsize = (MAXRECLEN - msfp->readlength);
+      /* Grow buffer to hold unprocessed data plus the larger of the data
+       * needed for the current record or a preferred size read */
+      prefsize = (msfp->readsize > 0) ? (size_t)msfp->readsize : msio_readsize (&msfp->input);
+      needed = msfp->readlength + ((parseval > 0 && (size_t)parseval > prefsize) ? (size_t)parseval : prefsize);
+
+      if (needed > (size_t)msfp->readbuffersize && grow_readbuffer (msfp, needed, prefsize))
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+
+      /* Determine read size, in whole multiples of the preferred size when possible */
+      readsize = (msfp->readbuffersize - msfp->readlength);
+
+      if ((size_t)readsize > prefsize)
+        readsize -= readsize % prefsize;
 
       /* Read data into record buffer */
       readcount = (int)msio_fread (&msfp->input, msfp->readbuffer + msfp->readlength, readsize);
@@ -417,6 +483,27 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
       msfp->readlength += readcount;
     }
 
+    /* Reject records not matching selections using header fields, before
+     * the complete parse and CRC validation */
+    if (selections && MSFPBUFLEN (msfp) >= MINRECLEN &&
+        (reclen = ms3_recordselectfields (MSFPREADPTR (msfp), MSFPBUFLEN (msfp), sid, sizeof (sid),
+                                          &starttime, &endtime, &pubversion)) > 0 &&
+        !ms3_matchselect (selections, sid, starttime, endtime, pubversion, NULL))
+    {
+      if (verbose > 1)
+      {
+        ms_log (0, "Skipping (selection) record for %s (%" PRId64 " bytes) starting at offset %" PRId64 "\n",
+                sid, reclen, msfp->streampos);
+      }
+
+      /* Skip record length bytes, update reading offset and file position */
+      msfp->readoffset += reclen;
+      msfp->streampos += reclen;
+      parseval = 0;
+
+      continue;
+    }
+
     /* Attempt to parse record from buffer */
     if (MSFPBUFLEN (msfp) >= MINRECLEN)
     {
@@ -476,15 +563,17 @@ ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *msp
         /* Skip non-data if requested */
         if (flags & MSF_SKIPNOTDATA)
         {
+          /* Skip to next plausible record header, update reading offset and file position */
+          int skiplen = skip_nondata (MSFPREADPTR (msfp), MSFPBUFLEN (msfp));
+
           if (verbose > 1)
           {
             ms_log (0, "Skipped %d bytes of non-data record at byte offset %" PRId64 "\n",
-                    SKIPLEN, msfp->streampos);
+                    skiplen, msfp->streampos);
           }
 
-          /* Skip SKIPLEN bytes, update reading offset and file position */
-          msfp->readoffset += SKIPLEN;
-          msfp->streampos += SKIPLEN;
+          msfp->readoffset += skiplen;
+          msfp->streampos += skiplen;
         }
         /* Parsing errors */
         else if (parseval == MS_NOTSEED)
@@ -746,6 +835,35 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
   return retcode;
 } /* End of ms3_readtracelist_selection() */
 
+/*****************************************************************/ /**
+ * @brief Initialize URL support for use by multiple threads.
+ *
+ * The URL support of the library, including libcurl itself, is
+ * otherwise initialized when the first URL is opened, which is not
+ * safe when URLs are first opened from multiple threads
+ * concurrently.  Programs that read URLs in threads should call this
+ * routine once before starting them.
+ *
+ * An error will be returned when the library was not compiled with
+ * URL support.
+ *
+ * @returns 0 on succes and a negative library error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *
+ * @sa @ref thread-safety
+ *********************************************************************/
+int
+ms3_url_init (void)
+{
+#if !defined(LIBMSEED_URL)
+  ms_log (2, "URL support not included in library\n");
+  return -1;
+#else
+  return msio_url_init ();
+#endif
+} /* End of ms3_url_init() */
+
 /*****************************************************************/ /**
  * @brief Set User-Agent header for URL-based requests.
  *
@@ -854,6 +972,305 @@ ms3_url_freeheaders (void)
 #endif
 } /* End of ms3_url_freeheaders() */
 
+/*****************************************************************/ /**
+ * @brief Set directory for spooling URL-based data to local files.
+ *
+ * When a spool directory is set, data read from URLs are also
+ * written to a local file in the directory so that records can be
+ * re-read without another network transfer, see ms3_url_spoolfile().
+ * Data read from gzip- or zstd-compressed files are likewise spooled
+ * after decompression.
+ *
+ * The ETag and Last-Modified values of a completed transfer are
+ * retained with the spool and used for a conditional request when
+ * the same URL and range is read again.  If the server responds that
+ * the resource is not modified (304) the spool file is read instead.
+ *
+ * The directory must exist.  Set \a directory to NULL to disable
+ * spooling.
+ *
+ * @param[in] directory Existing directory for spool files
+ *
+ * @returns 0 on succes and a negative library error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+ms3_url_spooldir (const char *directory)
+{
+  return msio_url_spooldir (directory);
+} /* End of ms3_url_spooldir() */
+
+/*****************************************************************/ /**
+ * @brief Determine the local spool file for a URL.
+ *
+ * Determine the spool file for data read from the URL (or compressed
+ * file) \a mspath, which may include a byte range suffix as described
+ * for ::MSF_PNAMERANGE.  Data in the spool file are at the same
+ * offsets as in the (decompressed) source, allowing records to be
+ * re-read using their file offsets.
+ *
+ * The \a spoolfile buffer is populated even when the spool file is
+ * not usable.
+ *
+ * @param[in] mspath URL or file, optionally including a byte range
+ * @param[out] spoolfile Buffer for the spool file path
+ * @param[in] size Size of \a spoolfile buffer
+ *
+ * @returns 0 when the spool file was written or validated since the
+ * spool directory was set and a negative value otherwise.
+ *********************************************************************/
+int
+ms3_url_spoolfile (const char *mspath, char *spoolfile, size_t size)
+{
+  char path[512];
+  char *pathname_range;
+  int64_t startoffset = 0;
+  int64_t endoffset = 0;
+
+  if (!mspath || !spoolfile)
+    return -1;
+
+  strncpy (path, mspath, sizeof (path) - 1);
+  path[sizeof (path) - 1] = '\0';
+
+  if ((pathname_range = parse_pathname_range (mspath, &startoffset, &endoffset)) &&
+      (size_t)(pathname_range - mspath) < sizeof (path))
+    path[pathname_range - mspath] = '\0';
+
+  return msio_url_spoolfile (path, startoffset, endoffset, spoolfile, size);
+} /* End of ms3_url_spoolfile() */
+
+/*****************************************************************/ /**
+ * @brief Fetch URLs concurrently into the spool directory.
+ *
+ * Fetch the data for \a count URLs in \a mspaths concurrently,
+ * storing them in the spool directory set with ms3_url_spooldir().
+ * Each URL may include a byte range suffix as described for
+ * ::MSF_PNAMERANGE.  Subsequent reading of the URLs (with
+ * ::MSF_PNAMERANGE) in this process uses the spooled data without
+ * further requests.
+ *
+ * Transfers share a pool of up to \a maxconnections connections
+ * (unlimited if 0).  When the server reports the length of an object
+ * and accepts byte ranges, objects larger than \a splitsize bytes are
+ * fetched as concurrent range requests.  Set \a splitsize to 0 to
+ * disable splitting.
+ *
+ * A previously spooled URL is not fetched again if the ETag or
+ * Last-Modified values reported by the server are unchanged.
+ *
+ * URLs that cannot be prefetched are not an error, they are fetched
+ * when read.
+ *
+ * An error will be returned when the library was not compiled with
+ * URL support.
+ *
+ * @param[in] mspaths URLs, optionally including byte ranges
+ * @param[in] count Number of entries in \a mspaths
+ * @param[in] maxconnections Maximum concurrent connections, 0 for no limit
+ * @param[in] splitsize Size of range requests for large objects, 0 to disable
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns Number of URLs spooled on success and a negative library
+ * error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+ms3_url_prefetch (const char **mspaths, int count, int maxconnections,
+                  int64_t splitsize, int8_t verbose)
+{
+#if !defined(LIBMSEED_URL)
+  (void)mspaths; /* Unused */
+  (void)count; /* Unused */
+  (void)maxconnections; /* Unused */
+  (void)splitsize; /* Unused */
+  (void)verbose; /* Unused */
+  ms_log (2, "URL support not included in library\n");
+  return MS_GENERROR;
+#else
+  const char **urls = NULL;
+  char *paths = NULL;
+  int64_t *offsets = NULL;
+  char *pathname_range;
+  int retval;
+  int idx;
+
+  if (!mspaths || count <= 0)
+    return 0;
+
+  if ((urls = (const char **)libmseed_memory.malloc (sizeof (char *) * count)) == NULL ||
+      (paths = (char *)libmseed_memory.malloc (512 * count)) == NULL ||
+      (offsets = (int64_t *)libmseed_memory.malloc (sizeof (int64_t) * 2 * count)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for URL list\n");
+    if (urls)
+      libmseed_memory.free (urls);
+    if (paths)
+      libmseed_memory.free (paths);
+    return MS_GENERROR;
+  }
+
+  /* Separate byte ranges from URLs */
+  for (idx = 0; idx < count; idx++)
+  {
+    char *path = paths + (512 * idx);
+
+    offsets[idx]         = 0;
+    offsets[count + idx] = 0;
+    urls[idx]            = path;
+
+    strncpy (path, (mspaths[idx]) ? mspaths[idx] : "", 511);
+    path[511] = '\0';
+
+    if (mspaths[idx] &&
+        (pathname_range = parse_pathname_range (mspaths[idx], &offsets[idx], &offsets[count + idx])) &&
+        (pathname_range - mspaths[idx]) < 512)
+      path[pathname_range - mspaths[idx]] = '\0';
+  }
+
+  retval = msio_url_prefetch (urls, offsets, offsets + count, count,
+                              maxconnections, splitsize, verbose);
+
+  libmseed_memory.free (urls);
+  libmseed_memory.free (paths);
+  libmseed_memory.free (offsets);
+
+  return (retval < 0) ? MS_GENERROR : retval;
+#endif
+} /* End of ms3_url_prefetch() */
+
+/*****************************************************************/ /**
+ * @brief Set the number of asynchronous reads kept in flight for files
+ *
+ * Files subsequently opened for reading with ms3_readmsr() and related
+ * routines are read in 1 MiB chunks, keeping up to \a depth chunk
+ * reads in flight ahead of the record parsing.  This requires the
+ * library to be built with \b LIBMSEED_IOURING defined and the Linux
+ * io_uring interface to be permitted, otherwise files are read with
+ * synchronous reads.
+ *
+ * A \a depth of 0 disables reading ahead, the default.
+ *
+ * @param[in] depth Number of chunk reads in flight, 0 to disable
+ *
+ * @returns 0 when reading ahead with io_uring, 1 when files are read
+ * synchronously and a negative library error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+ms3_io_readahead (int depth)
+{
+  int rv = msio_readahead (depth);
+
+  return (rv < 0) ? MS_GENERROR : rv;
+} /* End of ms3_io_readahead() */
+
+/*****************************************************************/ /**
+ * @brief Read a byte range from a file descriptor
+ *
+ * Read \a length bytes at \a offset from file descriptor \a fd into
+ * \a buffer, retrying short and interrupted reads until the length is
+ * read or the end of the file is reached.  The file position of \a fd
+ * is not changed on systems with pread(), allowing multiple threads to
+ * read from the same descriptor.
+ *
+ * @param[in] fd File descriptor to read from
+ * @param[out] buffer Destination buffer of at least \a length bytes
+ * @param[in] length Number of bytes to read
+ * @param[in] offset Byte offset in file to read from
+ *
+ * @returns Number of bytes read, less than \a length only at the end
+ * of the file, or a negative errno on error.
+ *********************************************************************/
+int64_t
+ms3_pread (int fd, char *buffer, size_t length, int64_t offset)
+{
+  return msio_pread (fd, buffer, length, offset);
+} /* End of ms3_pread() */
+
+/*****************************************************************/ /**
+ * @brief Create a queue for reading batches of byte ranges
+ *
+ * Create a queue for ms3_ioqueue_read() that keeps up to \a depth reads
+ * in flight using the Linux io_uring interface, when the library is
+ * built with \b LIBMSEED_IOURING defined and the kernel permits it.
+ * Otherwise each read is performed synchronously with pread().  Use
+ * ms3_ioqueue_isasync() to determine which is used.
+ *
+ * When reads are made into a single buffer, it may be specified as
+ * \a buffer of \a buffersize bytes to register it with the kernel,
+ * avoiding the mapping of the destination for each read.
+ *
+ * A queue may only be used by a single thread at a time.
+ *
+ * @param[in] depth Maximum number of reads in flight
+ * @param[in] buffer Destination buffer of reads to register, may be NULL
+ * @param[in] buffersize Size of \a buffer in bytes
+ *
+ * @returns Allocated ::MS3IOQueue on success and NULL on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *
+ * \sa ms3_ioqueue_free()
+ *********************************************************************/
+MS3IOQueue *
+ms3_ioqueue_init (int depth, char *buffer, size_t buffersize)
+{
+  return msio_ioqueue_init (depth, buffer, buffersize);
+} /* End of ms3_ioqueue_init() */
+
+/*****************************************************************/ /**
+ * @brief Read a batch of byte ranges from files
+ *
+ * Read each of \a count ::MS3IORequest entries, setting the \c result
+ * of each to the number of bytes read or a negative errno.  Short reads
+ * occur only at the end of a file.  The requests may be read in any
+ * order, all are complete when this routine returns.
+ *
+ * @param[in] ioq Queue created with ms3_ioqueue_init()
+ * @param[in,out] requests Read requests
+ * @param[in] count Number of entries in \a requests
+ *
+ * @returns Number of requests read completely on success and a
+ * negative library error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+ms3_ioqueue_read (MS3IOQueue *ioq, MS3IORequest *requests, int count)
+{
+  int rv = msio_ioqueue_read (ioq, requests, count);
+
+  return (rv < 0) ? MS_GENERROR : rv;
+} /* End of ms3_ioqueue_read() */
+
+/*****************************************************************/ /**
+ * @brief Determine if a queue reads asynchronously with io_uring
+ *
+ * @param[in] ioq Queue created with ms3_ioqueue_init()
+ *
+ * @returns 1 if reads are asynchronous and 0 if synchronous.
+ *********************************************************************/
+int
+ms3_ioqueue_isasync (MS3IOQueue *ioq)
+{
+  return msio_ioqueue_isasync (ioq);
+} /* End of ms3_ioqueue_isasync() */
+
+/*****************************************************************/ /**
+ * @brief Free a queue created with ms3_ioqueue_init()
+ *
+ * @param[in] ioq Queue to free
+ *********************************************************************/
+void
+ms3_ioqueue_free (MS3IOQueue *ioq)
+{
+  msio_ioqueue_free (ioq);
+} /* End of ms3_ioqueue_free() */
+
 
 /***************************************************************************
  *
@@ -1062,3 +1479,73 @@ parse_pathname_range (const char *string, int64_t *start, int64_t *end)
 
   return at;
 } /* End of parse_pathname_range() */
+
+
+/*****************************************************************/ /**
+ * Determine the number of bytes to skip in a buffer of non-data to
+ * reach the next plausible record header.
+ *
+ * Record headers are only possible where a miniSEED 2 data quality
+ * indicator is present at offset 6 or a miniSEED 3 header starts with
+ * 'M'.  Such bytes are located 8 at a time by testing each word for
+ * bytes equal to any indicator, only the few candidate offsets are
+ * verified with the header signature tests.  This is equivalent to,
+ * but much faster than, advancing one byte at a time and attempting
+ * record detection at each offset.
+ *
+ * When no candidate is found all but the last (MINRECLEN - 1) bytes
+ * are skipped, a header spanning the end of the buffer is tested once
+ * more data are read.
+ *
+ * @returns Number of bytes to skip, at least 1.
+ *********************************************************************/
+static int
+skip_nondata (const char *buffer, int length)
+{
+  const uint64_t ones = UINT64_C (0x0101010101010101);
+  const uint64_t highs = UINT64_C (0x8080808080808080);
+  const unsigned char *ubuffer = (const unsigned char *)buffer;
+  uint64_t word;
+  uint64_t match;
+  int limit; /* Last offset with a complete header in buffer */
+  int best;
+  int offset;
+  int idx;
+
+  limit = length - MINRECLEN;
+
+  if (limit < 1)
+    return 1;
+
+  best = limit + 1;
+
+  /* Search indicator bytes from offset 1, v3 headers at the byte
+   * and v2 headers 6 bytes before the byte */
+  for (offset = 1; offset <= limit + 6 && (offset - 6) < best; offset += 8)
+  {
+    if (offset + 8 <= length)
+    {
+      memcpy (&word, ubuffer + offset, sizeof (word));
+
+#define HASBYTE(W, C) (((W ^ (ones * (C))) - ones) & ~(W ^ (ones * (C))) & highs)
+      match = HASBYTE (word, 'D') | HASBYTE (word, 'R') | HASBYTE (word, 'Q') | HASBYTE (word, 'M');
+#undef HASBYTE
+
+      if (!match)
+        continue;
+    }
+
+    for (idx = offset; idx < offset + 8 && idx < length && (idx - 6) < best; idx++)
+    {
+      if (!MS2_ISDATAINDICATOR (ubuffer[idx]))
+        continue;
+
+      if (idx - 6 >= 1 && idx - 6 <= limit && MS2_ISVALIDHEADER (buffer + idx - 6))
+        best = idx - 6;
+      else if (idx <= limit && idx < best && MS3_ISVALIDHEADER (buffer + idx))
+        best = idx;
+    }
+  }
+
+  return best;
+} /* End of skip_nondata() */
@@ -29,6 +29,9 @@
 
 static nstime_t ms_time2nstime_int (int year, int day, int hour,
                                     int min, int sec, uint32_t nsec);
+static struct tm *ms_gmtime_cached (int64_t isec, MSDayCache *cache, struct tm *tms);
+static char *ms_nstime2timestr_int (nstime_t nstime, char *timestr, MSDayCache *cache,
+                                    ms_timeformat_t timeformat, ms_subseconds_t subseconds);
 
 /** @cond UNDOCUMENTED */
 
@@ -110,6 +113,11 @@ static LeapSecond embedded_leapsecondlist[] = {
 /* Global variable to hold a leap second list */
 LeapSecond *leapsecondlist = &embedded_leapsecondlist[0];
 
+/* Sorted, contiguous array of leap seconds that leapsecondlist is linked
+ * through, searched by ms_sampletime() when it is the current list */
+static LeapSecond *leapsecondarray = &embedded_leapsecondlist[0];
+static int leapsecondcount = sizeof (embedded_leapsecondlist) / sizeof (LeapSecond);
+
 /* Days in each month, for non-leap and leap years */
 static const int monthdays[]      = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 static const int monthdays_leap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -858,6 +866,39 @@ ms_md2doy (int year, int month, int mday, int *yday)
 int
 ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday,
                 uint8_t *hour, uint8_t *min, uint8_t *sec, uint32_t *nsec)
+{
+  return ms_nstime2time_cached (nstime, NULL, year, yday, hour, min, sec, nsec);
+} /* End of ms_nstime2time() */
+
+/**********************************************************************/ /**
+ * @brief Convert an ::nstime_t to individual date-time components
+ * using a cached day
+ *
+ * Same as ms_nstime2time(), except the calendar date of the most
+ * recently converted day is kept in \a cache.  Times within the same
+ * day as the previous conversion only require simple arithmetic
+ * instead of a full calendar conversion, which benefits converting
+ * many times that are near each other.
+ *
+ * The \a cache must be initialized with ::MSDayCache_INITIALIZER and
+ * should not be shared between threads.  If \a cache is NULL this is
+ * equivalent to ms_nstime2time().
+ *
+ * @param[in] nstime Time value to convert
+ * @param[in,out] cache Cache of the calendar date of a day
+ * @param[out] year Year with century, like 2018
+ * @param[out] yday Day of year, 1 - 366
+ * @param[out] hour Hour, 0 - 23
+ * @param[out] min Minute, 0 - 59
+ * @param[out] sec Second, 0 - 60, where 60 is a leap second
+ * @param[out] nsec Nanoseconds, 0 - 999999999
+ *
+ * @retval 0 on success
+ * @retval -1 on error
+ ***************************************************************************/
+int
+ms_nstime2time_cached (nstime_t nstime, MSDayCache *cache, uint16_t *year, uint16_t *yday,
+                       uint8_t *hour, uint8_t *min, uint8_t *sec, uint32_t *nsec)
 {
   struct tm tms;
   int64_t isec;
@@ -875,7 +916,7 @@ ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday,
   }
 
   if (year || yday || hour || min || sec)
-    if (!(ms_gmtime64_r (&isec, &tms)))
+    if (!(ms_gmtime_cached (isec, cache, &tms)))
       return -1;
 
   if (year)
@@ -897,7 +938,7 @@ ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday,
     *nsec = ifract;
 
   return 0;
-} /* End of ms_nstime2time() */
+} /* End of ms_nstime2time_cached() */
 
 /**********************************************************************/ /**
  * @brief Convert an ::nstime_t to a time string
@@ -926,6 +967,92 @@ ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday,
 char *
 ms_nstime2timestr (nstime_t nstime, char *timestr,
                    ms_timeformat_t timeformat, ms_subseconds_t subseconds)
+{
+  return ms_nstime2timestr_int (nstime, timestr, NULL, timeformat, subseconds);
+} /* End of ms_nstime2timestr() */
+
+/**********************************************************************/ /**
+ * @brief Convert an ::nstime_t to a time string using a cached day
+ *
+ * Same as ms_nstime2timestr(), except the calendar date of the most
+ * recently converted day is kept in \a cache, see
+ * ms_nstime2time_cached().
+ *
+ * @param[in] nstime Time value to convert
+ * @param[in,out] cache Cache of the calendar date of a day
+ * @param[out] timestr Buffer for ISO time string
+ * @param timeformat Time string format, one of @ref ms_timeformat_t
+ * @param subseconds Inclusion of subseconds, one of @ref ms_subseconds_t
+ *
+ * @returns Pointer to the resulting string or NULL on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+char *
+ms_nstime2timestr_cached (nstime_t nstime, MSDayCache *cache, char *timestr,
+                          ms_timeformat_t timeformat, ms_subseconds_t subseconds)
+{
+  return ms_nstime2timestr_int (nstime, timestr, cache, timeformat, subseconds);
+} /* End of ms_nstime2timestr_cached() */
+
+/**********************************************************************/ /**
+ * @brief Convert an array of ::nstime_t values to time strings
+ *
+ * Format a column of times, as for a summary listing, into a buffer
+ * of \a count strings each \a stride bytes apart.  Conversion uses a
+ * day cache as ms_nstime2timestr_cached(), so consecutive times that
+ * fall within the same day avoid repeated calendar conversion.
+ *
+ * The \a stride must be at least 37 bytes, enough for any
+ * combination of \a timeformat and \a subseconds.
+ *
+ * @param[in] nstimes Array of time values to convert
+ * @param[in] count Number of time values to convert
+ * @param[out] timestrs Buffer of at least \a count * \a stride bytes
+ * @param[in] stride Distance in bytes between the start of each string
+ * @param timeformat Time string format, one of @ref ms_timeformat_t
+ * @param subseconds Inclusion of subseconds, one of @ref ms_subseconds_t
+ *
+ * @returns Number of time strings generated or -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms_nstime2timestr_bulk (const nstime_t *nstimes, int count, char *timestrs, int stride,
+                        ms_timeformat_t timeformat, ms_subseconds_t subseconds)
+{
+  MSDayCache cache = MSDayCache_INITIALIZER;
+  int idx;
+
+  if (!nstimes || !timestrs || count < 0)
+  {
+    ms_log (2, "%s(): Required input not defined: 'nstimes' or 'timestrs'\n", __func__);
+    return -1;
+  }
+
+  if (stride < 37)
+  {
+    ms_log (2, "%s(): Stride of %d is too small for time strings\n", __func__, stride);
+    return -1;
+  }
+
+  for (idx = 0; idx < count; idx++)
+  {
+    if (!ms_nstime2timestr_int (nstimes[idx], timestrs + (size_t)idx * stride, &cache,
+                                timeformat, subseconds))
+      return -1;
+  }
+
+  return count;
+} /* End of ms_nstime2timestr_bulk() */
+
+/***************************************************************************
+ * INTERNAL Convert an nstime_t to a time string, optionally with a
+ * day cache, see ms_nstime2timestr().
+ ***************************************************************************/
+static char *
+ms_nstime2timestr_int (nstime_t nstime, char *timestr, MSDayCache *cache,
+                       ms_timeformat_t timeformat, ms_subseconds_t subseconds)
 {
   struct tm tms = {0};
   int64_t rawisec;
@@ -965,7 +1092,7 @@ ms_nstime2timestr (nstime_t nstime, char *timestr,
       timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z ||
       timeformat == SEEDORDINAL)
   {
-    if (!(ms_gmtime64_r (&isec, &tms)))
+    if (!(ms_gmtime_cached (isec, cache, &tms)))
     {
       ms_log (2, "Error converting epoch-time of (%" PRId64 ") to date-time components\n", isec);
       return NULL;
@@ -1121,7 +1248,7 @@ ms_nstime2timestr (nstime_t nstime, char *timestr,
   }
 
   return timestr;
-} /* End of ms_nstime2timestr() */
+} /* End of ms_nstime2timestr_int() */
 
 /**********************************************************************/ /**
  * @brief Convert an ::nstime_t to a time string with 'Z' suffix
@@ -1154,6 +1281,57 @@ ms_nstime2timestrz (nstime_t nstime, char *timestr,
   return ms_nstime2timestr (nstime, timestr, timeformat, subseconds);
 } /* End of ms_nstime2timestrz() */
 
+/***************************************************************************
+ * INTERNAL Convert epoch seconds to date-time components.
+ *
+ * When a cache is provided the calendar date of the day is taken from
+ * the cache if it is the same day, otherwise the day is converted and
+ * stored in the cache.  Time of day is calculated directly.  Only the
+ * year, month, day of month, day of year, hour, minute and second
+ * fields are set when using a cache.
+ *
+ * Returns pointer to tms on success and NULL on error.
+ ***************************************************************************/
+static struct tm *
+ms_gmtime_cached (int64_t isec, MSDayCache *cache, struct tm *tms)
+{
+  struct tm daytms;
+  int64_t day;
+  int64_t daysec;
+  int secofday;
+
+  if (!cache)
+    return ms_gmtime64_r (&isec, tms);
+
+  /* Day since the epoch, rounded toward negative infinity */
+  day = isec / 86400 - ((isec % 86400) < 0);
+  secofday = (int)(isec - day * 86400);
+
+  if (cache->day != day)
+  {
+    daysec = day * 86400;
+
+    if (!ms_gmtime64_r (&daysec, &daytms))
+      return NULL;
+
+    cache->day   = day;
+    cache->year  = daytms.tm_year + 1900;
+    cache->yday  = daytms.tm_yday + 1;
+    cache->month = daytms.tm_mon + 1;
+    cache->mday  = daytms.tm_mday;
+  }
+
+  tms->tm_year = cache->year - 1900;
+  tms->tm_yday = cache->yday - 1;
+  tms->tm_mon  = cache->month - 1;
+  tms->tm_mday = cache->mday;
+  tms->tm_hour = secofday / 3600;
+  tms->tm_min  = (secofday / 60) % 60;
+  tms->tm_sec  = secofday % 60;
+
+  return tms;
+} /* End of ms_gmtime_cached() */
+
 /***************************************************************************
  * INTERNAL Convert specified date-time values to a high precision epoch time.
  *
@@ -1626,6 +1804,11 @@ ms_seedtimestr2nstime (const char *seedtimestr)
  * @note On the epoch time scale the value of a leap second is the
  * same as the second following the leap second, without external
  * information the values are ambiguous.
+ *
+ * The embedded list and lists read with ms_readleapsecondfile() are
+ * binary searched, and not searched at all for times after the last
+ * leap second.  A list otherwise assigned to \a leapsecondlist is
+ * checked entry by entry.
  * \sa ms_readleapsecondfile()
  *
  * @param[in] time Time value for first sample in array
@@ -1639,6 +1822,9 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
 {
   nstime_t span = 0;
   LeapSecond *lslist = leapsecondlist;
+  int low;
+  int high;
+  int mid;
 
   if (offset > 0)
   {
@@ -1651,8 +1837,34 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
       span = (nstime_t) (((double)offset * -samprate * NSTMODULUS) + 0.5);
   }
 
-  /* Check if the time range contains a leap second, if list is available */
-  if (lslist)
+  /* Nothing to check if the time range cannot contain a leap second */
+  if (!lslist || span < NSTMODULUS)
+    return (time + span);
+
+  /* Search array of leap seconds, the usual case, no leap seconds are after the
+   * last one and otherwise find the first leap second after the time */
+  if (lslist == leapsecondarray)
+  {
+    if (time >= leapsecondarray[leapsecondcount - 1].leapsecond)
+      return (time + span);
+
+    low  = 0;
+    high = leapsecondcount - 1;
+    while (low < high)
+    {
+      mid = low + (high - low) / 2;
+
+      if (leapsecondarray[mid].leapsecond > time)
+        high = mid;
+      else
+        low = mid + 1;
+    }
+
+    if (leapsecondarray[low].leapsecond <= (time + span - NSTMODULUS))
+      span -= NSTMODULUS;
+  }
+  /* Otherwise check each entry of a list set by the caller */
+  else
   {
     while (lslist)
     {
@@ -1671,6 +1883,57 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
 } /* End of ms_sampletime() */
 
 
+/**********************************************************************/ /**
+ * @brief Calculate the number of samples to trim to a time bound
+ *
+ * Given the time of the first (or last) sample in an array, a sample
+ * period and a time bound, calculate the number of samples to remove
+ * from the start (or end) of the array so that the first remaining
+ * sample is at or after the bound (or the last remaining sample is at
+ * or before the bound).
+ *
+ * This is the closed-form equivalent of stepping the time by \a
+ * nsperiod until it reaches the bound, the result is exact for integer
+ * nanosecond periods.  The number of samples is limited to \a
+ * samplecnt, if the returned value is equal to \a samplecnt all
+ * samples would be trimmed.
+ *
+ * Leap seconds are not considered.
+ *
+ * @param[in] time Time of first sample, or last sample if \a fromend
+ * @param[in] bound Time bound to trim to
+ * @param[in] nsperiod Sample period in nanoseconds, see msr3_nsperiod()
+ * @param[in] samplecnt Number of samples in the array
+ * @param[in] fromend Trim from the end of the array if non-zero
+ * @param[out] newtime Time of the new first (or last) sample, if not NULL
+ *
+ * @returns Number of samples to trim, 0 when \a nsperiod is not positive
+ ***************************************************************************/
+int64_t
+ms_trimsamples (nstime_t time, nstime_t bound, nstime_t nsperiod,
+                int64_t samplecnt, int8_t fromend, nstime_t *newtime)
+{
+  nstime_t span;
+  int64_t count = 0;
+
+  span = (fromend) ? time - bound : bound - time;
+
+  if (nsperiod > 0 && span > 0 && samplecnt > 0)
+  {
+    /* Number of periods needed to reach the bound, rounded up */
+    count = span / nsperiod + ((span % nsperiod) ? 1 : 0);
+
+    if (count > samplecnt)
+      count = samplecnt;
+  }
+
+  if (newtime)
+    *newtime = (fromend) ? time - count * nsperiod : time + count * nsperiod;
+
+  return count;
+} /* End of ms_trimsamples() */
+
+
 /**********************************************************************/ /**
  * @brief Runtime test for host endianess
  * @returns 0 if the host is little endian, otherwise 1.
@@ -1710,10 +1973,27 @@ ms_readleapseconds (const char *envvarname)
 } /* End of ms_readleapseconds() */
 
 
+/* Compare leap seconds by time for qsort() */
+static int
+cmpleapsecond (const void *a, const void *b)
+{
+  nstime_t timea = ((const LeapSecond *)a)->leapsecond;
+  nstime_t timeb = ((const LeapSecond *)b)->leapsecond;
+
+  return (timea > timeb) - (timea < timeb);
+}
+
 /**********************************************************************/ /**
  * @brief Read leap second from the specified file
  *
  * Leap seconds are loaded into the library's global leapsecond list.
+ * The list is stored as a time-sorted array of entries that
+ * ms_sampletime() searches directly, so loading a file does not
+ * increase the cost of sample time calculations.
+ *
+ * The list is replaced without locking, the file should be loaded
+ * before any threads that use the library are started, see
+ * @ref thread-safety.
  *
  * The file is expected to be in NTP leap second list format. Some locations
  * where this file can be obtained are indicated in RFC 8633 section 3.7:
@@ -1731,7 +2011,7 @@ ms_readleapsecondfile (const char *filename)
 {
   FILE *fp           = NULL;
   LeapSecond *ls     = NULL;
-  LeapSecond *lastls = NULL;
+  LeapSecond *array  = NULL;
   int64_t expires;
   char readline[200];
   char *cp;
@@ -1752,13 +2032,22 @@ ms_readleapsecondfile (const char *filename)
     return -1;
   }
 
-  /* Detatch embedded leap second list */
+  /* Free an array read from a previous file, even if the list no longer
+   * refers to it, detatch the embedded leap second list, otherwise free
+   * entries of the existing list */
+  if (leapsecondarray != NULL && leapsecondarray != &embedded_leapsecondlist[0])
+  {
+    if (leapsecondlist == leapsecondarray)
+      leapsecondlist = NULL;
+
+    libmseed_memory.free (leapsecondarray);
+  }
+
   if (leapsecondlist == &embedded_leapsecondlist[0])
   {
     leapsecondlist = NULL;
   }
 
-  /* Free existing leapsecondlist */
   while (leapsecondlist != NULL)
   {
     LeapSecond *next = leapsecondlist->next;
@@ -1766,6 +2055,9 @@ ms_readleapsecondfile (const char *filename)
     leapsecondlist = next;
   }
 
+  leapsecondarray = NULL;
+  leapsecondcount = 0;
+
   while (fgets (readline, sizeof (readline) - 1, fp))
   {
     /* Guarantee termination */
@@ -1811,29 +2103,21 @@ ms_readleapsecondfile (const char *filename)
 
     if (fields == 2)
     {
-      if ((ls = (LeapSecond *)libmseed_memory.malloc (sizeof (LeapSecond))) == NULL)
+      if ((ls = (LeapSecond *)libmseed_memory.realloc (array, (count + 1) * sizeof (LeapSecond))) == NULL)
       {
         ms_log (2, "Cannot allocate LeapSecond entry, out of memory?\n");
+        libmseed_memory.free (array);
+        fclose (fp);
         return -1;
       }
+      array = ls;
 
       /* Convert NTP epoch time to Unix epoch time and then to nttime_t */
+      ls             = &array[count];
       ls->leapsecond = MS_EPOCH2NSTIME (leapsecond - NTPPOSIXEPOCHDELTA);
       ls->TAIdelta   = TAIdelta;
       ls->next       = NULL;
       count++;
-
-      /* Add leap second to global list */
-      if (!leapsecondlist)
-      {
-        leapsecondlist = ls;
-        lastls         = ls;
-      }
-      else
-      {
-        lastls->next = ls;
-        lastls       = ls;
-      }
     }
     else
     {
@@ -1844,10 +2128,25 @@ ms_readleapsecondfile (const char *filename)
   if (ferror (fp))
   {
     ms_log (2, "Error reading leap second file (%s): %s\n", filename, strerror (errno));
+    libmseed_memory.free (array);
+    fclose (fp);
     return -1;
   }
 
   fclose (fp);
 
+  /* Sort leap seconds by time and link the array into the global list */
+  if (count > 0)
+  {
+    qsort (array, count, sizeof (LeapSecond), cmpleapsecond);
+
+    for (ls = array; ls < array + count - 1; ls++)
+      ls->next = ls + 1;
+
+    leapsecondlist  = array;
+    leapsecondarray = array;
+    leapsecondcount = count;
+  }
+
   return count;
 } /* End of ms_readleapsecondfile() */
@@ -315,10 +315,34 @@ typedef enum
   NANO_MICRO_NONE = 6
 } ms_subseconds_t;
 
+/** @brief Calendar date of a day, cached for fast time conversion
+    \sa ms_nstime2time_cached() \sa ms_nstime2timestr_cached() */
+typedef struct MSDayCache
+{
+  int64_t day;      //!< Day since the epoch of the cached date, INT64_MIN if none
+  uint16_t year;    //!< Year with century
+  uint16_t yday;    //!< Day of year, 1 - 366
+  uint8_t month;    //!< Month, 1 - 12
+  uint8_t mday;     //!< Day of month, 1 - 31
+} MSDayCache;
+
+/** @def MSDayCache_INITIALIZER
+    @brief Initialializer for ::MSDayCache */
+#define MSDayCache_INITIALIZER                                     \
+  {                                                                \
+    .day = INT64_MIN, .year = 0, .yday = 0, .month = 0, .mday = 0 \
+  }
+
 extern int ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday,
                            uint8_t *hour, uint8_t *min, uint8_t *sec, uint32_t *nsec);
+extern int ms_nstime2time_cached (nstime_t nstime, MSDayCache *cache, uint16_t *year, uint16_t *yday,
+                                  uint8_t *hour, uint8_t *min, uint8_t *sec, uint32_t *nsec);
 extern char* ms_nstime2timestr (nstime_t nstime, char *timestr,
                                 ms_timeformat_t timeformat, ms_subseconds_t subsecond);
+extern char* ms_nstime2timestr_cached (nstime_t nstime, MSDayCache *cache, char *timestr,
+                                       ms_timeformat_t timeformat, ms_subseconds_t subsecond);
+extern int ms_nstime2timestr_bulk (const nstime_t *nstimes, int count, char *timestrs, int stride,
+                                   ms_timeformat_t timeformat, ms_subseconds_t subsecond);
 DEPRECATED extern char* ms_nstime2timestrz (nstime_t nstime, char *timestr,
                                             ms_timeformat_t timeformat, ms_subseconds_t subsecond);
 extern nstime_t ms_time2nstime (int year, int yday, int hour, int min, int sec, uint32_t nsec);
@@ -340,6 +364,42 @@ extern int ms_md2doy (int year, int month, int mday, int *yday);
     - \c 'd' - 64-bit float (IEEE) data samples
 */
 
+/** @page thread-safety Thread Safety
+    @brief Use of the library by multiple threads.
+
+    The record parsing, unpacking and packing routines, trace lists,
+    record lists and selections only use the containers passed to
+    them, and may be used concurrently as long as each container is
+    only used by one thread at a time.  Containers that are only
+    read, such as selections, may be shared.
+
+    The following global state is shared by all threads and should be
+    set up before threads are started:
+
+    - \b libmseed_memory and \b libmseed_prealloc_block_size, see
+      @ref memory-allocators.  The allocators must be thread safe.
+    - \b leapsecondlist, loaded by ms_readleapseconds() or
+      ms_readleapsecondfile().  The list is only read afterwards.
+    - URL configuration set by ms3_url_useragent(),
+      ms3_url_userpassword(), ms3_url_addheader(), ms3_url_spooldir()
+      and ms3_io_readahead().  Programs that read URLs from threads
+      should also call ms3_url_init() first.  The registry of spool
+      files written by the process is locked and may be updated by
+      any thread.
+
+    ms3_readmsr() keeps its reading state in global parameters and
+    can only be used by one thread; use ms3_readmsr_r() or
+    ms3_readmsr_selection() with a separate ::MS3FileParam for each
+    stream instead.  ms3_readtracelist() and variants use their own
+    reading state.
+
+    The default logging parameters are per-thread, see
+    @ref log-threading.  Logging parameters passed explicitly with
+    ms_rloginit_l(), including any message registry, are not locked
+    and should not be shared between threads; a shared log for all
+    threads is provided by ms_rlog_ring_init().
+*/
+
 /** @def MS_PACK_DEFAULT_RECLEN
     @brief Default record length to use when ::MS3Record.reclen == -1
  */
@@ -414,6 +474,8 @@ extern nstime_t   msr3_nsperiod (const MS3Record *msr);
 extern double     msr3_host_latency (const MS3Record *msr);
 
 extern int64_t ms3_detect (const char *record, uint64_t recbuflen, uint8_t *formatversion);
+extern int ms3_patchheader (char *record, uint64_t reclen, void *field,
+                            const void *value, int size);
 extern int ms_parse_raw3 (const char *record, int maxreclen, int8_t details);
 extern int ms_parse_raw2 (const char *record, int maxreclen, int8_t details, int8_t swapflag);
 /** @} */
@@ -560,12 +622,14 @@ typedef struct MS3TraceSeg {
   struct MS3RecordList *recordlist;  //!< List of pointers to records that contributed
   struct MS3TraceSeg *prev;          //!< Pointer to previous segment
   struct MS3TraceSeg *next;          //!< Pointer to next segment, NULL if the last
+  void           *indexnode;         //!< INTERNAL: Node in time index of segments
 } MS3TraceSeg;
 
 /** @brief Container for a trace ID, linkable */
 typedef struct MS3TraceID {
   char            sid[LM_SIDLEN];    //!< Source identifier as URN, max length @ref LM_SIDLEN
   uint8_t         pubversion;        //!< Largest contributing publication version
+  uint32_t        sidhandle;         //!< Handle for \a sid, shared by all IDs with the same SID
   nstime_t        earliest;          //!< Time of earliest sample
   nstime_t        latest;            //!< Time of latest sample
   void           *prvtptr;           //!< Private pointer for general use, unused by library
@@ -574,11 +638,13 @@ typedef struct MS3TraceID {
   struct MS3TraceSeg *last;          //!< Pointer to last of list of segments
   struct MS3TraceID *next[MSTRACEID_SKIPLIST_HEIGHT];   //!< Next trace ID at first pointer, NULL if the last
   uint8_t         height;            //!< Height of skip list at \a next
+  void           *segindex;          //!< INTERNAL: Time index of segments, built when needed
 } MS3TraceID;
 
 /** @brief Container for a collection of continuous trace segment, linkable */
 typedef struct MS3TraceList {
   uint32_t           numtraceids;    //!< Number of traces IDs in list
+  uint32_t           numsids;        //!< Number of distinct SIDs in list, handles are 0 to numsids-1
   struct MS3TraceID  traces;         //!< Head node of trace skip list, first entry at \a traces.next[0]
   uint64_t           prngstate;      //!< INTERNAL: State for Pseudo RNG
 } MS3TraceList;
@@ -671,11 +737,22 @@ extern void mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timefo
     to determine if URL support is included in the library.
 
     Some parameters can be set that affect the reading of data from URLs, including:
+    - initialize URL support before reading URLs from multiple threads with @ref ms3_url_init()
     - set the User-Agent header with @ref ms3_url_useragent()
     - set username and password for authentication with @ref ms3_url_userpassword()
     - set arbitrary headers with @ref ms3_url_addheader()
+    - spool data to local files for re-reading with @ref ms3_url_spooldir()
+      and @ref ms3_url_spoolfile()
+    - fetch many URLs concurrently into the spool with @ref ms3_url_prefetch()
     - disable TLS/SSL peer and host verficiation by setting **LIBMSEED_SSL_NOVERIFY** environment variable
 
+    Reading of local files can keep several large reads in flight, using
+    the Linux io_uring interface when the library is built with the
+    \b LIBMSEED_IOURING variable defined and the kernel permits it, and
+    otherwise falling back to synchronous reads:
+    - read ahead of the parser for file input with @ref ms3_io_readahead()
+    - read batches of byte ranges from many files with @ref ms3_ioqueue_read()
+
     Diagnostics: Setting environment variable **LIBMSEED_URL_DEBUG** enables
     detailed verbosity of URL protocol exchanges.
 
@@ -687,7 +764,7 @@ extern void mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timefo
     \sa mstl3_writemseed()
     @{ */
 
-/** @brief Type definition for data source I/O: file-system versus URL */
+/** @brief Type definition for data source I/O: file-system, URL or compressed file */
 typedef struct LMIO
 {
   enum
@@ -695,18 +772,22 @@ typedef struct LMIO
     LMIO_NULL = 0,   //!< IO handle type is undefined
     LMIO_FILE = 1,   //!< IO handle is FILE-type
     LMIO_URL  = 2,   //!< IO handle is URL-type
-    LMIO_FD   = 3    //!< IO handle is a provided file descriptor
+    LMIO_FD   = 3,   //!< IO handle is a provided file descriptor
+    LMIO_GZIP = 4,   //!< IO handle is a gzip-compressed file
+    LMIO_ZSTD = 5    //!< IO handle is a zstd-compressed file
   } type;            //!< IO handle type
-  void *handle;      //!< Primary IO handle, either file or URL
-  void *handle2;     //!< Secondary IO handle for URL
+  void *handle;      //!< Primary IO handle, either file, URL, gzip stream or zstd file
+  void *handle2;     //!< Secondary IO handle for URL, read-ahead state for file, zstd stream state
   int still_running; //!< Fetch status flag for URL transmissions
+  void *spool;       //!< Spooling state for URL and decompressed data
 } LMIO;
 
 /** @def LMIO_INITIALIZER
     @brief Initialializer for the internal stream handle ::LMIO */
-#define LMIO_INITIALIZER                                                   \
-  {                                                                        \
-    .type = LMIO_NULL, .handle = NULL, .handle2 = NULL, .still_running = 0 \
+#define LMIO_INITIALIZER                                                    \
+  {                                                                         \
+    .type = LMIO_NULL, .handle = NULL, .handle2 = NULL, .still_running = 0, \
+    .spool = NULL                                                           \
   }
 
 /** @brief State container for reading miniSEED records from files or URLs.
@@ -725,8 +806,10 @@ typedef struct MS3FileParam
   int64_t recordcount; //!< OUTPUT: Count of records read from this stream/file so far
 
   char *readbuffer;    //!< INTERNAL: Read buffer, allocated internally
+  int readbuffersize;  //!< INTERNAL: Allocated size of read buffer, grown as needed
   int readlength;      //!< INTERNAL: Length of data in read buffer
   int readoffset;      //!< INTERNAL: Read offset in read buffer
+  int readsize;        //!< INTERNAL: Preferred read size, determined when input is opened
   uint32_t flags;      //!< INTERNAL: Stream reading state flags
   LMIO input;          //!< INTERNAL: IO handle, file or URL
 } MS3FileParam;
@@ -736,8 +819,9 @@ typedef struct MS3FileParam
 #define MS3FileParam_INITIALIZER                                  \
   {                                                               \
     .path = "", .startoffset = 0, .endoffset = 0, .streampos = 0, \
-    .recordcount = 0, .readbuffer = NULL, .readlength = 0,        \
-    .readoffset = 0, .flags = 0, .input = LMIO_INITIALIZER        \
+    .recordcount = 0, .readbuffer = NULL, .readbuffersize = 0,    \
+    .readlength = 0, .readoffset = 0, .readsize = 0, .flags = 0,  \
+    .input = LMIO_INITIALIZER                                     \
   }
 
 extern int ms3_readmsr (MS3Record **ppmsr, const char *mspath, uint32_t flags, int8_t verbose);
@@ -752,10 +836,35 @@ extern int ms3_readtracelist_timewin (MS3TraceList **ppmstl, const char *mspath,
                                       int8_t verbose);
 extern int ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath, const MS3Tolerance *tolerance,
                                         const MS3Selections *selections, int8_t splitversion, uint32_t flags, int8_t verbose);
+extern int ms3_url_init (void);
 extern int ms3_url_useragent (const char *program, const char *version);
 extern int ms3_url_userpassword (const char *userpassword);
 extern int ms3_url_addheader (const char *header);
 extern void ms3_url_freeheaders (void);
+extern int ms3_url_spooldir (const char *directory);
+extern int ms3_url_spoolfile (const char *mspath, char *spoolfile, size_t size);
+extern int ms3_url_prefetch (const char **mspaths, int count, int maxconnections,
+                             int64_t splitsize, int8_t verbose);
+extern int ms3_io_readahead (int depth);
+extern int64_t ms3_pread (int fd, char *buffer, size_t length, int64_t offset);
+
+/** @brief Read request for a batch read with ms3_ioqueue_read() */
+typedef struct MS3IORequest
+{
+  int fd;          //!< INPUT: File descriptor to read from
+  int64_t offset;  //!< INPUT: Byte offset in file to read from
+  size_t length;   //!< INPUT: Number of bytes to read
+  char *buffer;    //!< INPUT: Destination buffer of at least \c length bytes
+  int64_t result;  //!< OUTPUT: Number of bytes read or negative errno on error
+} MS3IORequest;
+
+/** @brief Opaque queue of asynchronous reads, see ms3_ioqueue_init() */
+typedef struct MS3IOQueue MS3IOQueue;
+
+extern MS3IOQueue *ms3_ioqueue_init (int depth, char *buffer, size_t buffersize);
+extern int ms3_ioqueue_read (MS3IOQueue *ioq, MS3IORequest *requests, int count);
+extern int ms3_ioqueue_isasync (MS3IOQueue *ioq);
+extern void ms3_ioqueue_free (MS3IOQueue *ioq);
 extern int64_t msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overwrite,
                                 uint32_t flags, int8_t verbose);
 extern int64_t mstl3_writemseed (MS3TraceList *mst, const char *mspath, int8_t overwrite,
@@ -1091,6 +1200,12 @@ extern int mseh_print (const MS3Record *msr, int indent);
     unless the system does not support the necessary thread-local
     storage directives.
 
+    Programs that log from multiple threads can enable a shared ring
+    with ms_rlog_ring_init().  Messages from all threads are then
+    queued without locking and printed in order by a single thread
+    calling ms_rlog_ring_drain(), using that thread's printing
+    functions and prefixes.
+
     @anchor MessageOnError
     Message on Error
     ----------------
@@ -1176,6 +1291,9 @@ extern int ms_rlog (const char *function, int level, const char *format, ...);
 __attribute__ ((__format__ (__printf__, 4, 5)))
 #endif
 extern int ms_rlog_l (MSLogParam *logp, const char *function, int level, const char *format, ...);
+extern int ms_rlog_ring_init (int capacity, int minlevel);
+extern int ms_rlog_ring_drain (MSLogParam *logp);
+extern int ms_rlog_ring_free (MSLogParam *logp);
 
 /** @def ms_loginit
     @brief Convenience wrapper for ms_rloginit(), omitting max messages, disabling registry */
@@ -1254,6 +1372,8 @@ extern const char *ms_encodingstr (uint8_t encoding);
 extern const char *ms_errorstr (int errorcode);
 
 extern nstime_t ms_sampletime (nstime_t time, int64_t offset, double samprate);
+extern int64_t ms_trimsamples (nstime_t time, nstime_t bound, nstime_t nsperiod,
+                               int64_t samplecnt, int8_t fromend, nstime_t *newtime);
 extern int ms_bigendianhost (void);
 
 /** DEPRECATED legacy implementation of fabs(), now a macro */
@@ -1269,6 +1389,13 @@ extern uint64_t lmp_nanosleep (uint64_t nanoseconds);
 /** Return CRC32C value of supplied buffer, with optional starting CRC32C value */
 extern uint32_t ms_crc32c (const uint8_t *input, int length, uint32_t previousCRC32C);
 
+/** Return CRC32C value of buffer updated for changed bytes, given bytes that follow the change */
+extern uint32_t ms_crc32c_patch (uint32_t crc, const uint8_t *olddata, const uint8_t *newdata,
+                                 int count, uint64_t trailing);
+
+/** Return CRC32C value of two consecutive buffers from the CRC32C value of each */
+extern uint32_t ms_crc32c_combine (uint32_t crc1, uint32_t crc2, uint64_t length2);
+
 /** In-place byte swapping of 2 byte quantity */
 static inline void
 ms_gswap2 (void *data2)
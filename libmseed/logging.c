@@ -38,6 +38,45 @@ int add_message_int (MSLogRegistry *logreg, const char *function, int level,
 void print_message_int (MSLogParam *logp, int level, const char *message,
                         char *terminator);
 
+/* Atomic operations for the shared log ring.  Without GCC-compatible
+ * atomic builtins the ring is only safe for use by a single thread. */
+#if defined(__GNUC__) || defined(__clang__)
+  #define lm_load_acquire(ptr)       __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+  #define lm_store_release(ptr, val) __atomic_store_n ((ptr), (val), __ATOMIC_RELEASE)
+  #define lm_fetch_add(ptr, val)     __atomic_fetch_add ((ptr), (val), __ATOMIC_RELAXED)
+  #define lm_compare_swap(ptr, expected, desired) \
+    __atomic_compare_exchange_n ((ptr), (expected), (desired), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+  #define lm_load_acquire(ptr)       (*(ptr))
+  #define lm_store_release(ptr, val) (*(ptr) = (val))
+  #define lm_fetch_add(ptr, val)     ((*(ptr) += (val)) - (val))
+  #define lm_compare_swap(ptr, expected, desired) \
+    ((*(ptr) == *(expected)) ? (*(ptr) = (desired), 1) : (*(expected) = *(ptr), 0))
+#endif
+
+/* Slot of the shared log ring, sequence indicates the slot state */
+typedef struct LogRingSlot
+{
+  uint64_t sequence;
+  int level;
+  char message[MAX_LOG_MSG_LENGTH];
+} LogRingSlot;
+
+/* Bounded ring of log messages from any thread, drained by one thread */
+typedef struct LogRing
+{
+  LogRingSlot *slots;
+  uint64_t mask;
+  int minlevel;
+  uint64_t enqueue;
+  uint64_t dequeue;
+  uint64_t dropped;
+} LogRing;
+
+static LogRing *logring = NULL;
+
+static int ring_message_int (LogRing *ring, int level, const char *format, va_list *varlist);
+
 /* Initialize the global logging parameters
  *
  * If not disabled by a defined LIBMSEED_NO_THREADING, use options for
@@ -352,6 +391,10 @@ rlog_int (MSLogParam *logp, const char *function, int level,
     return -1;
   }
 
+  /* Queue messages that would be printed in the shared ring if enabled */
+  if (logring && !(level >= 1 && logp->registry.maxmessages > 0))
+    return ring_message_int (logring, level, format, varlist);
+
   message[0] = '\0';
 
   if (level >= 2) /* Error message */
@@ -655,3 +698,216 @@ ms_rlog_free (MSLogParam *logp)
 
   return freed;
 } /* End of ms_rlog_free() */
+
+
+/**********************************************************************/ /**
+ * @brief Enable a shared ring for log messages from multiple threads
+ *
+ * While the ring is enabled, messages that would otherwise be printed
+ * by any thread are formatted directly into a slot of a bounded,
+ * lock-free ring.  One thread prints the queued messages in order
+ * using ms_rlog_ring_drain(), so threads do not interleave partial
+ * output or contend on the printing functions.  Messages retained in
+ * a thread's \ref log-registry are not affected.
+ *
+ * Messages with a level below \a minlevel are discarded before any
+ * formatting.  When the ring is full messages are discarded and
+ * counted, the count is reported by the next ms_rlog_ring_drain().
+ *
+ * The ring must be enabled before, and freed after, any threads that
+ * log messages are running.  Thread safety requires a compiler with
+ * GCC-compatible atomic builtins.
+ *
+ * @param[in] capacity Number of messages that can be queued, rounded up to a power of 2
+ * @param[in] minlevel Minimum level of messages to queue, 0 for all
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * \sa ms_rlog_ring_drain()
+ * \sa ms_rlog_ring_free()
+ ***************************************************************************/
+int
+ms_rlog_ring_init (int capacity, int minlevel)
+{
+  LogRing *ring;
+  uint64_t size = 2;
+  uint64_t idx;
+
+  if (logring || capacity <= 0)
+    return -1;
+
+  while (size < (uint64_t)capacity)
+    size <<= 1;
+
+  if ((ring = (LogRing *)libmseed_memory.malloc (sizeof (LogRing))) == NULL ||
+      (ring->slots = (LogRingSlot *)libmseed_memory.malloc (size * sizeof (LogRingSlot))) == NULL)
+  {
+    if (ring)
+      libmseed_memory.free (ring);
+
+    ms_log (2, "Cannot allocate memory for log ring\n");
+    return -1;
+  }
+
+  for (idx = 0; idx < size; idx++)
+    ring->slots[idx].sequence = idx;
+
+  ring->mask = size - 1;
+  ring->minlevel = minlevel;
+  ring->enqueue = 0;
+  ring->dequeue = 0;
+  ring->dropped = 0;
+
+  logring = ring;
+
+  return 0;
+} /* End of ms_rlog_ring_init() */
+
+/**********************************************************************/ /**
+ * @brief Print messages queued in the shared log ring
+ *
+ * Messages are printed in the order they were queued, using the
+ * printing functions and prefixes of the specified ::MSLogParam.
+ * Only one thread may drain the ring at a time.
+ *
+ * @param[in] logp ::MSLogParam to print with or NULL for global parameters
+ *
+ * @returns The number of messages printed, 0 if the ring is not enabled.
+ *
+ * \sa ms_rlog_ring_init()
+ ***************************************************************************/
+int
+ms_rlog_ring_drain (MSLogParam *logp)
+{
+  LogRingSlot *slot;
+  char message[MAX_LOG_MSG_LENGTH];
+  const char *prefix;
+  size_t presize;
+  uint64_t dropped;
+  int count = 0;
+
+  if (!logring)
+    return 0;
+
+  if (!logp)
+    logp = &gMSLogParam;
+
+  while (1)
+  {
+    slot = &logring->slots[logring->dequeue & logring->mask];
+
+    /* Stop at first slot not yet published */
+    if (lm_load_acquire (&slot->sequence) != logring->dequeue + 1)
+      break;
+
+    if (slot->level >= 2)
+      prefix = (logp->errprefix) ? logp->errprefix : "Error: ";
+    else
+      prefix = (logp->logprefix) ? logp->logprefix : "";
+
+    /* Prefix and message are truncated at MAX_LOG_MSG_LENGTH as in rlog_int() */
+    strncpy (message, prefix, MAX_LOG_MSG_LENGTH);
+    message[MAX_LOG_MSG_LENGTH - 1] = '\0';
+    presize = strlen (message);
+    strncpy (message + presize, slot->message, MAX_LOG_MSG_LENGTH - presize);
+    message[MAX_LOG_MSG_LENGTH - 1] = '\0';
+    print_message_int (logp, slot->level, message, NULL);
+
+    /* Release slot for the next pass around the ring */
+    lm_store_release (&slot->sequence, logring->dequeue + logring->mask + 1);
+    logring->dequeue++;
+    count++;
+  }
+
+  if ((dropped = lm_load_acquire (&logring->dropped)) > 0)
+  {
+    lm_fetch_add (&logring->dropped, -dropped);
+    snprintf (message, sizeof (message), "%s%" PRIu64 " log messages discarded, log ring is full\n",
+              (logp->logprefix) ? logp->logprefix : "", dropped);
+    print_message_int (logp, 1, message, NULL);
+  }
+
+  return count;
+} /* End of ms_rlog_ring_drain() */
+
+/**********************************************************************/ /**
+ * @brief Drain and disable the shared log ring
+ *
+ * Remaining messages are printed with ms_rlog_ring_drain() and the
+ * ring is freed, subsequent messages are printed directly.  No other
+ * threads may be logging messages.
+ *
+ * @param[in] logp ::MSLogParam to print with or NULL for global parameters
+ *
+ * @returns The number of messages printed.
+ *
+ * \sa ms_rlog_ring_init()
+ ***************************************************************************/
+int
+ms_rlog_ring_free (MSLogParam *logp)
+{
+  LogRing *ring = logring;
+  int count;
+
+  if (!ring)
+    return 0;
+
+  count = ms_rlog_ring_drain (logp);
+
+  logring = NULL;
+  libmseed_memory.free (ring->slots);
+  libmseed_memory.free (ring);
+
+  return count;
+} /* End of ms_rlog_ring_free() */
+
+/***************************************************************************
+ * Queue a message in the log ring, formatting it directly into a
+ * claimed slot.  Prefixes are applied when the ring is drained.
+ *
+ * Returns the number of characters formatted, 0 if the message was
+ * discarded.
+ ***************************************************************************/
+static int
+ring_message_int (LogRing *ring, int level, const char *format, va_list *varlist)
+{
+  LogRingSlot *slot;
+  uint64_t position;
+  int64_t diff;
+  int printed;
+
+  if (level < ring->minlevel)
+    return 0;
+
+  /* Claim a slot, the slot sequence equals the position when it is free */
+  position = lm_load_acquire (&ring->enqueue);
+  while (1)
+  {
+    slot = &ring->slots[position & ring->mask];
+    diff = (int64_t)(lm_load_acquire (&slot->sequence) - position);
+
+    if (diff == 0)
+    {
+      if (lm_compare_swap (&ring->enqueue, &position, position + 1))
+        break;
+    }
+    else if (diff < 0)
+    {
+      lm_fetch_add (&ring->dropped, 1);
+      return 0;
+    }
+    else
+    {
+      position = lm_load_acquire (&ring->enqueue);
+    }
+  }
+
+  slot->level = level;
+  printed = vsnprintf (slot->message, sizeof (slot->message), format, *varlist);
+  slot->message[sizeof (slot->message) - 1] = '\0';
+
+  /* Publish slot to the draining thread */
+  lm_store_release (&slot->sequence, position + 1);
+
+  return (printed < 0) ? 0 : printed;
+} /* End of ring_message_int() */
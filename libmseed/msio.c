@@ -22,143 +22,2088 @@
 #define _LARGEFILE_SOURCE 1
 
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "msio.h"
 
 /* Include libcurl library header if URL supported is requested */
 #if defined(LIBMSEED_URL)
+#include <curl/curl.h>
+#endif
+
+/* Include zlib library header if gzip decompression is requested */
+#if defined(LIBMSEED_ZLIB)
+#include <zlib.h>
+#endif
+
+/* Include zstd library header if zstd decompression is requested */
+#if defined(LIBMSEED_ZSTD)
+#include <zstd.h>
+#endif
+
+/* Include Linux io_uring interface if asynchronous reading is requested */
+#if defined(LIBMSEED_IOURING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(LMP_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Directory for spooling URL and decompressed data to local files, NULL when disabled */
+char *gSpoolDir = NULL;
+
+/* Spool files written or validated by this process */
+struct spool_fresh
+{
+  char *path;   /* Spool file */
+  int complete; /* Spool contains all data of the source */
+};
+struct spool_fresh *gSpoolFresh = NULL;
+int gSpoolFreshCount = 0;
+
+/* Lock for the spool fresh registry, which is updated when URLs are
+ * opened and may be used by multiple threads */
+static char spoolfreshlock = 0;
+
+/* Size of zlib decompression input buffer */
+#define GZIP_BUFFERSIZE 131072
+
+#if defined(LIBMSEED_ZSTD)
+/* Decompression state for a zstd-compressed file */
+struct zstd_stream
+{
+  ZSTD_DCtx *dctx;
+  char *inputbuffer;    /* Compressed data read from file */
+  size_t inputsize;     /* Allocated size of input buffer */
+  ZSTD_inBuffer input;  /* Compressed data in input buffer not yet decompressed */
+  int inputeof;         /* End of compressed file reached */
+  int framecomplete;    /* Last frame decompressed completely */
+  int eof;              /* All data decompressed and returned */
+};
+#endif
+
+/* Number of asynchronous reads kept in flight ahead of file reading, 0 to disable */
+int gReadAheadDepth = 0;
+
+/* Size of each read ahead of file reading */
+#define READAHEAD_CHUNKSIZE 1048576
+
+/* Request result while a read is in flight */
+#define IOQUEUE_INFLIGHT INT64_MIN
+
+/* Queue of asynchronous reads, using io_uring when available */
+struct MS3IOQueue
+{
+  int depth;         /* Maximum number of reads in flight */
+  int ringfd;        /* io_uring file descriptor, -1 when reading synchronously */
+  char *fixed;       /* Registered destination buffer, NULL if none */
+  size_t fixedsize;  /* Size of registered buffer */
+#if defined(LIBMSEED_IOURING)
+  unsigned *sqtail;  /* Submission ring */
+  unsigned *sqmask;
+  unsigned *sqarray;
+  unsigned *cqhead;  /* Completion ring */
+  unsigned *cqtail;
+  unsigned *cqmask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sqring;
+  void *cqring;
+  size_t sqringsize;
+  size_t cqringsize;
+  size_t sqessize;
+  unsigned queued;   /* Submission entries not yet submitted */
+#endif
+};
+
+/* Read-ahead state for a file, reads of consecutive chunks kept in flight */
+struct readahead
+{
+  MS3IOQueue *ioq;
+  char *buffer;           /* Chunk buffers, depth * READAHEAD_CHUNKSIZE */
+  MS3IORequest *chunks;   /* Read request for each chunk */
+  int inflight;           /* Number of chunk reads in flight */
+  int next;               /* Chunk to consume next */
+  int64_t consumed;       /* Bytes consumed from next chunk */
+  int64_t offset;         /* File offset of next chunk to read */
+  int eof;                /* End of file reached in next chunk */
+};
+
+#define SPOOL_ETAG_SIZE 256
+#define SPOOL_LASTMODIFIED_SIZE 64
+
+/* Spooling state for a URL or compressed stream */
+struct spool_parameters
+{
+  char *key;                                  /* URL and requested range identifying the spool */
+  char path[1024];                            /* Spool file */
+  char partpath[1024];                        /* Spool file while being written */
+  char metapath[1024];                        /* Spool meta data: key and cache validators */
+  char etag[SPOOL_ETAG_SIZE];                 /* ETag of response */
+  char lastmodified[SPOOL_LASTMODIFIED_SIZE]; /* Last-Modified of response */
+  FILE *fp;                                   /* Spool file being written */
+  void *headers;                              /* Request headers (curl_slist) for conditional requests */
+};
+
+#if defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD)
+/*********************************************************************
+ * Build the key identifying the spool of a URL and requested range as
+ * "URL@START-END".
+ *
+ * Returns an allocated string on success and NULL on error.
+ *********************************************************************/
+static char *
+spool_key (const char *url, int64_t startoffset, int64_t endoffset)
+{
+  char *key;
+  size_t size;
+
+  size = strlen (url) + 43;
+
+  if ((key = (char *)libmseed_memory.malloc (size)) == NULL)
+    return NULL;
+
+  snprintf (key, size, "%s@%" PRId64 "-%" PRId64, url, startoffset, endoffset);
+
+  return key;
+}
+#endif /* defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD) */
+
+/*********************************************************************
+ * Build the path of a spool file for a URL and requested range.
+ *
+ * The file name is a 64-bit FNV-1a hash of "URL@START-END", see
+ * spool_key(), in hexadecimal followed by the specified suffix.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+spool_path (const char *url, int64_t startoffset, int64_t endoffset,
+            const char *suffix, char *path, size_t size)
+{
+  char range[43];
+  uint64_t hash = UINT64_C (14695981039346656037);
+  const unsigned char *ptr;
+  int length;
+
+  if (!gSpoolDir)
+    return -1;
+
+  snprintf (range, sizeof (range), "@%" PRId64 "-%" PRId64, startoffset, endoffset);
+
+  /* Hash the URL and the range in pieces, equivalent to the key */
+  for (ptr = (const unsigned char *)url; *ptr; ptr++)
+  {
+    hash ^= *ptr;
+    hash *= UINT64_C (1099511628211);
+  }
+
+  for (ptr = (const unsigned char *)range; *ptr; ptr++)
+  {
+    hash ^= *ptr;
+    hash *= UINT64_C (1099511628211);
+  }
+
+  length = snprintf (path, size, "%s/%016" PRIx64 "%s", gSpoolDir, hash, suffix);
+
+  if (length < 0 || (size_t)length >= size)
+    return -1;
+
+  return 0;
+}
+
+#if defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD)
+/*********************************************************************
+ * Initialize spooling for a URL or compressed stream.
+ *
+ * If a complete spool file with recorded cache validators exists from
+ * a previous transfer the validators are loaded, for use with
+ * conditional requests.
+ *
+ * Returns spooling parameters on success and NULL on error.
+ *********************************************************************/
+static struct spool_parameters *
+spool_init (const char *url, int64_t startoffset, int64_t endoffset)
+{
+  struct spool_parameters *spool;
+  struct stat sb;
+  char *meta = NULL;
+  char *line;
+  char *next;
+  int keymatch = 0;
+  size_t length;
+  FILE *fp;
+
+  if ((spool = (struct spool_parameters *)libmseed_memory.malloc (sizeof (struct spool_parameters))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for URL spool\n");
+    return NULL;
+  }
+
+  memset (spool, 0, sizeof (struct spool_parameters));
+
+  if ((spool->key = spool_key (url, startoffset, endoffset)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for URL spool\n");
+    libmseed_memory.free (spool);
+    return NULL;
+  }
+
+  if (spool_path (url, startoffset, endoffset, ".mseed", spool->path, sizeof (spool->path)) ||
+      spool_path (url, startoffset, endoffset, ".mseed.part", spool->partpath, sizeof (spool->partpath)) ||
+      spool_path (url, startoffset, endoffset, ".meta", spool->metapath, sizeof (spool->metapath)))
+  {
+    ms_log (2, "Cannot create URL spool file name for %s\n", url);
+    libmseed_memory.free (spool->key);
+    libmseed_memory.free (spool);
+    return NULL;
+  }
+
+  /* Read meta data of an existing spool, the key line is as long as the URL */
+  if (stat (spool->path, &sb) == 0 && stat (spool->metapath, &sb) == 0 &&
+      (fp = fopen (spool->metapath, "r")) != NULL)
+  {
+    if ((meta = (char *)libmseed_memory.malloc ((size_t)sb.st_size + 1)) != NULL)
+    {
+      length       = fread (meta, 1, (size_t)sb.st_size, fp);
+      meta[length] = '\0';
+    }
+
+    fclose (fp);
+  }
+
+  /* Load validators, ignoring values that do not fit as if not present */
+  for (line = meta; line && *line; line = next)
+  {
+    length = strcspn (line, "\r\n");
+    next   = line + length + strspn (line + length, "\r\n");
+    line[length] = '\0';
+
+    if (!strncmp (line, "Key: ", 5))
+    {
+      keymatch = !strcmp (line + 5, spool->key);
+    }
+    else if (!strncmp (line, "ETag: ", 6) && length - 6 < sizeof (spool->etag))
+    {
+      memcpy (spool->etag, line + 6, length - 6 + 1);
+    }
+    else if (!strncmp (line, "Last-Modified: ", 15) && length - 15 < sizeof (spool->lastmodified))
+    {
+      memcpy (spool->lastmodified, line + 15, length - 15 + 1);
+    }
+  }
+
+  libmseed_memory.free (meta);
+
+  /* Ignore validators if the meta data are for a different source */
+  if (!keymatch)
+  {
+    spool->etag[0]         = '\0';
+    spool->lastmodified[0] = '\0';
+  }
+
+  return spool;
+}
+#endif /* defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD) */
+
+/*********************************************************************
+ * Lock and unlock the spool fresh registry.  Without GCC-compatible
+ * atomic builtins the registry is not locked.
+ *********************************************************************/
+static void
+spool_lock (void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  while (__atomic_test_and_set (&spoolfreshlock, __ATOMIC_ACQUIRE))
+    ;
+#endif
+}
+
+static void
+spool_unlock (void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __atomic_clear (&spoolfreshlock, __ATOMIC_RELEASE);
+#endif
+}
+
+/*********************************************************************
+ * Test if a spool file was written or validated by this process, and
+ * if 'complete' is set, contains all data of the source.
+ *
+ * Returns 1 if the spool is fresh and 0 otherwise.
+ *********************************************************************/
+static int
+spool_isfresh (const char *path, int complete)
+{
+  int fresh = 0;
+  int idx;
+
+  spool_lock ();
+
+  for (idx = 0; idx < gSpoolFreshCount; idx++)
+  {
+    if (!strcmp (gSpoolFresh[idx].path, path))
+    {
+      fresh = (complete) ? gSpoolFresh[idx].complete : 1;
+      break;
+    }
+  }
+
+  spool_unlock ();
+
+  return fresh;
+}
+
+#if defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD)
+/*********************************************************************
+ * Register a spool file as written or validated by this process.
+ *********************************************************************/
+static void
+spool_setfresh (const char *path, int complete)
+{
+  struct spool_fresh *fresh;
+  size_t length;
+  int idx;
+
+  spool_lock ();
+
+  for (idx = 0; idx < gSpoolFreshCount; idx++)
+  {
+    if (!strcmp (gSpoolFresh[idx].path, path))
+    {
+      gSpoolFresh[idx].complete = complete;
+      spool_unlock ();
+      return;
+    }
+  }
+
+  length = strlen (path) + 1;
+
+  if ((fresh = (struct spool_fresh *)libmseed_memory.realloc (gSpoolFresh, sizeof (struct spool_fresh) * (gSpoolFreshCount + 1))) == NULL)
+  {
+    spool_unlock ();
+    return;
+  }
+
+  gSpoolFresh = fresh;
+
+  if ((gSpoolFresh[gSpoolFreshCount].path = (char *)libmseed_memory.malloc (length)) == NULL)
+  {
+    spool_unlock ();
+    return;
+  }
+
+  memcpy (gSpoolFresh[gSpoolFreshCount].path, path, length);
+  gSpoolFresh[gSpoolFreshCount].complete = complete;
+  gSpoolFreshCount++;
+
+  spool_unlock ();
+}
+
+/*********************************************************************
+ * Commit a written spool file.
+ *
+ * The partial spool file is renamed into place and registered as
+ * fresh.  When the transfer is 'complete' the meta data are written
+ * for re-use with conditional requests.  Otherwise any stale meta data
+ * are removed so that the (partial) spool is not re-used by later
+ * requests.
+ *
+ * Returns 0 when the spool is complete and -1 otherwise.
+ *********************************************************************/
+static int
+spool_commit (struct spool_parameters *spool, int complete)
+{
+  FILE *fp;
+
+  remove (spool->metapath);
+
+  if (rename (spool->partpath, spool->path))
+  {
+    ms_log (2, "Cannot rename URL spool file %s: %s\n", spool->partpath, strerror (errno));
+    return -1;
+  }
+
+  if (!complete)
+  {
+    spool_setfresh (spool->path, 0);
+    return -1;
+  }
+
+  if ((spool->etag[0] || spool->lastmodified[0]) &&
+      (fp = fopen (spool->metapath, "w")) != NULL)
+  {
+    fprintf (fp, "Key: %s\n", spool->key);
+    if (spool->etag[0])
+      fprintf (fp, "ETag: %s\n", spool->etag);
+    if (spool->lastmodified[0])
+      fprintf (fp, "Last-Modified: %s\n", spool->lastmodified);
+
+    if (fclose (fp))
+      remove (spool->metapath);
+  }
+
+  spool_setfresh (spool->path, 1);
+
+  return 0;
+}
+
+/*********************************************************************
+ * Free spooling parameters, closing and committing the spool file if
+ * open, see spool_commit().
+ *********************************************************************/
+static void
+spool_free (struct spool_parameters *spool, int complete)
+{
+  if (!spool)
+    return;
+
+  if (spool->fp)
+  {
+    if (fclose (spool->fp))
+      complete = 0;
+
+    spool_commit (spool, complete);
+  }
+
+#if defined(LIBMSEED_URL)
+  if (spool->headers)
+    curl_slist_free_all (spool->headers);
+#endif
+
+  libmseed_memory.free (spool->key);
+  libmseed_memory.free (spool);
+}
+#endif /* defined(LIBMSEED_URL) || defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD) */
+
+#if defined(LIBMSEED_URL)
+
+/* Control for enabling debugging information */
+int libmseed_url_debug = -1;
+
+/* Control for SSL peer and host verification */
+long libmseed_ssl_noverify = -1;
+
+/* A global libcurl easy handle for configuration options */
+CURL *gCURLeasy = NULL;
+
+/* A global libcurl list of headers */
+struct curl_slist *gCURLheaders = NULL;
+
+/* Size of libcurl receive buffer, must be smaller than MAXRECLEN */
+#define URL_RECV_BUFFERSIZE 262144L
+
+/* Receving callback parameters */
+struct recv_callback_parameters
+{
+  char *buffer;
+  size_t size;
+  int is_paused;
+  FILE *spool;
+};
+
+/* Header callback parameters */
+struct header_callback_parameters
+{
+  int64_t *startoffset;
+  int64_t *endoffset;
+  char *etag;         /* SPOOL_ETAG_SIZE buffer for ETag */
+  char *lastmodified; /* SPOOL_LASTMODIFIED_SIZE buffer for Last-Modified */
+  int *acceptranges;  /* Set when byte ranges are accepted */
+};
+
+/*********************************************************************
+ * Callback fired when recv'ing data using libcurl.
+ *
+ * The destination buffer pointer and size in the callback parameters
+ * are adjusted as data are added.
+ *
+ * Returns number of bytes added to the destination buffer.
+ *********************************************************************/
+static size_t
+recv_callback (char *buffer, size_t size, size_t num, void *userdata)
+{
+  struct recv_callback_parameters *rcp = (struct recv_callback_parameters *)userdata;
+
+  if (!buffer || !userdata)
+    return 0;
+
+  size *= num;
+
+  /* Pause connection if passed data does not fit into destination buffer */
+  if (size > rcp->size)
+  {
+    rcp->is_paused = 1;
+    return CURL_WRITEFUNC_PAUSE;
+  }
+  /* Otherwise, copy data to destination buffer */
+  else
+  {
+    memcpy (rcp->buffer, buffer, size);
+    rcp->buffer += size;
+    rcp->size -= size;
+
+    /* Copy data to spool file, returning 0 to abort the transfer on error */
+    if (rcp->spool && size > 0 && fwrite (buffer, size, 1, rcp->spool) != 1)
+    {
+      ms_log (2, "Cannot write to URL spool file: %s\n", strerror (errno));
+      return 0;
+    }
+  }
+
+  return size;
+}
+
+/*********************************************************************
+ * Copy a header value, skipping leading white space and stopping at
+ * end of line, to a NULL-terminated destination string.  A value that
+ * does not fit is rejected, leaving an empty destination, so that a
+ * truncated cache validator is never used.
+ *********************************************************************/
+static void
+header_value (const char *value, size_t size, char *dest, size_t destsize)
+{
+  size_t idx = 0;
+
+  while (size > 0 && (*value == ' ' || *value == '\t'))
+  {
+    value++;
+    size--;
+  }
+
+  while (size > 0 && *value != '\r' && *value != '\n')
+  {
+    if (idx >= (destsize - 1))
+    {
+      dest[0] = '\0';
+      return;
+    }
+
+    dest[idx++] = *value++;
+    size--;
+  }
+
+  dest[idx] = '\0';
+}
+
+/*********************************************************************
+ * Callback fired when receiving headers using libcurl.
+ *
+ * Returns number of bytes processed for success.
+ *********************************************************************/
+static size_t
+header_callback (char *buffer, size_t size, size_t num, void *userdata)
+{
+  struct header_callback_parameters *hcp = (struct header_callback_parameters *)userdata;
+
+  char startstr[21] = {0}; /* Maximum of 20 digit value */
+  char endstr[21]   = {0}; /* Maximum of 20 digit value */
+  int startdigits   = 0;
+  int enddigits     = 0;
+  char *dash        = NULL;
+  char *ptr;
+
+  if (!buffer || !userdata)
+    return 0;
+
+  size *= num;
+
+  /* Parse and store: "Content-Range: bytes START-END/TOTAL"
+   * e.g. Content-Range: bytes 512-1023/4096 */
+  if (size > 22 && strncasecmp (buffer, "Content-Range: bytes", 20) == 0)
+  {
+    /* Process each character, starting just afer "bytes" unit */
+    for (ptr = buffer + 20; *ptr != '\0' && (size_t)(ptr - buffer) < size; ptr++)
+    {
+      /* Skip spaces before start of range */
+      if (*ptr == ' ' && startdigits == 0)
+        continue;
+      /* Digits before dash, part of start */
+      else if (isdigit (*ptr) && dash == NULL)
+        startstr[startdigits++] = *ptr;
+      /* Digits after dash, part of end */
+      else if (isdigit (*ptr) && dash != NULL)
+        endstr[enddigits++] = *ptr;
+      /* If first dash found, store pointer */
+      else if (*ptr == '-' && dash == NULL)
+        dash = ptr;
+      /* Nothing else is part of the range */
+      else
+        break;
+
+      /* If digit sequences have exceeded limits, not a valid range */
+      if ((size_t)startdigits >= sizeof (startstr) || (size_t)enddigits >= sizeof (endstr))
+      {
+        startdigits = 0;
+        enddigits   = 0;
+        break;
+      }
+    }
+
+    /* Convert start and end values to numbers if non-zero length */
+    if (hcp->startoffset && startdigits)
+      *hcp->startoffset = (int64_t) strtoull (startstr, NULL, 10);
+
+    if (hcp->endoffset && enddigits)
+      *hcp->endoffset = (int64_t) strtoull (endstr, NULL, 10);
+  }
+
+  /* Capture cache validators and range support, reset at each status
+   * line as headers for all responses (e.g. redirects) are passed */
+  if (size > 5 && strncasecmp (buffer, "HTTP/", 5) == 0)
+  {
+    if (hcp->etag)
+      hcp->etag[0] = '\0';
+    if (hcp->lastmodified)
+      hcp->lastmodified[0] = '\0';
+    if (hcp->acceptranges)
+      *hcp->acceptranges = 0;
+  }
+  else if (hcp->etag && size > 5 && strncasecmp (buffer, "ETag:", 5) == 0)
+  {
+    header_value (buffer + 5, size - 5, hcp->etag, SPOOL_ETAG_SIZE);
+  }
+  else if (hcp->lastmodified && size > 14 && strncasecmp (buffer, "Last-Modified:", 14) == 0)
+  {
+    header_value (buffer + 14, size - 14, hcp->lastmodified, SPOOL_LASTMODIFIED_SIZE);
+  }
+  else if (hcp->acceptranges && size > 20 && strncasecmp (buffer, "Accept-Ranges: bytes", 20) == 0)
+  {
+    *hcp->acceptranges = 1;
+  }
+
+  return size;
+}
+
+/*********************************************************************
+ * Set up conditional request headers for a spool with a recorded
+ * ETag, so the server can respond with 304 (Not Modified) and the
+ * spool is re-used.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+spool_headers (struct spool_parameters *spool)
+{
+  struct curl_slist *slist;
+  struct curl_slist *headers = NULL;
+  char header[300];
+
+  if (spool->etag[0])
+  {
+    for (slist = gCURLheaders; slist; slist = slist->next)
+    {
+      if ((headers = curl_slist_append (headers, slist->data)) == NULL)
+        break;
+    }
+
+    snprintf (header, sizeof (header), "If-None-Match: %s", spool->etag);
+
+    if ((slist = curl_slist_append (headers, header)) == NULL)
+    {
+      ms_log (2, "Error adding header to list: %s\n", header);
+      if (headers)
+        curl_slist_free_all (headers);
+      return -1;
+    }
+
+    spool->headers = slist;
+  }
+
+  return 0;
+}
+
+/*********************************************************************
+ * Set URL debugging and SSL verification controls from environment
+ * variables when not already set.
+ *********************************************************************/
+static void
+url_getenv (void)
+{
+  /* Check for URL debugging environment variable */
+  if (libmseed_url_debug < 0)
+  {
+    if (getenv ("LIBMSEED_URL_DEBUG"))
+      libmseed_url_debug = 1;
+    else
+      libmseed_url_debug = 0;
+  }
+
+  /* Check for SSL peer/host verify environment variable */
+  if (libmseed_ssl_noverify < 0)
+  {
+    if (getenv ("LIBMSEED_SSL_NOVERIFY"))
+      libmseed_ssl_noverify = 1;
+    else
+      libmseed_ssl_noverify = 0;
+  }
+}
+
+/*********************************************************************
+ * Initialize a libcurl easy handle with common options for a URL.
+ *
+ * Returns initialized handle on success and NULL on error.
+ *********************************************************************/
+static CURL *
+url_easy_init (const char *path)
+{
+  CURL *easy;
+
+  url_getenv ();
+
+  /* Configure the libcurl easy handle, duplicate global options if present */
+  easy = (gCURLeasy) ? curl_easy_duphandle (gCURLeasy) : curl_easy_init ();
+
+  if (easy == NULL)
+  {
+    ms_log (2, "Cannot initialize CURL handle\n");
+    return NULL;
+  }
+
+  /* URL debug */
+  if (libmseed_url_debug && curl_easy_setopt (easy, CURLOPT_VERBOSE, 1L) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set CURLOPT_VERBOSE\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* SSL peer and host verification */
+  if (libmseed_ssl_noverify &&
+      (curl_easy_setopt (easy, CURLOPT_SSL_VERIFYPEER, 0L) != CURLE_OK ||
+       curl_easy_setopt (easy, CURLOPT_SSL_VERIFYHOST, 0L) != CURLE_OK))
+  {
+    ms_log (2, "Cannot set CURLOPT_SSL_VERIFYPEER and/or CURLOPT_SSL_VERIFYHOST\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Set URL */
+  if (curl_easy_setopt (easy, CURLOPT_URL, path) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set CURLOPT_URL\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Set default User-Agent header, can be overridden via custom header */
+  if (curl_easy_setopt (easy, CURLOPT_USERAGENT,
+                        "libmseed/" LIBMSEED_VERSION " libcurl/" LIBCURL_VERSION) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set default CURLOPT_USERAGENT\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Disable signals */
+  if (curl_easy_setopt (easy, CURLOPT_NOSIGNAL, 1L) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set CURLOPT_NOSIGNAL\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Return failure codes on errors */
+  if (curl_easy_setopt (easy, CURLOPT_FAILONERROR, 1L) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set CURLOPT_FAILONERROR\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Follow HTTP redirects */
+  if (curl_easy_setopt (easy, CURLOPT_FOLLOWLOCATION, 1L) != CURLE_OK)
+  {
+    ms_log (2, "Cannot set CURLOPT_FOLLOWLOCATION\n");
+    curl_easy_cleanup (easy);
+    return NULL;
+  }
+
+  /* Larger receive buffer for fewer callbacks, a request not a requirement */
+  curl_easy_setopt (easy, CURLOPT_BUFFERSIZE, URL_RECV_BUFFERSIZE);
+
+  return easy;
+}
+
+/*********************************************************************
+ * Wait for activity on the transfers of a multi handle, or until
+ * 'timeout' milliseconds pass.
+ *
+ * curl_multi_poll() is used when available, otherwise
+ * curl_multi_wait(), which returns immediately when there are no
+ * sockets to wait on (e.g. during name resolution) and is followed
+ * by a short sleep in that case.
+ *
+ * Returns CURLM_OK on success and a libcurl error code otherwise.
+ *********************************************************************/
+static CURLMcode
+url_multi_wait (CURLM *multi, int timeout)
+{
+#if LIBCURL_VERSION_NUM >= 0x074200
+  return curl_multi_poll (multi, NULL, 0, timeout, NULL);
+#else
+  CURLMcode rc;
+  int numfds = 0;
+
+  rc = curl_multi_wait (multi, NULL, 0, timeout, &numfds);
+
+  if (rc == CURLM_OK && numfds == 0)
+    lmp_nanosleep (10000000);
+
+  return rc;
+#endif
+}
+
+/* Maximum number of range requests an object is split into */
+#define PREFETCH_MAXPIECES 64
+
+/* Prefetch state for a URL */
+struct prefetch_url
+{
+  const char *path;                           /* URL without byte range */
+  int64_t startoffset;                        /* Requested start offset */
+  int64_t endoffset;                          /* Requested end offset, 0 == end of object */
+  int64_t length;                             /* Content length, -1 if unknown */
+  int acceptranges;                           /* Server accepts byte ranges */
+  char etag[SPOOL_ETAG_SIZE];                 /* ETag from HEAD request */
+  char lastmodified[SPOOL_LASTMODIFIED_SIZE]; /* Last-Modified from HEAD request */
+  struct spool_parameters *spool;             /* Spool, with validators of an existing spool */
+  struct curl_slist *headers;                 /* Request headers for range pieces */
+  int pending;                                /* Count of transfers in progress */
+  int failed;                                 /* Flag indicating failed transfer */
+  int done;                                   /* Flag indicating URL is spooled */
+};
+
+/* Prefetch state for a transfer, either a HEAD request or a piece of a URL */
+struct prefetch_transfer
+{
+  struct prefetch_url *url;
+  struct header_callback_parameters hcp;
+  CURL *easy;
+  int64_t offset; /* Offset of first byte of piece */
+  int single;     /* Only piece, a full (200) response is acceptable */
+  int started;    /* Flag set when data are first received */
+  FILE *fp;       /* Spool file for piece */
+};
+
+/*********************************************************************
+ * Callback fired when receiving prefetched data using libcurl.
+ *
+ * Data are written to the spool file at the offset of the piece.  A
+ * full response (not 206) is only accepted for a single piece and is
+ * written from the start of the file.
+ *
+ * Returns number of bytes written, 0 aborts the transfer.
+ *********************************************************************/
+static size_t
+prefetch_callback (char *buffer, size_t size, size_t num, void *userdata)
+{
+  struct prefetch_transfer *pt = (struct prefetch_transfer *)userdata;
+  long response_code = 0;
+
+  if (!buffer || !userdata)
+    return 0;
+
+  size *= num;
+
+  if (!pt->started)
+  {
+    curl_easy_getinfo (pt->easy, CURLINFO_RESPONSE_CODE, &response_code);
+
+    if (response_code != 206)
+    {
+      if (!pt->single)
+        return 0;
+
+      pt->offset = 0;
+    }
+
+    if (lmp_fseek64 (pt->fp, pt->offset, SEEK_SET))
+      return 0;
+
+    pt->started = 1;
+  }
+
+  if (size > 0 && fwrite (buffer, size, 1, pt->fp) != 1)
+    return 0;
+
+  return size;
+}
+
+/*********************************************************************
+ * Run all transfers in a multi handle to completion, calling 'done'
+ * for each completed transfer after the easy handle is cleaned up.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+prefetch_run (CURLM *multi, void (*done) (struct prefetch_transfer *, CURLcode))
+{
+  struct prefetch_transfer *pt;
+  CURLMsg *msg;
+  CURLcode result;
+  CURL *easy;
+  int running = 1;
+  int msgs;
+
+  while (running)
+  {
+    if (curl_multi_perform (multi, &running) != CURLM_OK)
+    {
+      ms_log (2, "Error with curl_multi_perform()\n");
+      return -1;
+    }
+
+    while ((msg = curl_multi_info_read (multi, &msgs)))
+    {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      easy   = msg->easy_handle;
+      result = msg->data.result;
+      pt     = NULL;
+
+      curl_easy_getinfo (easy, CURLINFO_PRIVATE, (char **)&pt);
+      curl_multi_remove_handle (multi, easy);
+
+      done (pt, result);
+
+      curl_easy_cleanup (easy);
+    }
+
+    if (running && url_multi_wait (multi, 1000) != CURLM_OK)
+    {
+      ms_log (2, "Error waiting for URL transfers\n");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* Completion of HEAD request: object length and validators */
+static void
+prefetch_head_done (struct prefetch_transfer *pt, CURLcode result)
+{
+  curl_off_t length = -1;
+
+  if (result == CURLE_OK &&
+      curl_easy_getinfo (pt->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK &&
+      length >= 0)
+    pt->url->length = (int64_t)length;
+
+  pt->url->pending--;
+  libmseed_memory.free (pt);
+}
+
+/* Completion of piece transfer: commit spool when all pieces are done */
+static void
+prefetch_piece_done (struct prefetch_transfer *pt, CURLcode result)
+{
+  struct prefetch_url *url = pt->url;
+
+  if (fclose (pt->fp) || result != CURLE_OK)
+    url->failed = 1;
+
+  if (result != CURLE_OK)
+    ms_log (1, "Cannot prefetch %s: %s\n", url->path, curl_easy_strerror (result));
+
+  libmseed_memory.free (pt);
+
+  if (--url->pending > 0)
+    return;
+
+  if (url->failed)
+    remove (url->spool->partpath);
+  else if (spool_commit (url->spool, 1) == 0)
+    url->done = 1;
+}
+
+/*********************************************************************
+ * Add a transfer for a URL to a multi handle.
+ *
+ * For a HEAD request, 'head' is non-zero and the range is not used.
+ * Otherwise the inclusive byte range 'start' to 'end' is requested,
+ * where a negative 'end' means to the end of the object and no range
+ * is requested when 'start' is 0 and 'end' is negative.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+prefetch_add (CURLM *multi, struct prefetch_url *url, int head,
+              int64_t start, int64_t end, int single)
+{
+  struct prefetch_transfer *pt;
+  struct curl_slist *headers;
+  char rangestr[42];
+
+  if ((pt = (struct prefetch_transfer *)libmseed_memory.malloc (sizeof (struct prefetch_transfer))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for prefetch transfer\n");
+    return -1;
+  }
+
+  memset (pt, 0, sizeof (struct prefetch_transfer));
+  pt->url    = url;
+  pt->offset = start;
+  pt->single = single;
+
+  if ((pt->easy = url_easy_init (url->path)) == NULL)
+  {
+    libmseed_memory.free (pt);
+    return -1;
+  }
+
+  if (head)
+  {
+    pt->hcp.etag         = url->etag;
+    pt->hcp.lastmodified = url->lastmodified;
+    pt->hcp.acceptranges = &url->acceptranges;
+    headers              = gCURLheaders;
+  }
+  else
+  {
+    /* Track actual start of range returned for a single piece */
+    pt->hcp.startoffset  = &pt->offset;
+
+    /* Capture validators of a single transfer, pieces use those from HEAD */
+    if (single)
+    {
+      pt->hcp.etag         = url->spool->etag;
+      pt->hcp.lastmodified = url->spool->lastmodified;
+    }
+
+    headers = (url->headers) ? url->headers : gCURLheaders;
+
+    if ((pt->fp = fopen (url->spool->partpath, "r+b")) == NULL)
+    {
+      ms_log (2, "Cannot open URL spool file %s: %s\n", url->spool->partpath, strerror (errno));
+      curl_easy_cleanup (pt->easy);
+      libmseed_memory.free (pt);
+      return -1;
+    }
+  }
+
+  if ((head && curl_easy_setopt (pt->easy, CURLOPT_NOBODY, 1L) != CURLE_OK) ||
+      (!head && curl_easy_setopt (pt->easy, CURLOPT_WRITEFUNCTION, prefetch_callback) != CURLE_OK) ||
+      (!head && curl_easy_setopt (pt->easy, CURLOPT_WRITEDATA, (void *)pt) != CURLE_OK) ||
+      curl_easy_setopt (pt->easy, CURLOPT_HEADERFUNCTION, header_callback) != CURLE_OK ||
+      curl_easy_setopt (pt->easy, CURLOPT_HEADERDATA, (void *)&pt->hcp) != CURLE_OK ||
+      curl_easy_setopt (pt->easy, CURLOPT_PRIVATE, (void *)pt) != CURLE_OK ||
+      (headers && curl_easy_setopt (pt->easy, CURLOPT_HTTPHEADER, headers) != CURLE_OK))
+  {
+    ms_log (2, "Cannot set options for prefetch of %s\n", url->path);
+    curl_easy_cleanup (pt->easy);
+    if (pt->fp)
+      fclose (pt->fp);
+    libmseed_memory.free (pt);
+    return -1;
+  }
+
+  /* Set byte range */
+  if (!head && (start > 0 || end >= 0))
+  {
+    if (end >= 0)
+      snprintf (rangestr, sizeof (rangestr), "%" PRId64 "-%" PRId64, start, end);
+    else
+      snprintf (rangestr, sizeof (rangestr), "%" PRId64 "-", start);
+
+    if (curl_easy_setopt (pt->easy, CURLOPT_RANGE, rangestr) != CURLE_OK)
+    {
+      ms_log (2, "Cannot set CURLOPT_RANGE to '%s'\n", rangestr);
+      curl_easy_cleanup (pt->easy);
+      fclose (pt->fp);
+      libmseed_memory.free (pt);
+      return -1;
+    }
+  }
+
+  if (curl_multi_add_handle (multi, pt->easy) != CURLM_OK)
+  {
+    ms_log (2, "Cannot add CURL handle to multi handle\n");
+    curl_easy_cleanup (pt->easy);
+    if (pt->fp)
+      fclose (pt->fp);
+    libmseed_memory.free (pt);
+    return -1;
+  }
+
+  url->pending++;
+
+  return 0;
+}
+
+/*********************************************************************
+ * Set up the transfers to spool a URL after the HEAD request.
+ *
+ * The URL is already spooled if an existing spool has the same
+ * validators as reported by the HEAD request.  Otherwise the object
+ * (or requested range) is fetched, split into range requests of
+ * 'splitsize' bytes when the length is known and the server accepts
+ * ranges.
+ *
+ * Returns number of transfers added or -1 on error.
+ *********************************************************************/
+static int
+prefetch_plan (CURLM *multi, struct prefetch_url *url, int64_t splitsize, int8_t verbose)
+{
+  struct spool_parameters *spool = url->spool;
+  struct curl_slist *slist;
+  char header[300];
+  int64_t start = url->startoffset;
+  int64_t end   = -1;
+  int64_t piece;
+  int64_t pieces;
+  FILE *fp;
+
+  /* Existing spool is current */
+  if ((spool->etag[0] && !strcmp (spool->etag, url->etag)) ||
+      (!spool->etag[0] && spool->lastmodified[0] && !strcmp (spool->lastmodified, url->lastmodified)))
+  {
+    if (verbose > 1)
+      ms_log (1, "Spooled data for %s are current\n", url->path);
+
+    spool_setfresh (spool->path, 1);
+    url->done = 1;
+    return 0;
+  }
+
+  /* Determine end of data to fetch, inclusive */
+  if (url->endoffset > 0)
+    end = url->endoffset;
+  if (url->length > 0 && (end < 0 || end > url->length - 1))
+    end = url->length - 1;
+
+  /* Validators of spool are those reported by HEAD request */
+  strcpy (spool->etag, url->etag);
+  strcpy (spool->lastmodified, url->lastmodified);
+
+  /* Create (truncate) spool file, written by each piece */
+  if ((fp = fopen (spool->partpath, "wb")) == NULL || fclose (fp))
+  {
+    ms_log (2, "Cannot create URL spool file %s: %s\n", spool->partpath, strerror (errno));
+    return -1;
+  }
+
+  /* Fetch in a single transfer when splitting is not possible */
+  if (splitsize <= 0 || !url->acceptranges || end < 0 || (end - start + 1) <= splitsize)
+  {
+    if (verbose > 1)
+      ms_log (1, "Prefetching %s\n", url->path);
+
+    return (prefetch_add (multi, url, 0, start,
+                          (url->endoffset > 0) ? end : -1, 1)) ? -1 : 1;
+  }
+
+  /* Limit the number of pieces */
+  pieces = (end - start + splitsize) / splitsize;
+  if (pieces > PREFETCH_MAXPIECES)
+  {
+    splitsize = (end - start + PREFETCH_MAXPIECES) / PREFETCH_MAXPIECES;
+    pieces    = (end - start + splitsize) / splitsize;
+  }
+
+  /* Require the object to be unchanged between pieces */
+  if (url->etag[0])
+  {
+    for (slist = gCURLheaders; slist; slist = slist->next)
+    {
+      if ((url->headers = curl_slist_append (url->headers, slist->data)) == NULL)
+        break;
+    }
+
+    snprintf (header, sizeof (header), "If-Match: %s", url->etag);
+
+    if ((slist = curl_slist_append (url->headers, header)) == NULL)
+    {
+      ms_log (2, "Error adding header to list: %s\n", header);
+      return -1;
+    }
+
+    url->headers = slist;
+  }
+
+  if (verbose > 1)
+    ms_log (1, "Prefetching %s in %" PRId64 " ranges\n", url->path, pieces);
+
+  for (piece = start; piece <= end; piece += splitsize)
+  {
+    if (prefetch_add (multi, url, 0, piece,
+                      (piece + splitsize - 1 < end) ? piece + splitsize - 1 : end, 0))
+    {
+      url->failed = 1;
+      break;
+    }
+  }
+
+  return (int)pieces;
+}
+
+#endif /* defined(LIBMSEED_URL) */
+
+
+#if defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD)
+/*********************************************************************
+ * Set up spooling of data decompressed from a file, written at their
+ * offset in the decompressed source.
+ *
+ * Return 0 on success and -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+static int
+spool_decompressed (LMIO *io, const char *path, int64_t start, int64_t end)
+{
+  struct spool_parameters *spool;
+
+  if ((spool = spool_init (path, start, end)) == NULL)
+    return -1;
+
+  io->spool = spool;
+
+  if ((spool->fp = fopen (spool->partpath, "wb")) == NULL)
+  {
+    ms_log (2, "Cannot open spool file %s: %s\n", spool->partpath, strerror (errno));
+    return -1;
+  }
+
+  if (start > 0 && lmp_fseek64 (spool->fp, start, SEEK_SET))
+  {
+    ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", spool->partpath, start);
+    return -1;
+  }
+
+  return 0;
+}
+#endif /* defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD) */
+
+/*********************************************************************
+ * Open a gzip-compressed file for reading with decompression.  A
+ * start offset, in decompressed bytes, is reached by decompressing
+ * and discarding the leading data.
+ *
+ * When a spool directory is set the decompressed data are written to
+ * a spool file at the same offsets.  A complete spool written by this
+ * process is read directly instead of decompressing again.
+ *
+ * Return 0 on success and -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+static int
+gzip_open (LMIO *io, const char *path, int64_t *startoffset, int64_t *endoffset)
+{
+#if !defined(LIBMSEED_ZLIB)
+  (void)io; /* Unused */
+  (void)startoffset; /* Unused */
+  (void)endoffset; /* Unused */
+  ms_log (2, "gzip support not included in library for %s\n", path);
+  return -1;
+#else
+  char spoolpath[1024];
+  int64_t start = (startoffset) ? *startoffset : 0;
+  int64_t end = (endoffset) ? *endoffset : 0;
+
+  /* Read spool file directly if completed by this process */
+  if (gSpoolDir &&
+      !spool_path (path, start, end, ".mseed", spoolpath, sizeof (spoolpath)) &&
+      spool_isfresh (spoolpath, 1))
+    return msio_fopen (io, spoolpath, "rb", startoffset, NULL);
+
+  io->type = LMIO_GZIP;
+
+  if ((io->handle = gzopen (path, "rb")) == NULL)
+  {
+    ms_log (2, "Cannot open: %s (%s)\n", path, strerror (errno));
+    return -1;
+  }
+
+  gzbuffer (io->handle, GZIP_BUFFERSIZE);
+
+  /* Seek to position by decompressing if start offset is provided */
+  if (start > 0 && gzseek (io->handle, (z_off_t)start, SEEK_SET) != (z_off_t)start)
+  {
+    ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", path, start);
+    return -1;
+  }
+
+  /* Set up spooling of decompressed data, written at their offset in the source */
+  if (gSpoolDir && spool_decompressed (io, path, start, end))
+    return -1;
+
+  return 0;
+#endif /* defined(LIBMSEED_ZLIB) */
+}
+
+#if defined(LIBMSEED_ZSTD)
+/*********************************************************************
+ * Decompress up to 'size' bytes of a zstd-compressed file into
+ * 'buffer', reading compressed data from 'fp' as needed.  Files of
+ * multiple concatenated frames are decompressed in sequence.
+ *
+ * Returns the number of bytes decompressed, 0 at the end of the data,
+ * and -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+static int64_t
+zstd_read (struct zstd_stream *zs, FILE *fp, void *buffer, size_t size)
+{
+  ZSTD_outBuffer output = {buffer, size, 0};
+  size_t produced;
+  size_t consumed;
+  size_t rv;
+
+  while (output.pos < output.size && !zs->eof)
+  {
+    if (zs->input.pos == zs->input.size && !zs->inputeof)
+    {
+      zs->input.size = fread (zs->inputbuffer, 1, zs->inputsize, fp);
+      zs->input.pos  = 0;
+
+      if (zs->input.size == 0)
+      {
+        if (ferror (fp))
+        {
+          ms_log (2, "Cannot read compressed data: %s\n", strerror (errno));
+          return -1;
+        }
+
+        zs->inputeof = 1;
+      }
+    }
+
+    produced = output.pos;
+    consumed = zs->input.pos;
+    rv = ZSTD_decompressStream (zs->dctx, &output, &zs->input);
+
+    if (ZSTD_isError (rv))
+    {
+      ms_log (2, "Error decompressing: %s\n", ZSTD_getErrorName (rv));
+      return -1;
+    }
+
+    /* A return of 0 marks the end of a frame, calls without progress
+     * only return a hint for the header of a following frame */
+    if (output.pos != produced || zs->input.pos != consumed)
+    {
+      zs->framecomplete = (rv == 0);
+    }
+    /* End when all input is consumed and nothing more is flushed */
+    else if (zs->inputeof && zs->input.pos == zs->input.size)
+    {
+      if (!zs->framecomplete)
+      {
+        ms_log (2, "Error decompressing: compressed data are truncated\n");
+        return -1;
+      }
+
+      zs->eof = 1;
+    }
+  }
+
+  return (int64_t)output.pos;
+}
+#endif /* defined(LIBMSEED_ZSTD) */
+
+/*********************************************************************
+ * Open a zstd-compressed file for reading with streaming
+ * decompression.  As with gzip_open(), a start offset in decompressed
+ * bytes is reached by decompressing and discarding the leading data
+ * and the decompressed data are spooled when a spool directory is set.
+ *
+ * Return 0 on success and -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+static int
+zstd_open (LMIO *io, const char *path, int64_t *startoffset, int64_t *endoffset)
+{
+#if !defined(LIBMSEED_ZSTD)
+  (void)io; /* Unused */
+  (void)startoffset; /* Unused */
+  (void)endoffset; /* Unused */
+  ms_log (2, "zstd support not included in library for %s\n", path);
+  return -1;
+#else
+  struct zstd_stream *zs;
+  char spoolpath[1024];
+  char discard[4096];
+  int64_t start = (startoffset) ? *startoffset : 0;
+  int64_t end = (endoffset) ? *endoffset : 0;
+  int64_t remaining;
+  int64_t rv;
+
+  /* Read spool file directly if completed by this process */
+  if (gSpoolDir &&
+      !spool_path (path, start, end, ".mseed", spoolpath, sizeof (spoolpath)) &&
+      spool_isfresh (spoolpath, 1))
+    return msio_fopen (io, spoolpath, "rb", startoffset, NULL);
+
+  io->type = LMIO_ZSTD;
+
+  if ((io->handle = fopen (path, "rb")) == NULL)
+  {
+    ms_log (2, "Cannot open: %s (%s)\n", path, strerror (errno));
+    return -1;
+  }
+
+  if ((zs = (struct zstd_stream *)libmseed_memory.malloc (sizeof (struct zstd_stream))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for zstd stream\n");
+    return -1;
+  }
+
+  memset (zs, 0, sizeof (struct zstd_stream));
+  io->handle2 = zs;
+
+  zs->inputsize = ZSTD_DStreamInSize ();
+
+  if ((zs->dctx = ZSTD_createDCtx ()) == NULL ||
+      (zs->inputbuffer = (char *)libmseed_memory.malloc (zs->inputsize)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for zstd decompression\n");
+    return -1;
+  }
+
+  zs->input.src = zs->inputbuffer;
+
+  /* Seek to position by decompressing if start offset is provided */
+  for (remaining = start; remaining > 0; remaining -= rv)
+  {
+    rv = zstd_read (zs, io->handle, discard,
+                    (remaining < (int64_t)sizeof (discard)) ? (size_t)remaining : sizeof (discard));
+
+    if (rv <= 0)
+    {
+      ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", path, start);
+      return -1;
+    }
+  }
+
+  /* Set up spooling of decompressed data, written at their offset in the source */
+  if (gSpoolDir && spool_decompressed (io, path, start, end))
+    return -1;
+
+  return 0;
+#endif /* defined(LIBMSEED_ZSTD) */
+}
+
+/*********************************************************************
+ * msio_pread:
+ *
+ * Read 'length' bytes at 'offset' from a file descriptor, retrying
+ * short and interrupted reads until the length is read or end of file.
+ *
+ * Returns the number of bytes read or a negative errno on error.
+ *********************************************************************/
+int64_t
+msio_pread (int fd, char *buffer, size_t length, int64_t offset)
+{
+  size_t total = 0;
+
+  while (total < length)
+  {
+#if defined(LMP_WIN)
+    int rv = -1;
+
+    if (_lseeki64 (fd, offset + total, SEEK_SET) >= 0)
+      rv = _read (fd, buffer + total, (unsigned int)((length - total > INT_MAX) ? INT_MAX : length - total));
+#else
+    ssize_t rv = pread (fd, buffer + total, length - total, (off_t)(offset + total));
+#endif
+
+    if (rv < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return -errno;
+    }
+
+    if (rv == 0)
+      break;
+
+    total += rv;
+  }
+
+  return (int64_t)total;
+}
+
+#if defined(LIBMSEED_IOURING)
+/***************************************************************************
+ * Set up an io_uring with submission and completion rings mapped, and
+ * register the destination buffer if possible.
+ *
+ * Returns 0 on success and -1 when io_uring is not available.
+ ***************************************************************************/
+static int
+uring_setup (MS3IOQueue *ioq)
+{
+  struct io_uring_params params;
+  struct iovec iov;
+  int fd;
+
+  memset (&params, 0, sizeof (params));
+
+  if ((fd = (int)syscall (__NR_io_uring_setup, (unsigned)ioq->depth, &params)) < 0)
+    return -1;
+
+  ioq->sqringsize = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  ioq->cqringsize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+  ioq->sqessize   = params.sq_entries * sizeof (struct io_uring_sqe);
+
+  /* Both rings share a single mapping with IORING_FEAT_SINGLE_MMAP */
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (ioq->cqringsize > ioq->sqringsize)
+      ioq->sqringsize = ioq->cqringsize;
+    ioq->cqringsize = ioq->sqringsize;
+  }
+
+  ioq->sqring = mmap (NULL, ioq->sqringsize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+  if (ioq->sqring == MAP_FAILED)
+  {
+    close (fd);
+    return -1;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    ioq->cqring = ioq->sqring;
+  }
+  else if ((ioq->cqring = mmap (NULL, ioq->cqringsize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+  {
+    munmap (ioq->sqring, ioq->sqringsize);
+    close (fd);
+    return -1;
+  }
+
+  ioq->sqes = mmap (NULL, ioq->sqessize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  if (ioq->sqes == MAP_FAILED)
+  {
+    if (ioq->cqring != ioq->sqring)
+      munmap (ioq->cqring, ioq->cqringsize);
+    munmap (ioq->sqring, ioq->sqringsize);
+    close (fd);
+    return -1;
+  }
+
+  ioq->sqtail  = (unsigned *)((char *)ioq->sqring + params.sq_off.tail);
+  ioq->sqmask  = (unsigned *)((char *)ioq->sqring + params.sq_off.ring_mask);
+  ioq->sqarray = (unsigned *)((char *)ioq->sqring + params.sq_off.array);
+  ioq->cqhead  = (unsigned *)((char *)ioq->cqring + params.cq_off.head);
+  ioq->cqtail  = (unsigned *)((char *)ioq->cqring + params.cq_off.tail);
+  ioq->cqmask  = (unsigned *)((char *)ioq->cqring + params.cq_off.ring_mask);
+  ioq->cqes    = (struct io_uring_cqe *)((char *)ioq->cqring + params.cq_off.cqes);
+  ioq->queued  = 0;
+  ioq->ringfd  = fd;
+
+  /* Register destination buffer for fixed buffer reads, not required */
+  if (ioq->fixed)
+  {
+    iov.iov_base = ioq->fixed;
+    iov.iov_len  = ioq->fixedsize;
+
+    if (syscall (__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+      ioq->fixed = NULL;
+  }
+
+  return 0;
+}
+
+/***************************************************************************
+ * Unmap rings and close an io_uring set up with uring_setup().
+ ***************************************************************************/
+static void
+uring_free (MS3IOQueue *ioq)
+{
+  munmap (ioq->sqes, ioq->sqessize);
+  if (ioq->cqring != ioq->sqring)
+    munmap (ioq->cqring, ioq->cqringsize);
+  munmap (ioq->sqring, ioq->sqringsize);
+  close (ioq->ringfd);
+
+  ioq->ringfd = -1;
+}
+#endif /* defined(LIBMSEED_IOURING) */
+
+/***************************************************************************
+ * Queue an asynchronous read for a request, submitted to the kernel
+ * with the next ioqueue_submit() or ioqueue_complete().  The number of
+ * requests in flight must not exceed the queue depth.
+ ***************************************************************************/
+static void
+ioqueue_queue (MS3IOQueue *ioq, MS3IORequest *request)
+{
+#if defined(LIBMSEED_IOURING)
+  struct io_uring_sqe *sqe;
+  unsigned tail;
+  unsigned index;
+
+  tail  = *ioq->sqtail;
+  index = tail & *ioq->sqmask;
+  sqe   = &ioq->sqes[index];
+
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->fd        = request->fd;
+  sqe->off       = (uint64_t)request->offset;
+  sqe->addr      = (uint64_t)(uintptr_t)request->buffer;
+  sqe->len       = (uint32_t)request->length;
+  sqe->user_data = (uint64_t)(uintptr_t)request;
+
+  /* Use fixed buffer reads for destinations in the registered buffer */
+  if (ioq->fixed && request->buffer >= ioq->fixed &&
+      request->buffer + request->length <= ioq->fixed + ioq->fixedsize)
+  {
+    sqe->opcode    = IORING_OP_READ_FIXED;
+    sqe->buf_index = 0;
+  }
+  else
+  {
+    sqe->opcode = IORING_OP_READ;
+  }
+
+  ioq->sqarray[index] = index;
+  __atomic_store_n (ioq->sqtail, tail + 1, __ATOMIC_RELEASE);
+  ioq->queued++;
+#else
+  (void)ioq;
+  (void)request;
+#endif
+
+  request->result = IOQUEUE_INFLIGHT;
+}
+
+/***************************************************************************
+ * Submit queued reads to the kernel, optionally waiting for at least one
+ * completion.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+ioqueue_submit (MS3IOQueue *ioq, int wait)
+{
+#if defined(LIBMSEED_IOURING)
+  int rv;
+
+  if (ioq->queued == 0 && !wait)
+    return 0;
+
+  while ((rv = (int)syscall (__NR_io_uring_enter, ioq->ringfd, ioq->queued, (wait) ? 1 : 0,
+                             (wait) ? IORING_ENTER_GETEVENTS : 0, NULL, 0)) < 0)
+  {
+    if (errno != EINTR)
+    {
+      ms_log (2, "Error submitting reads to io_uring: %s\n", strerror (errno));
+      return -1;
+    }
+  }
+
+  ioq->queued -= (unsigned)rv;
+#else
+  (void)ioq;
+  (void)wait;
+#endif
+
+  return 0;
+}
+
+/***************************************************************************
+ * Wait for the completion of a queued read.  Short reads are completed
+ * and failed asynchronous reads (e.g. an operation not supported by the
+ * kernel) are retried with synchronous reads.
+ *
+ * Returns the completed request or NULL on error.
+ ***************************************************************************/
+static MS3IORequest *
+ioqueue_complete (MS3IOQueue *ioq)
+{
+#if defined(LIBMSEED_IOURING)
+  struct io_uring_cqe *cqe;
+  MS3IORequest *request;
+  unsigned head;
+  int64_t rest;
+  int res;
+
+  for (;;)
+  {
+    head = *ioq->cqhead;
+
+    if (head != __atomic_load_n (ioq->cqtail, __ATOMIC_ACQUIRE))
+    {
+      cqe     = &ioq->cqes[head & *ioq->cqmask];
+      request = (MS3IORequest *)(uintptr_t)cqe->user_data;
+      res     = cqe->res;
+
+      __atomic_store_n (ioq->cqhead, head + 1, __ATOMIC_RELEASE);
+
+      if (res < 0)
+      {
+        request->result = msio_pread (request->fd, request->buffer, request->length, request->offset);
+      }
+      else if ((size_t)res < request->length && res > 0)
+      {
+        rest = msio_pread (request->fd, request->buffer + res, request->length - res, request->offset + res);
+        request->result = (rest < 0) ? rest : res + rest;
+      }
+      else
+      {
+        request->result = res;
+      }
+
+      return request;
+    }
+
+    if (ioqueue_submit (ioq, 1))
+      return NULL;
+  }
+#else
+  (void)ioq;
+  return NULL;
+#endif
+}
+
+/***************************************************************************
+ * Wait for reads in flight and free read-ahead state.
+ ***************************************************************************/
+static void
+readahead_free (struct readahead *ra)
+{
+  if (!ra)
+    return;
+
+  while (ra->inflight > 0 && ioqueue_complete (ra->ioq))
+    ra->inflight--;
+
+  msio_ioqueue_free (ra->ioq);
+  libmseed_memory.free (ra->buffer);
+  libmseed_memory.free (ra->chunks);
+  libmseed_memory.free (ra);
+}
+
+/***************************************************************************
+ * Set up reading ahead for a file opened at 'offset', keeping reads of
+ * the following READAHEAD_CHUNKSIZE chunks in flight.  Nothing is set
+ * up when io_uring is not available, the file is then read with
+ * synchronous reads.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+readahead_init (LMIO *io, int64_t offset)
+{
+  struct readahead *ra;
+  int idx;
+  int rv;
+
+  if ((ra = (struct readahead *)libmseed_memory.malloc (sizeof (struct readahead))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for read-ahead\n");
+    return -1;
+  }
+
+  memset (ra, 0, sizeof (struct readahead));
+
+  if ((ra->chunks = (MS3IORequest *)libmseed_memory.malloc (sizeof (MS3IORequest) * gReadAheadDepth)) == NULL ||
+      (ra->buffer = (char *)libmseed_memory.malloc ((size_t)gReadAheadDepth * READAHEAD_CHUNKSIZE)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for read-ahead\n");
+    if (ra->chunks)
+      libmseed_memory.free (ra->chunks);
+    libmseed_memory.free (ra);
+    return -1;
+  }
+
+  memset (ra->chunks, 0, sizeof (MS3IORequest) * gReadAheadDepth);
+
+  ra->ioq = msio_ioqueue_init (gReadAheadDepth, ra->buffer, (size_t)gReadAheadDepth * READAHEAD_CHUNKSIZE);
+
+  if (ra->ioq == NULL || ra->ioq->ringfd < 0)
+  {
+    rv = (ra->ioq == NULL) ? -1 : 0;
 
-#include <curl/curl.h>
+    msio_ioqueue_free (ra->ioq);
+    libmseed_memory.free (ra->buffer);
+    libmseed_memory.free (ra->chunks);
+    libmseed_memory.free (ra);
+    return rv;
+  }
 
-/* Control for enabling debugging information */
-int libmseed_url_debug = -1;
+  ra->offset = offset;
 
-/* Control for SSL peer and host verification */
-long libmseed_ssl_noverify = -1;
+  for (idx = 0; idx < gReadAheadDepth; idx++)
+  {
+    ra->chunks[idx].fd     = fileno ((FILE *)io->handle);
+    ra->chunks[idx].offset = ra->offset;
+    ra->chunks[idx].length = READAHEAD_CHUNKSIZE;
+    ra->chunks[idx].buffer = ra->buffer + (size_t)idx * READAHEAD_CHUNKSIZE;
+
+    ioqueue_queue (ra->ioq, &ra->chunks[idx]);
+    ra->offset += READAHEAD_CHUNKSIZE;
+    ra->inflight++;
+  }
 
-/* A global libcurl easy handle for configuration options */
-CURL *gCURLeasy = NULL;
+  if (ioqueue_submit (ra->ioq, 0))
+  {
+    readahead_free (ra);
+    return -1;
+  }
 
-/* A global libcurl list of headers */
-struct curl_slist *gCURLheaders = NULL;
+  io->handle2 = ra;
 
-/* Receving callback parameters */
-struct recv_callback_parameters
-{
-  char *buffer;
-  size_t size;
-  int is_paused;
-};
+  return 0;
+}
 
-/* Header callback parameters */
-struct header_callback_parameters
+/***************************************************************************
+ * Copy up to 'size' bytes of read-ahead data into a buffer, waiting for
+ * chunks in flight as needed and queuing the read of the next chunk for
+ * each consumed chunk.
+ *
+ * Returns the number of bytes copied on success and -1 on error.
+ ***************************************************************************/
+static int64_t
+readahead_read (struct readahead *ra, char *buffer, size_t size)
 {
-  int64_t *startoffset;
-  int64_t *endoffset;
-};
+  MS3IORequest *chunk;
+  int64_t copied = 0;
+  int64_t length;
+
+  while (size > 0 && !ra->eof)
+  {
+    chunk = &ra->chunks[ra->next];
+
+    while (chunk->result == IOQUEUE_INFLIGHT)
+    {
+      if (ioqueue_complete (ra->ioq) == NULL)
+        return -1;
+
+      ra->inflight--;
+    }
+
+    if (chunk->result < 0)
+    {
+      ms_log (2, "Error reading at offset %" PRId64 ": %s\n", chunk->offset, strerror ((int)-chunk->result));
+      return -1;
+    }
+
+    length = chunk->result - ra->consumed;
+    if ((size_t)length > size)
+      length = size;
+
+    memcpy (buffer + copied, chunk->buffer + ra->consumed, length);
+    ra->consumed += length;
+    copied += length;
+    size -= length;
+
+    /* Chunk consumed, a short chunk is the end of the file */
+    if (ra->consumed == chunk->result)
+    {
+      if ((size_t)chunk->result < chunk->length)
+      {
+        ra->eof = 1;
+        break;
+      }
+
+      chunk->offset = ra->offset;
+      ioqueue_queue (ra->ioq, chunk);
+      ra->offset += READAHEAD_CHUNKSIZE;
+      ra->inflight++;
+
+      if (ioqueue_submit (ra->ioq, 0))
+        return -1;
+
+      ra->consumed = 0;
+      ra->next     = (ra->next + 1) % gReadAheadDepth;
+    }
+  }
+
+  return copied;
+}
 
 /*********************************************************************
- * Callback fired when recv'ing data using libcurl.
+ * msio_ioqueue_init:
  *
- * The destination buffer pointer and size in the callback parameters
- * are adjusted as data are added.
+ * Create a queue of up to 'depth' asynchronous reads, using io_uring
+ * when available.  The optional 'buffer' of 'buffersize' bytes is
+ * registered with the kernel for reads into it.
  *
- * Returns number of bytes added to the destination buffer.
+ * Returns the queue on success and NULL on error.
  *********************************************************************/
-static size_t
-recv_callback (char *buffer, size_t size, size_t num, void *userdata)
+MS3IOQueue *
+msio_ioqueue_init (int depth, char *buffer, size_t buffersize)
 {
-  struct recv_callback_parameters *rcp = (struct recv_callback_parameters *)userdata;
+  MS3IOQueue *ioq;
 
-  if (!buffer || !userdata)
-    return 0;
+  if ((ioq = (MS3IOQueue *)libmseed_memory.malloc (sizeof (MS3IOQueue))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for I/O queue\n");
+    return NULL;
+  }
 
-  size *= num;
+  memset (ioq, 0, sizeof (MS3IOQueue));
 
-  /* Pause connection if passed data does not fit into destination buffer */
-  if (size > rcp->size)
+  ioq->depth     = (depth > 0) ? depth : 1;
+  ioq->ringfd    = -1;
+  ioq->fixed     = buffer;
+  ioq->fixedsize = buffersize;
+
+#if defined(LIBMSEED_IOURING)
+  if (depth > 0)
+    uring_setup (ioq);
+#endif
+
+  if (ioq->ringfd < 0)
+    ioq->fixed = NULL;
+
+  return ioq;
+} /* End of msio_ioqueue_init() */
+
+/*********************************************************************
+ * msio_ioqueue_read:
+ *
+ * Read a batch of requests, keeping up to the queue depth of reads in
+ * flight with io_uring, otherwise reading each request in order with
+ * pread().  The result of each request is set to the number of bytes
+ * read or a negative errno.
+ *
+ * Returns the number of requests read completely and -1 on error.
+ *********************************************************************/
+int
+msio_ioqueue_read (MS3IOQueue *ioq, MS3IORequest *requests, int count)
+{
+  int submitted = 0;
+  int completed = 0;
+  int complete  = 0;
+  int idx;
+
+  if (!ioq || (!requests && count > 0))
+    return -1;
+
+  if (ioq->ringfd < 0)
   {
-    rcp->is_paused = 1;
-    return CURL_WRITEFUNC_PAUSE;
+    for (idx = 0; idx < count; idx++)
+      requests[idx].result = msio_pread (requests[idx].fd, requests[idx].buffer,
+                                        requests[idx].length, requests[idx].offset);
   }
-  /* Otherwise, copy data to destination buffer */
   else
   {
-    memcpy (rcp->buffer, buffer, size);
-    rcp->buffer += size;
-    rcp->size -= size;
+    while (completed < count)
+    {
+      /* Requests larger than a single io_uring read are read synchronously */
+      while (submitted < count && submitted - completed < ioq->depth)
+      {
+        if (requests[submitted].length > INT32_MAX)
+        {
+          requests[submitted].result = msio_pread (requests[submitted].fd, requests[submitted].buffer,
+                                                  requests[submitted].length, requests[submitted].offset);
+          completed++;
+        }
+        else
+        {
+          ioqueue_queue (ioq, &requests[submitted]);
+        }
+
+        submitted++;
+      }
+
+      if (completed == count)
+        break;
+
+      if (ioqueue_complete (ioq) == NULL)
+        return -1;
+
+      completed++;
+    }
   }
 
-  return size;
-}
+  for (idx = 0; idx < count; idx++)
+  {
+    if (requests[idx].result >= 0 && (size_t)requests[idx].result == requests[idx].length)
+      complete++;
+  }
+
+  return complete;
+} /* End of msio_ioqueue_read() */
 
 /*********************************************************************
- * Callback fired when receiving headers using libcurl.
+ * msio_ioqueue_isasync:
  *
- * Returns number of bytes processed for success.
+ * Returns 1 if reads of the queue are asynchronous with io_uring and 0
+ * if they are synchronous.
  *********************************************************************/
-static size_t
-header_callback (char *buffer, size_t size, size_t num, void *userdata)
+int
+msio_ioqueue_isasync (MS3IOQueue *ioq)
 {
-  struct header_callback_parameters *hcp = (struct header_callback_parameters *)userdata;
-
-  char startstr[21] = {0}; /* Maximum of 20 digit value */
-  char endstr[21]   = {0}; /* Maximum of 20 digit value */
-  int startdigits   = 0;
-  int enddigits     = 0;
-  char *dash        = NULL;
-  char *ptr;
+  return (ioq && ioq->ringfd >= 0) ? 1 : 0;
+} /* End of msio_ioqueue_isasync() */
 
-  if (!buffer || !userdata)
-    return 0;
+/*********************************************************************
+ * msio_ioqueue_free:
+ *
+ * Free a queue created with msio_ioqueue_init().  No reads may be in
+ * flight.
+ *********************************************************************/
+void
+msio_ioqueue_free (MS3IOQueue *ioq)
+{
+  if (!ioq)
+    return;
 
-  size *= num;
+#if defined(LIBMSEED_IOURING)
+  if (ioq->ringfd >= 0)
+    uring_free (ioq);
+#endif
 
-  /* Parse and store: "Content-Range: bytes START-END/TOTAL"
-   * e.g. Content-Range: bytes 512-1023/4096 */
-  if (size > 22 && strncasecmp (buffer, "Content-Range: bytes", 20) == 0)
-  {
-    /* Process each character, starting just afer "bytes" unit */
-    for (ptr = buffer + 20; *ptr != '\0' && (ptr - buffer) < size; ptr++)
-    {
-      /* Skip spaces before start of range */
-      if (*ptr == ' ' && startdigits == 0)
-        continue;
-      /* Digits before dash, part of start */
-      else if (isdigit (*ptr) && dash == NULL)
-        startstr[startdigits++] = *ptr;
-      /* Digits after dash, part of end */
-      else if (isdigit (*ptr) && dash != NULL)
-        endstr[enddigits++] = *ptr;
-      /* If first dash found, store pointer */
-      else if (*ptr == '-' && dash == NULL)
-        dash = ptr;
-      /* Nothing else is part of the range */
-      else
-        break;
+  libmseed_memory.free (ioq);
+} /* End of msio_ioqueue_free() */
 
-      /* If digit sequences have exceeded limits, not a valid range */
-      if (startdigits >= sizeof (startstr) || enddigits >= sizeof (endstr))
-      {
-        startdigits = 0;
-        enddigits   = 0;
-        break;
-      }
-    }
+/*********************************************************************
+ * msio_readahead:
+ *
+ * Set the number of asynchronous reads kept in flight ahead of reading
+ * files opened with msio_fopen(), 0 disables reading ahead.
+ *
+ * Returns 0 when reads are asynchronous, 1 when io_uring is not
+ * available and reads are synchronous, and -1 on error.
+ *********************************************************************/
+int
+msio_readahead (int depth)
+{
+  MS3IOQueue *ioq;
+  int async;
 
-    /* Convert start and end values to numbers if non-zero length */
-    if (hcp->startoffset && startdigits)
-      *hcp->startoffset = (int64_t) strtoull (startstr, NULL, 10);
+  if (depth < 0)
+    return -1;
 
-    if (hcp->endoffset && enddigits)
-      *hcp->endoffset = (int64_t) strtoull (endstr, NULL, 10);
+  if (depth == 0)
+  {
+    gReadAheadDepth = 0;
+    return 1;
   }
 
-  return size;
-}
+  if ((ioq = msio_ioqueue_init (depth, NULL, 0)) == NULL)
+    return -1;
 
-#endif /* defined(LIBMSEED_URL) */
+  async = (ioq->ringfd >= 0);
+  msio_ioqueue_free (ioq);
+
+  gReadAheadDepth = (async) ? depth : 0;
 
+  return (async) ? 0 : 1;
+} /* End of msio_readahead() */
 
 /***************************************************************************
  * msio_fopen:
@@ -166,6 +2111,12 @@ header_callback (char *buffer, size_t size, size_t num, void *userdata)
  * Determine if requested path is a regular file or a URL and open or
  * initialize as appropriate.
  *
+ * Files opened for reading are identified as gzip- or zstd-compressed
+ * by their magic bytes and decompressed while reading, offsets refer
+ * to the decompressed data.  When a spool directory is set the
+ * decompressed data are written to a spool file, see
+ * msio_url_spoolfile().
+ *
  * The 'mode' argument is only for file-system paths and ignored for
  * URLs.  If 'mode' is set to NULL, default is 'rb' mode.
  *
@@ -208,87 +2159,21 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
 #else
     long response_code;
     struct header_callback_parameters hcp;
+    struct spool_parameters *spool = NULL;
+    struct curl_slist *headers;
+    char spoolpath[1024];
 
-    io->type = LMIO_URL;
-
-    /* Check for URL debugging environment variable */
-    if (libmseed_url_debug < 0)
-    {
-      if (getenv ("LIBMSEED_URL_DEBUG"))
-        libmseed_url_debug = 1;
-      else
-        libmseed_url_debug = 0;
-    }
-
-    /* Check for SSL peer/host verify environment variable */
-    if (libmseed_ssl_noverify < 0)
-    {
-      if (getenv ("LIBMSEED_SSL_NOVERIFY"))
-        libmseed_ssl_noverify = 1;
-      else
-        libmseed_ssl_noverify = 0;
-    }
-
-    /* Configure the libcurl easy handle, duplicate global options if present */
-    io->handle = (gCURLeasy) ? curl_easy_duphandle (gCURLeasy) : curl_easy_init ();
-
-    if (io->handle == NULL)
-    {
-      ms_log (2, "Cannot initialize CURL handle\n");
-      return -1;
-    }
-
-    /* URL debug */
-    if (libmseed_url_debug && curl_easy_setopt (io->handle, CURLOPT_VERBOSE, 1L) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set CURLOPT_VERBOSE\n");
-      return -1;
-    }
-
-    /* SSL peer and host verification */
-    if (libmseed_ssl_noverify &&
-        (curl_easy_setopt (io->handle, CURLOPT_SSL_VERIFYPEER, 0L) != CURLE_OK ||
-         curl_easy_setopt (io->handle, CURLOPT_SSL_VERIFYHOST, 0L) != CURLE_OK))
-    {
-      ms_log (2, "Cannot set CURLOPT_SSL_VERIFYPEER and/or CURLOPT_SSL_VERIFYHOST\n");
-      return -1;
-    }
-
-    /* Set URL */
-    if (curl_easy_setopt (io->handle, CURLOPT_URL, path) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set CURLOPT_URL\n");
-      return -1;
-    }
-
-    /* Set default User-Agent header, can be overridden via custom header */
-    if (curl_easy_setopt (io->handle, CURLOPT_USERAGENT,
-                          "libmseed/" LIBMSEED_VERSION " libcurl/" LIBCURL_VERSION) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set default CURLOPT_USERAGENT\n");
-      return -1;
-    }
-
-    /* Disable signals */
-    if (curl_easy_setopt (io->handle, CURLOPT_NOSIGNAL, 1L) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set CURLOPT_NOSIGNAL\n");
-      return -1;
-    }
+    /* Read spool file directly if completed by this process */
+    if (gSpoolDir &&
+        !spool_path (path, (startoffset) ? *startoffset : 0, (endoffset) ? *endoffset : 0,
+                     ".mseed", spoolpath, sizeof (spoolpath)) &&
+        spool_isfresh (spoolpath, 1))
+      return msio_fopen (io, spoolpath, mode, startoffset, NULL);
 
-    /* Return failure codes on errors */
-    if (curl_easy_setopt (io->handle, CURLOPT_FAILONERROR, 1L) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set CURLOPT_FAILONERROR\n");
-      return -1;
-    }
+    io->type = LMIO_URL;
 
-    /* Follow HTTP redirects */
-    if (curl_easy_setopt (io->handle, CURLOPT_FOLLOWLOCATION, 1L) != CURLE_OK)
-    {
-      ms_log (2, "Cannot set CURLOPT_FOLLOWLOCATION\n");
+    if ((io->handle = url_easy_init (path)) == NULL)
       return -1;
-    }
 
     /* Configure write callback for recv'ed data */
     if (curl_easy_setopt (io->handle, CURLOPT_WRITEFUNCTION, recv_callback) != CURLE_OK)
@@ -336,11 +2221,36 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
       }
     }
 
+    /* Set up spooling to a local file, with a conditional request if previously spooled */
+    if (gSpoolDir)
+    {
+      if ((spool = spool_init (path,
+                               (startoffset) ? *startoffset : 0,
+                               (endoffset) ? *endoffset : 0)) == NULL)
+        return -1;
+
+      io->spool = spool;
+
+      if (spool_headers (spool))
+        return -1;
+
+      if (spool->lastmodified[0] && !spool->etag[0] &&
+          (curl_easy_setopt (io->handle, CURLOPT_TIMECONDITION, (long)CURL_TIMECOND_IFMODSINCE) != CURLE_OK ||
+           curl_easy_setopt (io->handle, CURLOPT_TIMEVALUE, (long)curl_getdate (spool->lastmodified, NULL)) != CURLE_OK))
+      {
+        ms_log (2, "Cannot set CURLOPT_TIMECONDITION and/or CURLOPT_TIMEVALUE\n");
+        return -1;
+      }
+    }
+
     /* Set up header callback */
-    if (startoffset || endoffset)
+    if (startoffset || endoffset || spool)
     {
       hcp.startoffset = startoffset;
       hcp.endoffset = endoffset;
+      hcp.etag = (spool) ? spool->etag : NULL;
+      hcp.lastmodified = (spool) ? spool->lastmodified : NULL;
+      hcp.acceptranges = NULL;
 
       /* Configure header callback */
       if (curl_easy_setopt (io->handle, CURLOPT_HEADERFUNCTION, header_callback) != CURLE_OK)
@@ -357,7 +2267,8 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
     }
 
     /* Set custom headers */
-    if (gCURLheaders && curl_easy_setopt (io->handle, CURLOPT_HTTPHEADER, gCURLheaders) != CURLE_OK)
+    headers = (spool && spool->headers) ? spool->headers : gCURLheaders;
+    if (headers && curl_easy_setopt (io->handle, CURLOPT_HTTPHEADER, headers) != CURLE_OK)
     {
       ms_log (2, "Cannot set CURLOPT_HTTPHEADER\n");
       return -1;
@@ -381,10 +2292,50 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
       ms_log (2, "Cannot open %s: response code %ld\n", path, response_code);
       return -1;
     }
+
+    if (spool)
+    {
+      /* Not modified: close the transfer and read from the spool file */
+      if (response_code == 304)
+      {
+        strcpy (spoolpath, spool->path);
+        spool_setfresh (spoolpath, 1);
+
+        curl_multi_remove_handle (io->handle2, io->handle);
+        curl_easy_cleanup (io->handle);
+        curl_multi_cleanup (io->handle2);
+        spool_free (spool, 0);
+
+        io->handle = NULL;
+        io->handle2 = NULL;
+        io->spool = NULL;
+        io->still_running = 0;
+
+        return msio_fopen (io, spoolpath, mode, startoffset, NULL);
+      }
+
+      /* Spooled data are written at their offset in the source, a partial
+       * response (206) starts at the returned range start */
+      if ((spool->fp = fopen (spool->partpath, "wb")) == NULL)
+      {
+        ms_log (2, "Cannot open URL spool file %s: %s\n", spool->partpath, strerror (errno));
+        return -1;
+      }
+
+      if (response_code == 206 && startoffset && *startoffset > 0 &&
+          lmp_fseek64 (spool->fp, *startoffset, SEEK_SET))
+      {
+        ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", spool->partpath, *startoffset);
+        return -1;
+      }
+    }
 #endif /* defined(LIBMSEED_URL) */
   }
   else
   {
+    unsigned char magic[4] = {0};
+    size_t magiclength = 0;
+
     io->type = LMIO_FILE;
 
     if ((io->handle = fopen (path, mode)) == NULL)
@@ -393,6 +2344,31 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
       return -1;
     }
 
+    /* Identify compressed files by magic bytes */
+    if (mode[0] == 'r')
+    {
+      magiclength = fread (magic, 1, sizeof (magic), io->handle);
+      rewind (io->handle);
+    }
+
+    if (magiclength >= 3 && magic[0] == 0x1f && magic[1] == 0x8b && magic[2] == 0x08)
+    {
+      fclose (io->handle);
+      io->handle = NULL;
+      io->type = LMIO_NULL;
+
+      return gzip_open (io, path, startoffset, endoffset);
+    }
+    else if (magiclength == 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+             magic[2] == 0x2f && magic[3] == 0xfd)
+    {
+      fclose (io->handle);
+      io->handle = NULL;
+      io->type = LMIO_NULL;
+
+      return zstd_open (io, path, startoffset, endoffset);
+    }
+
     /* Seek to position if start offset is provided */
     if (startoffset && *startoffset > 0)
     {
@@ -402,6 +2378,11 @@ msio_fopen (LMIO *io, const char *path, const char *mode,
         return -1;
       }
     }
+
+    /* Keep reads in flight ahead of reading if requested */
+    if (gReadAheadDepth > 0 && mode[0] == 'r' &&
+        readahead_init (io, (startoffset && *startoffset > 0) ? *startoffset : 0))
+      return -1;
   }
 
   return 0;
@@ -432,6 +2413,9 @@ msio_fclose (LMIO *io)
 
   if (io->type == LMIO_FILE || io->type == LMIO_FD)
   {
+    if (io->handle2)
+      readahead_free ((struct readahead *)io->handle2);
+
     rv = fclose (io->handle);
 
     if (rv)
@@ -446,15 +2430,93 @@ msio_fclose (LMIO *io)
     ms_log (2, "URL support not included in library\n");
     return -1;
 #else
+    CURLMsg *msg;
+    int msgs;
+    int complete = 0;
+
+    /* Determine if the transfer completed successfully for spooling */
+    if (io->spool)
+    {
+      while ((msg = curl_multi_info_read (io->handle2, &msgs)))
+      {
+        if (msg->msg == CURLMSG_DONE && msg->data.result == CURLE_OK)
+          complete = 1;
+      }
+
+      if (io->still_running)
+        complete = 0;
+    }
+
     curl_multi_remove_handle (io->handle2, io->handle);
     curl_easy_cleanup (io->handle);
     curl_multi_cleanup (io->handle2);
+
+    spool_free (io->spool, complete);
+#endif
+  }
+  else if (io->type == LMIO_GZIP)
+  {
+#if !defined(LIBMSEED_ZLIB)
+    ms_log (2, "gzip support not included in library\n");
+    return -1;
+#else
+    /* Spool is complete if all data were decompressed */
+    int complete = gzeof (io->handle);
+
+    rv = gzclose (io->handle);
+
+    spool_free (io->spool, (rv == Z_OK) ? complete : 0);
+
+    io->type = LMIO_NULL;
+    io->handle = NULL;
+    io->spool = NULL;
+
+    if (rv != Z_OK)
+    {
+      ms_log (2, "Error closing gzip file (%d)\n", rv);
+      return -1;
+    }
+#endif
+  }
+  else if (io->type == LMIO_ZSTD)
+  {
+#if !defined(LIBMSEED_ZSTD)
+    ms_log (2, "zstd support not included in library\n");
+    return -1;
+#else
+    struct zstd_stream *zs = (struct zstd_stream *)io->handle2;
+
+    /* Spool is complete if all data were decompressed */
+    int complete = (zs && zs->eof);
+
+    rv = fclose (io->handle);
+
+    if (zs)
+    {
+      ZSTD_freeDCtx (zs->dctx);
+      libmseed_memory.free (zs->inputbuffer);
+      libmseed_memory.free (zs);
+    }
+
+    spool_free (io->spool, (rv == 0) ? complete : 0);
+
+    io->type = LMIO_NULL;
+    io->handle = NULL;
+    io->handle2 = NULL;
+    io->spool = NULL;
+
+    if (rv)
+    {
+      ms_log (2, "Error closing zstd file (%s)\n", strerror (errno));
+      return -1;
+    }
 #endif
   }
 
   io->type = LMIO_NULL;
   io->handle = NULL;
   io->handle2 = NULL;
+  io->spool = NULL;
 
   return 0;
 } /* End of msio_fclose() */
@@ -468,9 +2530,9 @@ msio_fclose (LMIO *io)
  *
  * For URL support, with defined(LIBMSEED_URL), the destination
  * receive buffer MUST be at least as big as the curl receive buffer
- * (CURLOPT_BUFFERSIZE, which defaults to CURL_MAX_WRITE_SIZE of 16kB)
- * or the maximum size of a retrieved object if less than
- * CURL_MAX_WRITE_SIZE.  The caller must ensure this.
+ * (CURLOPT_BUFFERSIZE, set to URL_RECV_BUFFERSIZE of 256kB) or the
+ * maximum size of a retrieved object if less than URL_RECV_BUFFERSIZE.
+ * The caller must ensure this.
  *
  * Returns the number of bytes read on success and a negative value on
  * error.
@@ -489,8 +2551,18 @@ msio_fread (LMIO *io, void *buffer, size_t size)
     return -1;
   }
 
+  /* Read from read-ahead chunks of a file */
+  if (io->type == LMIO_FILE && io->handle2)
+  {
+    int64_t rv = readahead_read ((struct readahead *)io->handle2, buffer, size);
+
+    if (rv < 0)
+      return -1;
+
+    read = (size_t)rv;
+  }
   /* Read from regular file stream */
-  if (io->type == LMIO_FILE || io->type == LMIO_FD)
+  else if (io->type == LMIO_FILE || io->type == LMIO_FD)
   {
     read = fread (buffer, 1, size, io->handle);
   }
@@ -502,13 +2574,6 @@ msio_fread (LMIO *io, void *buffer, size_t size)
     return -1;
 #else
     struct recv_callback_parameters rcp;
-    struct timeval timeout;
-    fd_set fdread;
-    fd_set fdwrite;
-    fd_set fdexcep;
-    long curl_timeo = -1;
-    int maxfd       = -1;
-    int rc;
 
     if (!io->still_running)
       return 0;
@@ -516,6 +2581,7 @@ msio_fread (LMIO *io, void *buffer, size_t size)
     /* Set up destination buffer in write callback parameters */
     rcp.buffer = buffer;
     rcp.size   = size;
+    rcp.spool  = (io->spool) ? ((struct spool_parameters *)io->spool)->fp : NULL;
     if (curl_easy_setopt (io->handle, CURLOPT_WRITEDATA, (void *)&rcp) != CURLE_OK)
     {
       ms_log (2, "Cannot set CURLOPT_WRITEDATA\n");
@@ -527,58 +2593,86 @@ msio_fread (LMIO *io, void *buffer, size_t size)
     rcp.is_paused = 0;
 
     /* Receive data while connection running, destination space available
-     * and connection is not paused. */
-    do
+     * and connection is not paused, waiting for socket activity between
+     * transfer steps instead of polling. */
+    for (;;)
     {
-      /* Default timeout for read failure */
-      timeout.tv_sec  = 60;
-      timeout.tv_usec = 0;
-
-      curl_multi_timeout (io->handle2, &curl_timeo);
-
-      /* Tailor timeout based on maximum suggested by libcurl */
-      if (curl_timeo >= 0)
+      if (curl_multi_perform (io->handle2, &io->still_running) != CURLM_OK)
       {
-        timeout.tv_sec = curl_timeo / 1000;
-        if (timeout.tv_sec > 1)
-          timeout.tv_sec = 1;
-        else
-          timeout.tv_usec = (curl_timeo % 1000) * 1000;
-      }
-
-      FD_ZERO (&fdread);
-      FD_ZERO (&fdwrite);
-      FD_ZERO (&fdexcep);
-
-      /* Extract descriptors from the multi-handle */
-      if (curl_multi_fdset (io->handle2, &fdread, &fdwrite, &fdexcep, &maxfd) != CURLM_OK)
-      {
-        ms_log (2, "Error with curl_multi_fdset()\n");
+        ms_log (2, "Error with curl_multi_perform()\n");
         return -1;
       }
 
-      /* libcurl/system needs time to work, sleep 100 milliseconds */
-      if (maxfd == -1)
-      {
-        lmp_nanosleep (100000000);
-        rc = 0;
-      }
-      else
-      {
-        rc = select (maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
-      }
+      if (io->still_running <= 0 || rcp.is_paused || (rcp.size == 0 && rcp.buffer != NULL))
+        break;
 
-      /* Receive data */
-      if (rc >= 0)
+      if (url_multi_wait (io->handle2, 1000) != CURLM_OK)
       {
-        curl_multi_perform (io->handle2, &io->still_running);
+        ms_log (2, "Error waiting for URL data\n");
+        return -1;
       }
-    } while (io->still_running > 0 && !rcp.is_paused && (rcp.size > 0 || rcp.buffer == NULL));
+    }
 
     read = size - rcp.size;
 
 #endif /* defined(LIBMSEED_URL) */
   }
+  /* Read from gzip stream, decompressing */
+  else if (io->type == LMIO_GZIP)
+  {
+#if !defined(LIBMSEED_ZLIB)
+    ms_log (2, "gzip support not included in library\n");
+    return -1;
+#else
+    struct spool_parameters *spool = (struct spool_parameters *)io->spool;
+    int errnum;
+    int rv;
+
+    if (size == 0)
+      return 0;
+
+    if ((rv = gzread (io->handle, buffer, (unsigned int)size)) < 0)
+    {
+      ms_log (2, "Error decompressing: %s\n", gzerror (io->handle, &errnum));
+      return -1;
+    }
+
+    read = (size_t)rv;
+
+    /* Copy data to spool file */
+    if (spool && spool->fp && read > 0 && fwrite (buffer, read, 1, spool->fp) != 1)
+    {
+      ms_log (2, "Cannot write to spool file: %s\n", strerror (errno));
+      return -1;
+    }
+#endif /* defined(LIBMSEED_ZLIB) */
+  }
+  /* Read from zstd stream, decompressing */
+  else if (io->type == LMIO_ZSTD)
+  {
+#if !defined(LIBMSEED_ZSTD)
+    ms_log (2, "zstd support not included in library\n");
+    return -1;
+#else
+    struct spool_parameters *spool = (struct spool_parameters *)io->spool;
+    int64_t rv;
+
+    if (size == 0)
+      return 0;
+
+    if ((rv = zstd_read ((struct zstd_stream *)io->handle2, io->handle, buffer, size)) < 0)
+      return -1;
+
+    read = (size_t)rv;
+
+    /* Copy data to spool file */
+    if (spool && spool->fp && read > 0 && fwrite (buffer, read, 1, spool->fp) != 1)
+    {
+      ms_log (2, "Cannot write to spool file: %s\n", strerror (errno));
+      return -1;
+    }
+#endif /* defined(LIBMSEED_ZSTD) */
+  }
 
   return read;
 } /* End of msio_fread() */
@@ -599,7 +2693,12 @@ msio_feof (LMIO *io)
   if (io->handle == NULL || io->type == LMIO_NULL)
     return 0;
 
-  if (io->type == LMIO_FILE || io->type == LMIO_FD)
+  if (io->type == LMIO_FILE && io->handle2)
+  {
+    if (((struct readahead *)io->handle2)->eof)
+      return 1;
+  }
+  else if (io->type == LMIO_FILE || io->type == LMIO_FD)
   {
     if (feof ((FILE *)io->handle))
       return 1;
@@ -617,10 +2716,112 @@ msio_feof (LMIO *io)
       return 1;
 #endif
   }
+  else if (io->type == LMIO_GZIP)
+  {
+#if !defined(LIBMSEED_ZLIB)
+    ms_log (2, "gzip support not included in library\n");
+    return -1;
+#else
+    if (gzeof (io->handle))
+      return 1;
+#endif
+  }
+  else if (io->type == LMIO_ZSTD)
+  {
+#if !defined(LIBMSEED_ZSTD)
+    ms_log (2, "zstd support not included in library\n");
+    return -1;
+#else
+    if (((struct zstd_stream *)io->handle2)->eof)
+      return 1;
+#endif
+  }
 
   return 0;
 } /* End of msio_feof() */
 
+/*********************************************************************
+ * msio_readsize:
+ *
+ * Determine the preferred size of reads from the identified IO
+ * handle.  For files this is the block size of the underlying file
+ * system or the chunk size when reading ahead, for URLs the curl
+ * receive buffer size that msio_fread() requires as free space in the
+ * destination buffer.
+ *
+ * Returns the preferred read size in bytes, at least 512.
+ *********************************************************************/
+size_t
+msio_readsize (LMIO *io)
+{
+  size_t readsize = 4096;
+
+  if (!io || io->handle == NULL)
+    return readsize;
+
+  if (io->type == LMIO_FILE && io->handle2)
+  {
+    readsize = READAHEAD_CHUNKSIZE;
+  }
+  else if (io->type == LMIO_FILE || io->type == LMIO_FD)
+  {
+#if !defined(LMP_WIN)
+    struct stat sb;
+
+    if (fstat (fileno ((FILE *)io->handle), &sb) == 0 && sb.st_blksize >= 512)
+      readsize = (size_t)sb.st_blksize;
+#endif
+  }
+  else if (io->type == LMIO_URL)
+  {
+#if defined(LIBMSEED_URL)
+    readsize = URL_RECV_BUFFERSIZE;
+#endif
+  }
+  else if (io->type == LMIO_GZIP)
+  {
+    readsize = GZIP_BUFFERSIZE;
+  }
+  else if (io->type == LMIO_ZSTD)
+  {
+#if defined(LIBMSEED_ZSTD)
+    readsize = ZSTD_DStreamOutSize ();
+#endif
+  }
+
+  return readsize;
+} /* End of msio_readsize() */
+
+/*********************************************************************
+ * msio_url_init:
+ *
+ * Initialize libcurl and the URL controls set from environment
+ * variables.  Both are otherwise initialized on first use, which is
+ * not safe when the first URLs are opened concurrently.
+ *
+ * Returns 0 on succes non-zero otherwise.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+msio_url_init (void)
+{
+#if !defined(LIBMSEED_URL)
+  ms_log (2, "URL support not included in library\n");
+  return -1;
+#else
+  if (curl_global_init (CURL_GLOBAL_ALL) != CURLE_OK)
+  {
+    ms_log (2, "Cannot initialize libcurl\n");
+    return -1;
+  }
+
+  url_getenv ();
+
+  return 0;
+#endif
+} /* End of msio_url_init() */
+
 /*********************************************************************
  * msio_url_useragent:
  *
@@ -762,6 +2963,236 @@ msio_url_freeheaders (void)
 #endif
 } /* End of msio_url_freeheaders() */
 
+/*********************************************************************
+ * msio_url_spooldir:
+ *
+ * Set directory for spooling URL and decompressed data to local files.
+ * Data are written to the spool as they are read so that the same
+ * records can be re-read from the local file later.  A NULL directory
+ * disables spooling.
+ *
+ * Returns 0 on succes non-zero otherwise.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+msio_url_spooldir (const char *directory)
+{
+  struct stat sb;
+  size_t length;
+
+  if (gSpoolDir)
+  {
+    libmseed_memory.free (gSpoolDir);
+    gSpoolDir = NULL;
+  }
+
+  /* Forget spool files completed in the previous directory */
+  while (gSpoolFreshCount > 0)
+    libmseed_memory.free (gSpoolFresh[--gSpoolFreshCount].path);
+
+  if (gSpoolFresh)
+  {
+    libmseed_memory.free (gSpoolFresh);
+    gSpoolFresh = NULL;
+  }
+
+  if (!directory)
+    return 0;
+
+  if (stat (directory, &sb) || !S_ISDIR (sb.st_mode))
+  {
+    ms_log (2, "Spool directory is not accessible: %s\n", directory);
+    return -1;
+  }
+
+  length = strlen (directory);
+
+  if ((gSpoolDir = (char *)libmseed_memory.malloc (length + 1)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for spool directory\n");
+    return -1;
+  }
+
+  memcpy (gSpoolDir, directory, length + 1);
+
+  return 0;
+} /* End of msio_url_spooldir() */
+
+/*********************************************************************
+ * msio_url_spoolfile:
+ *
+ * Determine the spool file for a URL (or compressed file) and
+ * requested byte range, the start and end offsets are as requested,
+ * not as returned by a server.
+ *
+ * Returns 0 if the spool file was written or validated by this
+ * process and non-zero otherwise.
+ *********************************************************************/
+int
+msio_url_spoolfile (const char *url, int64_t startoffset, int64_t endoffset,
+                    char *spoolfile, size_t size)
+{
+  if (!url || !spoolfile)
+    return -1;
+
+  /* Local files are spooled by path without scheme, as opened */
+  if (!strncasecmp (url, "file://", 7))
+    url += 7;
+
+  if (spool_path (url, startoffset, endoffset, ".mseed", spoolfile, size))
+    return -1;
+
+  return (spool_isfresh (spoolfile, 0)) ? 0 : -1;
+} /* End of msio_url_spoolfile() */
+
+/*********************************************************************
+ * msio_url_prefetch:
+ *
+ * Fetch URLs concurrently into the spool directory.  The URL and
+ * range of each entry are identified by the 'urls', 'startoffsets'
+ * and 'endoffsets' arrays of 'count' entries; the offsets are as
+ * they would be requested by msio_fopen().
+ *
+ * Transfers share a connection pool limited to 'maxconnections'
+ * (unlimited if 0).  When the length of an object is known and the
+ * server accepts ranges, objects larger than 'splitsize' bytes are
+ * fetched as concurrent range requests (not split if 'splitsize' is
+ * 0).  Completed spools are read by msio_fopen() without further
+ * requests.
+ *
+ * Failures to prefetch are not errors, such URLs are fetched
+ * when opened.
+ *
+ * Returns the number of spooled URLs on success and -1 on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+msio_url_prefetch (const char **urls, const int64_t *startoffsets, const int64_t *endoffsets,
+                   int count, int maxconnections, int64_t splitsize, int8_t verbose)
+{
+#if !defined(LIBMSEED_URL)
+  (void)urls; /* Unused */
+  (void)startoffsets; /* Unused */
+  (void)endoffsets; /* Unused */
+  (void)count; /* Unused */
+  (void)maxconnections; /* Unused */
+  (void)splitsize; /* Unused */
+  (void)verbose; /* Unused */
+  ms_log (2, "URL support not included in library\n");
+  return -1;
+#else
+  struct prefetch_url *prefetch = NULL;
+  CURLM *multi = NULL;
+  int spooled = 0;
+  int retval = 0;
+  int idx;
+
+  if (!urls || !startoffsets || !endoffsets || count <= 0)
+    return 0;
+
+  if (!gSpoolDir)
+  {
+    ms_log (2, "%s(): Spool directory is not set\n", __func__);
+    return -1;
+  }
+
+  if ((prefetch = (struct prefetch_url *)libmseed_memory.malloc (sizeof (struct prefetch_url) * count)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for prefetch\n");
+    return -1;
+  }
+
+  memset (prefetch, 0, sizeof (struct prefetch_url) * count);
+
+  if ((multi = curl_multi_init ()) == NULL)
+  {
+    ms_log (2, "Cannot initialize CURL multi handle\n");
+    libmseed_memory.free (prefetch);
+    return -1;
+  }
+
+  /* Limit connection pool and multiplex transfers over HTTP/2 connections */
+  if ((maxconnections > 0 &&
+       curl_multi_setopt (multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)maxconnections) != CURLM_OK) ||
+      curl_multi_setopt (multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX) != CURLM_OK)
+  {
+    ms_log (2, "Cannot set connection options on CURL multi handle\n");
+    retval = -1;
+  }
+
+  /* Initialize spools and request length and validators when needed */
+  for (idx = 0; idx < count && retval == 0; idx++)
+  {
+    prefetch[idx].path        = urls[idx];
+    prefetch[idx].startoffset = startoffsets[idx];
+    prefetch[idx].endoffset   = endoffsets[idx];
+    prefetch[idx].length      = -1;
+
+    if (!urls[idx] || !strstr (urls[idx], "://") || !strncasecmp (urls[idx], "file://", 7))
+    {
+      prefetch[idx].failed = 1;
+      continue;
+    }
+
+    if ((prefetch[idx].spool = spool_init (urls[idx], startoffsets[idx], endoffsets[idx])) == NULL)
+    {
+      retval = -1;
+      break;
+    }
+
+    if (spool_isfresh (prefetch[idx].spool->path, 1))
+    {
+      prefetch[idx].done = 1;
+      continue;
+    }
+
+    if ((splitsize > 0 || prefetch[idx].spool->etag[0] || prefetch[idx].spool->lastmodified[0]) &&
+        prefetch_add (multi, &prefetch[idx], 1, 0, -1, 0))
+      prefetch[idx].failed = 1;
+  }
+
+  if (retval == 0)
+    retval = prefetch_run (multi, prefetch_head_done);
+
+  /* Plan and run transfers */
+  for (idx = 0; idx < count && retval == 0; idx++)
+  {
+    if (prefetch[idx].failed || prefetch[idx].done)
+      continue;
+
+    if (prefetch_plan (multi, &prefetch[idx], splitsize, verbose) < 0)
+      prefetch[idx].failed = 1;
+  }
+
+  if (retval == 0)
+    retval = prefetch_run (multi, prefetch_piece_done);
+
+  /* Count spooled URLs and clean up */
+  for (idx = 0; idx < count; idx++)
+  {
+    if (prefetch[idx].done)
+      spooled++;
+    else if (verbose && prefetch[idx].path)
+      ms_log (1, "Did not prefetch %s\n", prefetch[idx].path);
+
+    if (prefetch[idx].spool && !prefetch[idx].done)
+      remove (prefetch[idx].spool->partpath);
+
+    if (prefetch[idx].headers)
+      curl_slist_free_all (prefetch[idx].headers);
+
+    spool_free (prefetch[idx].spool, 0);
+  }
+
+  curl_multi_cleanup (multi);
+  libmseed_memory.free (prefetch);
+
+  return (retval) ? -1 : spooled;
+#endif
+} /* End of msio_url_prefetch() */
+
 /***************************************************************************
  * lmp_ftell64:
  *
@@ -32,10 +32,23 @@ extern int msio_fopen (LMIO *io, const char *path, const char *mode,
 extern int msio_fclose (LMIO *io);
 extern size_t msio_fread (LMIO *io, void *buffer, size_t size);
 extern int msio_feof (LMIO *io);
+extern size_t msio_readsize (LMIO *io);
+extern int64_t msio_pread (int fd, char *buffer, size_t length, int64_t offset);
+extern int msio_readahead (int depth);
+extern MS3IOQueue *msio_ioqueue_init (int depth, char *buffer, size_t buffersize);
+extern int msio_ioqueue_read (MS3IOQueue *ioq, MS3IORequest *requests, int count);
+extern int msio_ioqueue_isasync (MS3IOQueue *ioq);
+extern void msio_ioqueue_free (MS3IOQueue *ioq);
+extern int msio_url_init (void);
 extern int msio_url_useragent (const char *program, const char *version);
 extern int msio_url_userpassword (const char *userpassword);
 extern int msio_url_addheader (const char *header);
 extern void msio_url_freeheaders (void);
+extern int msio_url_spooldir (const char *directory);
+extern int msio_url_spoolfile (const char *url, int64_t startoffset, int64_t endoffset,
+                               char *spoolfile, size_t size);
+extern int msio_url_prefetch (const char **urls, const int64_t *startoffsets, const int64_t *endoffsets,
+                              int count, int maxconnections, int64_t splitsize, int8_t verbose);
 
 #ifdef __cplusplus
 }
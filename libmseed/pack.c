@@ -47,6 +47,8 @@ static int64_t msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64
 
 static int ms_genfactmult (double samprate, int16_t *factor, int16_t *multiplier);
 
+static void ms_swapsteim (uint8_t *data, uint32_t datasize, uint8_t encoding);
+
 static int64_t ms_timestr2btime (const char *timestr, uint8_t *btime, const char *sid, int8_t swapflag);
 
 
@@ -381,6 +383,10 @@ msr3_pack_mseed3 (const MS3Record *msr, void (*record_handler) (char *, int, voi
  * This can be used to efficiently convert format versions or modify
  * header values without unpacking the data samples.
  *
+ * The encoded data of a version 2 record is converted to the byte
+ * order of version 3, big endian for Steim encodings and little endian
+ * for all others, if needed.
+ *
  * @param[in] msr ::MS3Record containing record to repack
  * @param[out] record Destination buffer for repacked record
  * @param[in] recbuflen Length of destination buffer
@@ -399,7 +405,10 @@ msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen,
   uint32_t origdatasize;
   uint32_t crc;
   uint32_t reclen;
+  uint32_t idx;
   int8_t swapflag;
+  int8_t payloadbigendian;
+  int samplesize = 0; /* Size of values to swap, -1 for Steim frames */
 
   if (!msr || !msr->record || ! record)
   {
@@ -447,11 +456,72 @@ msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen,
 
   reclen = dataoffset + origdatasize;
 
+  /* Check to see if byte swapping is needed, miniSEED 3 is little endian */
+  swapflag = (ms_bigendianhost ()) ? 1 : 0;
+
+  /* Determine size of values to swap if version 2 data byte order differs from version 3 */
+  if (msr->formatversion == 2)
+  {
+    payloadbigendian = (swapflag) ? !(msr->swapflag & MSSWAP_PAYLOAD) : (msr->swapflag & MSSWAP_PAYLOAD) != 0;
+
+    if (payloadbigendian != (msr->encoding == DE_STEIM1 || msr->encoding == DE_STEIM2))
+    {
+      switch (msr->encoding)
+      {
+      case DE_TEXT:
+        break;
+      case DE_INT16:
+      case DE_GEOSCOPE163:
+      case DE_GEOSCOPE164:
+      case DE_CDSN:
+      case DE_SRO:
+      case DE_DWWSSN:
+        samplesize = 2;
+        break;
+      case DE_GEOSCOPE24:
+        samplesize = 3;
+        break;
+      case DE_INT32:
+      case DE_FLOAT32:
+        samplesize = 4;
+        break;
+      case DE_STEIM1:
+      case DE_STEIM2:
+        samplesize = -1;
+        break;
+      case DE_FLOAT64:
+        samplesize = 8;
+        break;
+      default:
+        ms_log (2, "%s: Cannot convert byte order of data encoding %d (%s)\n",
+                msr->sid, msr->encoding, ms_encodingstr (msr->encoding));
+        return -1;
+      }
+    }
+  }
+
   /* Copy encoded data into record */
   memcpy (record + dataoffset, msr->record + origdataoffset, origdatasize);
 
-  /* Check to see if byte swapping is needed, miniSEED 3 is little endian */
-  swapflag = (ms_bigendianhost ()) ? 1 : 0;
+  /* Swap encoded data values */
+  if (samplesize == -1)
+    ms_swapsteim ((uint8_t *)record + dataoffset, origdatasize, msr->encoding);
+  else if (samplesize == 2)
+    for (idx = 0; idx + 2 <= origdatasize; idx += 2)
+      ms_gswap2 (record + dataoffset + idx);
+  else if (samplesize == 3)
+    for (idx = 0; idx + 3 <= origdatasize; idx += 3)
+    {
+      char byte = record[dataoffset + idx];
+      record[dataoffset + idx] = record[dataoffset + idx + 2];
+      record[dataoffset + idx + 2] = byte;
+    }
+  else if (samplesize == 4)
+    for (idx = 0; idx + 4 <= origdatasize; idx += 4)
+      ms_gswap4 (record + dataoffset + idx);
+  else if (samplesize == 8)
+    for (idx = 0; idx + 8 <= origdatasize; idx += 8)
+      ms_gswap8 (record + dataoffset + idx);
 
   /* Update number of samples and data length */
   *pMS3FSDH_NUMSAMPLES(record) = HO4u ((uint32_t)msr->samplecnt, swapflag);
@@ -469,6 +539,53 @@ msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen,
   return reclen;
 } /* End of msr3_repack_mseed3() */
 
+/***************************************************************************
+ * ms_swapsteim:
+ *
+ * Convert Steim 1 or 2 frames from little endian to big endian in
+ * place.  In little endian Steim data each value wider than a byte is
+ * swapped individually, as determined by the nibbles of each frame, and
+ * 8-bit differences are in stream order, see msr_decode_steim1() and
+ * msr_decode_steim2().
+ ***************************************************************************/
+static void
+ms_swapsteim (uint8_t *data, uint32_t datasize, uint8_t encoding)
+{
+  uint8_t *frame;
+  uint32_t control;
+  uint32_t frameoffset;
+  int widx;
+  int nibble;
+
+  for (frameoffset = 0; frameoffset + 4 <= datasize; frameoffset += 64)
+  {
+    frame = data + frameoffset;
+
+    /* Control word containing 16 x 2-bit nibbles, now big endian */
+    ms_gswap4 (frame);
+    control = ((uint32_t)frame[0] << 24) | ((uint32_t)frame[1] << 16) |
+              ((uint32_t)frame[2] << 8) | (uint32_t)frame[3];
+
+    for (widx = 1; widx < 16 && frameoffset + widx * 4 + 4 <= datasize; widx++)
+    {
+      nibble = (control >> (30 - (2 * widx))) & 0x3;
+
+      /* First frame: X0 and Xn integration constants */
+      if (frameoffset == 0 && widx <= 2)
+        ms_gswap4 (frame + widx * 4);
+      /* Steim1 two 16-bit differences */
+      else if (nibble == 2 && encoding == DE_STEIM1)
+      {
+        ms_gswap2 (frame + widx * 4);
+        ms_gswap2 (frame + widx * 4 + 2);
+      }
+      /* Steim1 32-bit difference, Steim2 words with bit fields */
+      else if (nibble == 2 || nibble == 3)
+        ms_gswap4 (frame + widx * 4);
+    }
+  }
+} /* End of ms_swapsteim() */
+
 /**********************************************************************/ /**
  * @brief Pack a miniSEED version 3 header into the specified buffer.
  *
@@ -154,6 +154,75 @@ msr3_parse (const char *record, uint64_t recbuflen, MS3Record **ppmsr,
   return MS_NOERROR;
 } /* End of msr3_parse() */
 
+/***************************************************************/ /**
+ * @brief Change a header field in a miniSEED record
+ *
+ * Overwrite a field in the header of a raw miniSEED record with a new
+ * value, without unpacking and repacking the record.  The field is
+ * identified by its location in the record, commonly determined using
+ * the field pointer macros in mseedformat.h, e.g.
+ * pMS3FSDH_PUBVERSION() or pMS2FSDH_DATAQUALITY().  The value must be
+ * in the byte order of the record.
+ *
+ * For miniSEED 3.x records the CRC stored in the header is updated
+ * incrementally for the changed bytes, in time independent of the
+ * record length, see ms_crc32c_patch().  The CRC field itself cannot be
+ * changed with this routine.
+ *
+ * @param[in,out] record Buffer containing the record
+ * @param[in] reclen Length of the record in bytes
+ * @param[in] field Location of the field in the record
+ * @param[in] value New value for the field
+ * @param[in] size Size of the field in bytes
+ *
+ * @returns 0 on success and a negative library error code on error.
+ *
+ * \ref MessageOnError - this function logs a message on error
+ *********************************************************************/
+int
+ms3_patchheader (char *record, uint64_t reclen, void *field,
+                 const void *value, int size)
+{
+  uint8_t *start = (uint8_t *)field;
+  uint64_t offset;
+  uint64_t crcoffset;
+  uint32_t crc;
+
+  if (!record || !field || !value || size <= 0)
+  {
+    ms_log (2, "%s(): Required input not defined\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (start < (uint8_t *)record || (uint64_t)(start - (uint8_t *)record) + size > reclen)
+  {
+    ms_log (2, "%s(): Field is not within the record\n", __func__);
+    return MS_GENERROR;
+  }
+
+  offset = start - (uint8_t *)record;
+
+  if (reclen >= MS3FSDH_LENGTH && MS3_ISVALIDHEADER (record))
+  {
+    crcoffset = (uint8_t *)pMS3FSDH_CRC (record) - (uint8_t *)record;
+
+    if (offset < crcoffset + sizeof (uint32_t) && offset + size > crcoffset)
+    {
+      ms_log (2, "%s(): Cannot patch CRC field of miniSEED 3 record\n", __func__);
+      return MS_GENERROR;
+    }
+
+    crc = HO4u (*pMS3FSDH_CRC (record), ms_bigendianhost ());
+    crc = ms_crc32c_patch (crc, start, (const uint8_t *)value, size,
+                           reclen - offset - size);
+    *pMS3FSDH_CRC (record) = HO4u (crc, ms_bigendianhost ());
+  }
+
+  memcpy (start, value, size);
+
+  return 0;
+} /* End of ms3_patchheader() */
+
 /***************************************************************/ /**
  * @brief Detect miniSEED record in buffer
  *
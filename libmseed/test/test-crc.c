@@ -1,5 +1,7 @@
 #include <tau/tau.h>
 #include <libmseed.h>
+#include <mseedformat.h>
+#include <string.h>
 
 /* Test vector structure */
 struct crc32c_testvec
@@ -157,4 +159,114 @@ TEST(CRC, CRC32C) {
 
   result = ms_crc32c ((const uint8_t *)"SOMEDATA", 0, 0);
   CHECK (result == 0, "CRC-32C NULL input test failure");
-}
\ No newline at end of file
+}
+
+TEST(CRC, patch) {
+  const struct crc32c_testvec *tv = &crc32c_testvectors[16];
+  uint8_t buffer[240];
+  uint8_t value[4] = {0x00, 0x5a, 0xa5, 0xff};
+  uint32_t crc;
+  uint32_t result;
+  int offset;
+  int size;
+
+  REQUIRE (tv->insize == 240, "Unexpected test vector for CRC patch");
+
+  /* Change each 1-4 byte run of the buffer, comparing to full calculation */
+  for (size = 1; size <= 4; size++)
+  {
+    for (offset = 0; offset + size <= (int)tv->insize; offset++)
+    {
+      memcpy (buffer, tv->input, tv->insize);
+      crc = ms_crc32c (buffer, tv->insize, 0);
+
+      result = ms_crc32c_patch (crc, buffer + offset, value, size, tv->insize - offset - size);
+      memcpy (buffer + offset, value, size);
+
+      if (result != ms_crc32c (buffer, tv->insize, 0))
+        break;
+    }
+
+    CHECK (offset + size > (int)tv->insize, "CRC-32C patch does not match full calculation");
+  }
+
+  /* No change */
+  crc = ms_crc32c (tv->input, tv->insize, 0);
+  result = ms_crc32c_patch (crc, tv->input, tv->input, 8, 100);
+  CHECK (result == crc, "CRC-32C patch with unchanged data is not expected");
+}
+
+TEST(CRC, combine) {
+  const struct crc32c_testvec *tv = &crc32c_testvectors[16];
+  uint32_t crc;
+  uint32_t result;
+  int split;
+
+  /* Combine CRCs of each split of the buffer, comparing to full calculation */
+  crc = ms_crc32c (tv->input, tv->insize, 0);
+
+  for (split = 0; split <= (int)tv->insize; split++)
+  {
+    result = ms_crc32c_combine (ms_crc32c (tv->input, split, 0),
+                                ms_crc32c (tv->input + split, tv->insize - split, 0),
+                                tv->insize - split);
+
+    if (result != crc)
+      break;
+  }
+
+  CHECK (split > (int)tv->insize, "CRC-32C combine does not match full calculation");
+}
+
+TEST(CRC, patchheader) {
+  char record[8192];
+  MS3Record *msr = NULL;
+  uint8_t formatversion;
+  uint8_t pubversion = 4;
+  char quality = 'Q';
+  int64_t reclen;
+  size_t length;
+  FILE *fp;
+  int rv;
+
+  /* miniSEED 3 record, CRC must be valid after patching */
+  fp = fopen ("data/testdata-3channel-signal.mseed3", "rb");
+  REQUIRE (fp != NULL, "Cannot open miniSEED 3 test file");
+  length = fread (record, 1, sizeof (record), fp);
+  fclose (fp);
+
+  reclen = ms3_detect (record, length, &formatversion);
+  REQUIRE (reclen > 0 && formatversion == 3, "Cannot detect miniSEED 3 record");
+
+  rv = ms3_patchheader (record, reclen, pMS3FSDH_PUBVERSION (record), &pubversion, 1);
+  CHECK (rv == 0, "ms3_patchheader() did not return expected 0");
+
+  rv = msr3_parse (record, reclen, &msr, MSF_VALIDATECRC, 0);
+  CHECK (rv == MS_NOERROR, "Patched miniSEED 3 record does not parse with CRC validation");
+  if (rv == MS_NOERROR)
+    CHECK (msr->pubversion == 4, "Patched publication version is not expected");
+
+  rv = ms3_patchheader (record, reclen, pMS3FSDH_CRC (record), &pubversion, 1);
+  CHECK (rv == MS_GENERROR, "ms3_patchheader() of CRC field did not fail as expected");
+
+  rv = ms3_patchheader (record, reclen, record + reclen, &pubversion, 1);
+  CHECK (rv == MS_GENERROR, "ms3_patchheader() outside of record did not fail as expected");
+
+  /* miniSEED 2 record, no CRC */
+  fp = fopen ("data/testdata-3channel-signal.mseed2", "rb");
+  REQUIRE (fp != NULL, "Cannot open miniSEED 2 test file");
+  length = fread (record, 1, sizeof (record), fp);
+  fclose (fp);
+
+  reclen = ms3_detect (record, length, &formatversion);
+  REQUIRE (reclen > 0 && formatversion == 2, "Cannot detect miniSEED 2 record");
+
+  rv = ms3_patchheader (record, reclen, pMS2FSDH_DATAQUALITY (record), &quality, 1);
+  CHECK (rv == 0, "ms3_patchheader() did not return expected 0");
+  CHECK (*pMS2FSDH_DATAQUALITY (record) == 'Q', "Patched data quality is not expected");
+
+  rv = msr3_parse (record, reclen, &msr, 0, 0);
+  CHECK (rv == MS_NOERROR, "Patched miniSEED 2 record does not parse");
+
+  msr3_free (&msr);
+}
@@ -0,0 +1,103 @@
+#include <tau/tau.h>
+#include <libmseed.h>
+
+/* gzip tests write compressed copies of test data using zlib */
+#if defined(LIBMSEED_ZLIB)
+
+#include <sys/stat.h>
+#include <zlib.h>
+
+extern int cmpfiles (char *fileA, char *fileB);
+
+#define GZIP_TESTFILE "data/testdata-3channel-signal.mseed3"
+#define GZIP_FILE     "testdata-gzip.mseed3.gz"
+#define GZIP_SPOOLDIR "testdata-spool"
+
+/* Write a gzip-compressed copy of a file, returning 0 on success */
+static int
+write_gzip (const char *source, const char *destination)
+{
+  char buffer[8192];
+  size_t length;
+  gzFile gz;
+  FILE *fp;
+
+  if ((fp = fopen (source, "rb")) == NULL)
+    return -1;
+
+  if ((gz = gzopen (destination, "wb")) == NULL)
+  {
+    fclose (fp);
+    return -1;
+  }
+
+  while ((length = fread (buffer, 1, sizeof (buffer), fp)) > 0)
+  {
+    if (gzwrite (gz, buffer, (unsigned int)length) != (int)length)
+      break;
+  }
+
+  fclose (fp);
+
+  return (gzclose (gz) == Z_OK && length == 0) ? 0 : -1;
+}
+
+/* Read all records from path, returning record count or -1 on error */
+static int
+read_records (const char *path)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int count = 0;
+  int rv;
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_PNAMERANGE, NULL, 0)) == MS_NOERROR)
+    count++;
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  return (rv == MS_ENDOFFILE) ? count : -1;
+}
+
+TEST (gzip, read)
+{
+  char spoolfile[1024];
+  char rangepath[100];
+  int filecount;
+  int rv;
+
+  filecount = read_records (GZIP_TESTFILE);
+  REQUIRE (filecount > 0, "Cannot read records from test file");
+
+  rv = write_gzip (GZIP_TESTFILE, GZIP_FILE);
+  REQUIRE (rv == 0, "Cannot write gzip test file");
+
+  /* Read without spooling */
+  rv = read_records (GZIP_FILE);
+  CHECK (rv == filecount, "Record count from gzip file does not match file");
+
+  /* Read with spooling, spool must match decompressed source */
+  mkdir (GZIP_SPOOLDIR, 0755);
+  rv = ms3_url_spooldir (GZIP_SPOOLDIR);
+  REQUIRE (rv == 0, "ms3_url_spooldir() did not return expected 0");
+
+  rv = read_records (GZIP_FILE);
+  CHECK (rv == filecount, "Record count from spooled gzip file does not match file");
+
+  rv = ms3_url_spoolfile (GZIP_FILE, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() did not return expected 0");
+  CHECK (cmpfiles (spoolfile, GZIP_TESTFILE) == 0, "Spool file does not match source");
+
+  /* Byte range from offset of second record in decompressed data */
+  snprintf (rangepath, sizeof (rangepath), "%s@478", GZIP_FILE);
+  rv = read_records (rangepath);
+  CHECK (rv == filecount - 1, "Record count from gzip file range is not expected");
+
+  rv = ms3_url_spoolfile (rangepath, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() for range did not return expected 0");
+  CHECK (read_records (rangepath) == filecount - 1, "Record count from re-read gzip file range is not expected");
+
+  ms3_url_spooldir (NULL);
+}
+
+#endif /* defined(LIBMSEED_ZLIB) */
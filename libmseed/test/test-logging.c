@@ -0,0 +1,65 @@
+#include <tau/tau.h>
+#include <libmseed.h>
+
+/* Messages printed through the test logging parameters */
+static char printed[1024];
+
+static void
+print_test (const char *message)
+{
+  strncat (printed, message, sizeof (printed) - strlen (printed) - 1);
+}
+
+TEST (logging, ring)
+{
+  MSLogParam logp = MSLogParam_INITIALIZER;
+  int rv;
+  int idx;
+
+  logp.log_print = print_test;
+  logp.diag_print = print_test;
+  logp.errprefix = "ERR: ";
+
+  rv = ms_rlog_ring_init (4, 0);
+  REQUIRE (rv == 0, "ms_rlog_ring_init() did not return expected 0");
+  CHECK (ms_rlog_ring_init (4, 0) == -1, "ms_rlog_ring_init() when enabled did not fail");
+
+  /* Messages are queued, not printed, those beyond capacity are discarded */
+  printed[0] = '\0';
+  for (idx = 0; idx < 6; idx++)
+    ms_log_l (&logp, 0, "message %d\n", idx);
+
+  CHECK_STREQ (printed, "");
+
+  rv = ms_rlog_ring_drain (&logp);
+  CHECK (rv == 4, "ms_rlog_ring_drain() did not return expected 4");
+  CHECK_STREQ (printed, "message 0\nmessage 1\nmessage 2\nmessage 3\n"
+                        "2 log messages discarded, log ring is full\n");
+
+  /* Ring is reused after draining */
+  printed[0] = '\0';
+  for (idx = 0; idx < 3; idx++)
+    ms_log_l (&logp, 2, "error %d\n", idx);
+
+  rv = ms_rlog_ring_free (&logp);
+  CHECK (rv == 3, "ms_rlog_ring_free() did not return expected 3");
+  CHECK_STREQ (printed, "ERR: error 0\nERR: error 1\nERR: error 2\n");
+
+  /* Messages below the minimum level are discarded */
+  rv = ms_rlog_ring_init (8, 1);
+  REQUIRE (rv == 0, "ms_rlog_ring_init() did not return expected 0");
+
+  printed[0] = '\0';
+  ms_log_l (&logp, 0, "verbose\n");
+  ms_log_l (&logp, 1, "warning\n");
+
+  rv = ms_rlog_ring_free (&logp);
+  CHECK (rv == 1, "ms_rlog_ring_free() did not return expected 1");
+  CHECK_STREQ (printed, "warning\n");
+
+  /* Messages are printed directly when the ring is not enabled */
+  printed[0] = '\0';
+  ms_log_l (&logp, 0, "direct\n");
+  CHECK_STREQ (printed, "direct\n");
+  CHECK (ms_rlog_ring_drain (&logp) == 0, "ms_rlog_ring_drain() without ring did not return 0");
+}
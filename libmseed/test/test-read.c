@@ -374,6 +374,98 @@ TEST (read, byterange)
   ms3_readmsr(&msr, NULL, flags, 0);
 }
 
+/* Write records of file to stream, each preceded by non-data.
+ * Returns record count, setting offsets of records written. */
+static int
+write_with_nondata (const char *path, FILE *ofp, uint32_t *seed, int64_t *offsets, int maxoffsets)
+{
+  static const char nondata[] = {'M', 'S', 'D', 'R', 'Q', 'x', '3', (char)0xff};
+  MS3Record *msr = NULL;
+  char *buffer;
+  long size;
+  long offset = 0;
+  int count = 0;
+  int garbage;
+  int idx;
+  FILE *fp;
+
+  if ((fp = fopen (path, "rb")) == NULL)
+    return -1;
+
+  fseek (fp, 0, SEEK_END);
+  size = ftell (fp);
+  rewind (fp);
+
+  if ((buffer = (char *)malloc (size)) == NULL || fread (buffer, size, 1, fp) != 1)
+  {
+    fclose (fp);
+    free (buffer);
+    return -1;
+  }
+  fclose (fp);
+
+  while (offset < size && count < maxoffsets &&
+         msr3_parse (buffer + offset, size - offset, &msr, 0, 0) == MS_NOERROR)
+  {
+    /* Non-data without possible record signatures, of varied lengths */
+    *seed = *seed * 1103515245 + 12345;
+    garbage = (count % 4 == 0) ? (int)(*seed % 7) : (int)(*seed % 20000);
+
+    for (idx = 0; idx < garbage; idx++)
+    {
+      *seed = *seed * 1103515245 + 12345;
+      fputc (nondata[(*seed >> 16) % sizeof (nondata)], ofp);
+    }
+
+    offsets[count++] = ftell (ofp);
+    fwrite (buffer + offset, msr->reclen, 1, ofp);
+    offset += msr->reclen;
+  }
+
+  msr3_free (&msr);
+  free (buffer);
+
+  return count;
+}
+
+TEST (read, skipnotdata)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int64_t offsets[1000];
+  uint32_t seed = 1;
+  int count;
+  int rv;
+  int idx = 0;
+  FILE *fp;
+
+  char *path = "testdata-skipnotdata.mseed";
+
+  fp = fopen (path, "wb");
+  REQUIRE (fp != NULL, "Cannot open test file for writing");
+
+  count = write_with_nondata ("data/testdata-3channel-signal.mseed3", fp, &seed, offsets, 1000);
+  REQUIRE (count > 0, "Cannot write v3 records with non-data");
+  rv = write_with_nondata ("data/testdata-3channel-signal.mseed2", fp, &seed, offsets + count, 1000 - count);
+  REQUIRE (rv > 0, "Cannot write v2 records with non-data");
+  count += rv;
+
+  fclose (fp);
+
+  /* All records must be found at their offsets */
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_SKIPNOTDATA, NULL, 0)) == MS_NOERROR)
+  {
+    if (idx < count)
+      CHECK (msfp->streampos - msr->reclen == offsets[idx], "Record not read at expected offset");
+    idx++;
+  }
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+  CHECK (idx == count, "Record count with non-data is not expected");
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+}
+
 TEST (read, selection)
 {
   MS3Record *msr = NULL;
@@ -398,6 +490,205 @@ TEST (read, selection)
   ms3_freeselections (selections);
 }
 
+/* Count records matching selections by complete parse and by reading with selections */
+static int
+count_selected (const char *path, const MS3Selections *selections, int *selectedcount)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int matchcount = 0;
+
+  *selectedcount = 0;
+
+  while (ms3_readmsr_selection (&msfp, &msr, path, 0, NULL, 0) == MS_NOERROR)
+    if (msr3_matchselect (selections, msr, NULL))
+      matchcount++;
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  while (ms3_readmsr_selection (&msfp, &msr, path, MSF_VALIDATECRC, selections, 0) == MS_NOERROR)
+    (*selectedcount)++;
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  return matchcount;
+}
+
+TEST (read, selection_prefilter)
+{
+  MS3Selections *selections = NULL;
+  const char *paths[] = {"data/testdata-3channel-signal.mseed3",
+                         "data/testdata-3channel-signal.mseed2",
+                         "data/testdata-oneseries-mixedlengths-mixedorder.mseed3",
+                         "data/testdata-oneseries-mixedlengths-mixedorder.mseed2",
+                         "data/testdata-unapplied-timecorrection.mseed2"};
+  int matchcount;
+  int selectedcount;
+  int idx;
+  int rv;
+
+  /* Source ID, publication version and time windows with edges within records */
+  rv = ms3_addselect (&selections, "FDSN:IU_COLA_*_L_H_Z", NSTUNSET, NSTUNSET, 0);
+  rv |= ms3_addselect (&selections, "FDSN:IU_COLA_*_L_H_1",
+                       ms_timestr2nstime ("2010-02-27T06:55:00.5Z"),
+                       ms_timestr2nstime ("2010-02-27T07:10:00.25Z"), 0);
+  rv |= ms3_addselect (&selections, "FDSN:XX_TEST_00_L_H_Z",
+                       ms_timestr2nstime ("2010-02-27T06:51:04.069539Z"),
+                       ms_timestr2nstime ("2010-02-27T06:53:00Z"), 0);
+  rv |= ms3_addselect (&selections, "*", ms_timestr2nstime ("2003-05-29T02:13:23.0434Z"),
+                       ms_timestr2nstime ("2003-05-29T02:13:23.0434Z"), 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  /* Records selected while reading must be those matching after a complete parse */
+  for (idx = 0; idx < (int)(sizeof (paths) / sizeof (paths[0])); idx++)
+  {
+    matchcount = count_selected (paths[idx], selections, &selectedcount);
+    CHECK (matchcount == selectedcount, "Selected record count does not match complete parse");
+  }
+
+  ms3_freeselections (selections);
+}
+
+/* Records larger than the initial read buffer, between small records */
+TEST (read, large_record)
+{
+  const char *path = "testdata-largerecord.mseed3";
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int32_t *samples;
+  int64_t numsamples[3] = {100, 500000, 100};
+  int count = 0;
+  int idx;
+  int rv;
+
+  samples = (int32_t *)malloc (500000 * sizeof (int32_t));
+  REQUIRE (samples != NULL, "Cannot allocate sample buffer");
+
+  for (idx = 0; idx < 500000; idx++)
+    samples[idx] = idx;
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->pubversion  = 1;
+  msr->starttime   = ms_timestr2nstime ("2012-05-12T00:00:00");
+  msr->samprate    = 40.0;
+  msr->encoding    = DE_INT32;
+  msr->datasamples = samples;
+  msr->sampletype  = 'i';
+
+  for (idx = 0; idx < 3; idx++)
+  {
+    msr->reclen     = (numsamples[idx] > 100) ? 4000000 : 512;
+    msr->numsamples = numsamples[idx];
+
+    rv = msr3_writemseed (msr, path, (idx == 0), MSF_FLUSHDATA, 0);
+    REQUIRE (rv == 1, "msr3_writemseed() did not write expected single record");
+  }
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+  free (samples);
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_UNPACKDATA, NULL, 0)) == MS_NOERROR)
+  {
+    if (count < 3)
+    {
+      CHECK (msr->numsamples == numsamples[count], "Decoded sample count is not expected");
+      CHECK (msr->samplecnt == numsamples[count], "Sample count is not expected");
+    }
+    count++;
+  }
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+  CHECK (count == 3, "Record count is not expected");
+
+  /* Buffer grew for the large record but remains bounded */
+  CHECK (msfp->readbuffersize >= 2000000, "Read buffer did not grow for large record");
+  CHECK (msfp->readbuffersize <= MAXRECLEN + 262144, "Read buffer grew beyond bound");
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+}
+
+/* Reading ahead and batch reading, asynchronous when io_uring is available */
+TEST (read, ioqueue)
+{
+  const char *path = "data/testdata-3channel-signal.mseed3";
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  MS3IORequest requests[60];
+  MS3IOQueue *ioq;
+  char *filedata;
+  char *buffer;
+  long size;
+  int64_t filesamples = 0;
+  int64_t samples = 0;
+  int idx;
+  int rv;
+  FILE *fp;
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, 0, NULL, 0)) == MS_NOERROR)
+    filesamples += msr->samplecnt;
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+  REQUIRE (filesamples > 0, "Cannot read records from test file");
+
+  rv = ms3_io_readahead (4);
+  REQUIRE (rv == 0 || rv == 1, "ms3_io_readahead() did not return expected 0 or 1");
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, 0, NULL, 0)) == MS_NOERROR)
+    samples += msr->samplecnt;
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+  CHECK (samples == filesamples, "Sample count reading ahead does not match");
+  ms3_io_readahead (0);
+
+  fp = fopen (path, "rb");
+  REQUIRE (fp != NULL, "Cannot open test file");
+
+  fseek (fp, 0, SEEK_END);
+  size = ftell (fp);
+  rewind (fp);
+
+  filedata = (char *)malloc (size);
+  buffer   = (char *)malloc (60 * 1000);
+  REQUIRE (filedata != NULL && buffer != NULL, "Cannot allocate buffers");
+  REQUIRE (fread (filedata, size, 1, fp) == 1, "Cannot read test file");
+
+  /* Ranges in reverse order, the first beyond and at the end of the file */
+  for (idx = 0; idx < 60; idx++)
+  {
+    requests[idx].fd     = fileno (fp);
+    requests[idx].offset = (int64_t)(59 - idx) * 1000;
+    requests[idx].length = 1000;
+    requests[idx].buffer = buffer + idx * 1000;
+  }
+
+  ioq = ms3_ioqueue_init (8, buffer, 60 * 1000);
+  REQUIRE (ioq != NULL, "ms3_ioqueue_init() returned unexpected NULL");
+
+  rv = ms3_ioqueue_read (ioq, requests, 60);
+  CHECK (rv == size / 1000, "ms3_ioqueue_read() did not return expected count of complete reads");
+
+  for (idx = 0; idx < 60; idx++)
+  {
+    int64_t expected = size - requests[idx].offset;
+
+    if (expected > 1000)
+      expected = 1000;
+    if (expected < 0)
+      expected = 0;
+
+    CHECK (requests[idx].result == expected, "Read request result is not expected");
+    CHECK (memcmp (requests[idx].buffer, filedata + requests[idx].offset, expected) == 0,
+           "Read request data does not match file");
+  }
+
+  ms3_ioqueue_free (ioq);
+  fclose (fp);
+  free (filedata);
+  free (buffer);
+}
+
 TEST (read, oddball)
 {
   MS3Record *msr = NULL;
@@ -0,0 +1,169 @@
+#include <tau/tau.h>
+#include <libmseed.h>
+
+/* POSIX threads are not available with the Windows build of the tests */
+#if !defined(LMP_WIN)
+#include <pthread.h>
+
+#define THREAD_COUNT 8
+#define THREAD_ITERATIONS 4
+
+static const char *threadfiles[] = {
+    "data/testdata-3channel-signal.mseed3",
+    "data/testdata-oneseries-mixedlengths-mixedorder.mseed2",
+    "data/reference-testdata-steim2.mseed3",
+    "data/reference-testdata-float64.mseed3",
+};
+#define THREAD_FILES (sizeof (threadfiles) / sizeof (threadfiles[0]))
+
+/* Summary of the work done on one file, identical for every thread */
+typedef struct ThreadResult
+{
+  int64_t segments;
+  int64_t tracesamples;
+  int64_t tracesum;
+  int64_t records;
+  int64_t unpacked;
+  int64_t packedbytes;
+  uint32_t packedcrc;
+} ThreadResult;
+
+typedef struct ThreadWork
+{
+  const MS3Selections *selections;
+  ThreadResult *reference;
+  int mismatches;
+  int errors;
+} ThreadWork;
+
+static void
+record_digest (char *record, int reclen, void *handlerdata)
+{
+  ThreadResult *result = (ThreadResult *)handlerdata;
+
+  result->packedbytes += reclen;
+  result->packedcrc = ms_crc32c ((const uint8_t *)record, reclen, result->packedcrc);
+}
+
+/* Read a trace list with selections, then unpack and repack each record */
+static int
+run_workload (const char *path, const MS3Selections *selections, ThreadResult *result)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id;
+  MS3TraceSeg *seg;
+  int64_t packedsamples;
+  int64_t idx;
+  int rv;
+
+  memset (result, 0, sizeof (ThreadResult));
+
+  rv = ms3_readtracelist_selection (&mstl, path, NULL, selections, 0, MSF_UNPACKDATA, 0);
+
+  if (rv != MS_NOERROR)
+    return -1;
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      result->segments++;
+      result->tracesamples += seg->numsamples;
+
+      if (seg->sampletype == 'i')
+        for (idx = 0; idx < seg->numsamples; idx++)
+          result->tracesum += ((int32_t *)seg->datasamples)[idx];
+    }
+  }
+
+  mstl3_free (&mstl, 1);
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, 0, selections, 0)) == MS_NOERROR)
+  {
+    result->records++;
+
+    if (msr3_unpack_data (msr, 0) < 0)
+      break;
+
+    result->unpacked += msr->numsamples;
+
+    if (msr3_pack (msr, record_digest, result, &packedsamples, MSF_FLUSHDATA, 0) < 0)
+      break;
+  }
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  return (rv == MS_ENDOFFILE) ? 0 : -1;
+}
+
+static void *
+run_thread (void *arg)
+{
+  ThreadWork *work = (ThreadWork *)arg;
+  ThreadResult result;
+  int iteration;
+  size_t fileidx;
+
+  for (iteration = 0; iteration < THREAD_ITERATIONS; iteration++)
+  {
+    for (fileidx = 0; fileidx < THREAD_FILES; fileidx++)
+    {
+      if (run_workload (threadfiles[fileidx], work->selections, &result))
+        work->errors++;
+      else if (memcmp (&result, &work->reference[fileidx], sizeof (ThreadResult)))
+        work->mismatches++;
+    }
+  }
+
+  return NULL;
+}
+
+TEST (thread, concurrent)
+{
+  MS3Selections *selections = NULL;
+  ThreadResult reference[THREAD_FILES];
+  ThreadWork work[THREAD_COUNT];
+  pthread_t threads[THREAD_COUNT];
+  size_t fileidx;
+  int idx;
+  int rv;
+
+  rv = ms3_addselect (&selections, "*", NSTUNSET, NSTUNSET, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  /* Results from a single thread to compare against */
+  for (fileidx = 0; fileidx < THREAD_FILES; fileidx++)
+  {
+    rv = run_workload (threadfiles[fileidx], selections, &reference[fileidx]);
+    REQUIRE (rv == 0, "Single thread workload failed");
+    CHECK (reference[fileidx].records > 0, "No records read in single thread workload");
+    CHECK (reference[fileidx].unpacked == reference[fileidx].tracesamples,
+           "Unpacked sample count does not match trace list");
+  }
+
+  /* The same work by concurrent threads sharing the selections */
+  for (idx = 0; idx < THREAD_COUNT; idx++)
+  {
+    work[idx].selections = selections;
+    work[idx].reference = reference;
+    work[idx].mismatches = 0;
+    work[idx].errors = 0;
+
+    rv = pthread_create (&threads[idx], NULL, run_thread, &work[idx]);
+    REQUIRE (rv == 0, "pthread_create() failed");
+  }
+
+  for (idx = 0; idx < THREAD_COUNT; idx++)
+  {
+    pthread_join (threads[idx], NULL);
+
+    CHECK (work[idx].errors == 0, "Thread workload failed");
+    CHECK (work[idx].mismatches == 0, "Thread results do not match single thread results");
+  }
+
+  ms3_freeselections (selections);
+}
+
+#endif /* !defined(LMP_WIN) */
@@ -111,4 +111,260 @@ TEST (time, nstime)
 
   nstime = ms_timestr2nstime ("20040512T000000");
   CHECK (nstime == NSTERROR, "Failed to produce error for time string: '20040512T000000'");
-}
\ No newline at end of file
+}
+
+/* Reference for ms_trimsamples(), stepping one sample period at a time */
+static int64_t
+trimsamples_step (nstime_t time, nstime_t bound, nstime_t nsperiod,
+                  int64_t samplecnt, int8_t fromend, nstime_t *newtime)
+{
+  int64_t count = 0;
+
+  if (nsperiod > 0)
+  {
+    while ((fromend) ? (time > bound) : (time < bound))
+    {
+      if (count >= samplecnt)
+        break;
+
+      time = (fromend) ? time - nsperiod : time + nsperiod;
+      count++;
+    }
+  }
+
+  *newtime = time;
+
+  return count;
+}
+
+TEST (time, trimsamples)
+{
+  const double samprates[] = {0.1, 1.0, 20.0, 40.0, 100.0, 200.0, 250.0, 1000.0,
+                              3000.0, 5000.0, 10000.0, 1.0 / 3.0, 333.333};
+  const int64_t samplecnts[] = {0, 1, 2, 7, 100};
+  const nstime_t starttime = 1084345689123456788;
+  nstime_t nsperiod;
+  nstime_t endtime;
+  nstime_t bound;
+  nstime_t edges[5];
+  nstime_t newtime;
+  nstime_t reftime;
+  int64_t count;
+  int64_t refcount;
+  int64_t offset;
+  int mismatches = 0;
+  int rate;
+  int cnt;
+  int edge;
+  int8_t fromend;
+
+  for (rate = 0; rate < (int)(sizeof (samprates) / sizeof (samprates[0])); rate++)
+  {
+    nsperiod = (nstime_t)(NSTMODULUS / samprates[rate] + 0.5);
+
+    /* Offsets around each sample time, including default half-period tolerance */
+    edges[0] = -1;
+    edges[1] = 0;
+    edges[2] = 1;
+    edges[3] = nsperiod / 2;
+    edges[4] = -(nsperiod / 2);
+
+    for (cnt = 0; cnt < (int)(sizeof (samplecnts) / sizeof (samplecnts[0])); cnt++)
+    {
+      endtime = starttime + (samplecnts[cnt] - 1) * nsperiod;
+
+      for (offset = -3; offset <= samplecnts[cnt] + 3; offset++)
+      {
+        for (edge = 0; edge < 5; edge++)
+        {
+          for (fromend = 0; fromend <= 1; fromend++)
+          {
+            bound = starttime + offset * nsperiod + edges[edge];
+
+            count = ms_trimsamples ((fromend) ? endtime : starttime, bound, nsperiod,
+                                    samplecnts[cnt], fromend, &newtime);
+            refcount = trimsamples_step ((fromend) ? endtime : starttime, bound, nsperiod,
+                                         samplecnts[cnt], fromend, &reftime);
+
+            if (count != refcount || newtime != reftime)
+              mismatches++;
+          }
+        }
+      }
+    }
+  }
+
+  CHECK (mismatches == 0, "ms_trimsamples() does not match stepped trimming");
+
+  /* Invalid period, nothing to trim */
+  count = ms_trimsamples (starttime, starttime + 1000, 0, 10, 0, &newtime);
+  CHECK (count == 0 && newtime == starttime, "ms_trimsamples() with zero period is not expected");
+}
+
+/* Reference for ms_sampletime(), checking each leap second in the list */
+static nstime_t
+sampletime_walk (nstime_t time, int64_t offset, double samprate)
+{
+  nstime_t span = (nstime_t)(((double)offset / samprate * NSTMODULUS) + 0.5);
+  LeapSecond *ls;
+
+  for (ls = leapsecondlist; ls; ls = ls->next)
+  {
+    if (ls->leapsecond > time && ls->leapsecond <= (time + span - NSTMODULUS))
+    {
+      span -= NSTMODULUS;
+      break;
+    }
+  }
+
+  return time + span;
+}
+
+/* Count mismatches of ms_sampletime() with the reference around each leap second */
+static int
+sampletime_mismatches (LeapSecond *list)
+{
+  const double samprates[] = {0.1, 1.0, 40.0};
+  const int64_t offsets[] = {0, 1, 2, 39, 40, 41, 1000};
+  const nstime_t edges[] = {-2 * NSTMODULUS, -NSTMODULUS, -1, 0, 1, NSTMODULUS};
+  nstime_t time;
+  LeapSecond *ls;
+  int mismatches = 0;
+  int rate;
+  int offset;
+  int edge;
+
+  for (ls = list; ls; ls = ls->next)
+    for (rate = 0; rate < (int)(sizeof (samprates) / sizeof (samprates[0])); rate++)
+      for (offset = 0; offset < (int)(sizeof (offsets) / sizeof (offsets[0])); offset++)
+        for (edge = 0; edge < (int)(sizeof (edges) / sizeof (edges[0])); edge++)
+        {
+          time = ls->leapsecond + edges[edge] - (nstime_t)(offsets[offset] / samprates[rate] * NSTMODULUS);
+
+          if (ms_sampletime (time, offsets[offset], samprates[rate]) !=
+              sampletime_walk (time, offsets[offset], samprates[rate]))
+            mismatches++;
+        }
+
+  return mismatches;
+}
+
+TEST (time, sampletime_leapsecond)
+{
+  const char *leapfile = "testdata-leapseconds.list";
+  LeapSecond *embedded = leapsecondlist;
+  LeapSecond *ls;
+  LeapSecond single;
+  nstime_t time;
+  FILE *fp;
+  int count = 0;
+  int rv;
+
+  REQUIRE (embedded != NULL, "Embedded leap second list is not available");
+
+  /* Embedded list, 2017-01-01 leap second within span */
+  time = ms_timestr2nstime ("2016-12-31T23:59:50Z");
+  CHECK (ms_sampletime (time, 20, 1.0) == time + (nstime_t)19 * NSTMODULUS,
+         "ms_sampletime() did not remove leap second from span");
+  CHECK (ms_sampletime (time, 5, 1.0) == time + (nstime_t)5 * NSTMODULUS,
+         "ms_sampletime() adjusted span without a leap second");
+  CHECK (sampletime_mismatches (embedded) == 0, "ms_sampletime() does not match embedded list");
+
+  /* Write the embedded list in reverse order, it must be sorted when read */
+  fp = fopen (leapfile, "wb");
+  REQUIRE (fp != NULL, "Cannot write leap second test file");
+  fprintf (fp, "#@ 9999999999\n# Leap second test list\n");
+  for (ls = embedded; ls; ls = ls->next)
+    count++;
+  for (rv = count - 1; rv >= 0; rv--)
+    fprintf (fp, "%" PRId64 " %d\n", MS_NSTIME2EPOCH (embedded[rv].leapsecond) + 2208988800LL,
+             embedded[rv].TAIdelta);
+  fclose (fp);
+
+  rv = ms_readleapsecondfile (leapfile);
+  CHECK (rv == count, "ms_readleapsecondfile() did not return expected count");
+  REQUIRE (leapsecondlist != NULL, "Leap second list not loaded");
+
+  for (ls = leapsecondlist; ls && ls->next; ls = ls->next)
+    CHECK (ls->leapsecond < ls->next->leapsecond, "Leap second list is not sorted");
+
+  CHECK (sampletime_mismatches (leapsecondlist) == 0, "ms_sampletime() does not match list read from file");
+
+  /* List set by caller is checked entry by entry */
+  single.leapsecond = ms_timestr2nstime ("2016-12-31T00:00:00Z");
+  single.TAIdelta = 0;
+  single.next = NULL;
+  ls = leapsecondlist;
+  leapsecondlist = &single;
+
+  time = ms_timestr2nstime ("2016-12-30T23:59:50Z");
+  CHECK (ms_sampletime (time, 20, 1.0) == time + (nstime_t)19 * NSTMODULUS,
+         "ms_sampletime() did not use caller list");
+  CHECK (sampletime_mismatches (&single) == 0, "ms_sampletime() does not match caller list");
+
+  /* Reloading after the caller detached the list replaces the array read before */
+  leapsecondlist = NULL;
+  rv = ms_readleapsecondfile (leapfile);
+  CHECK (rv == count, "ms_readleapsecondfile() did not return expected count on reload");
+  REQUIRE (leapsecondlist != NULL, "Leap second list not reloaded");
+  CHECK (sampletime_mismatches (leapsecondlist) == 0, "ms_sampletime() does not match reloaded list");
+}
+
+TEST (time, cached)
+{
+  const ms_timeformat_t formats[] = {ISOMONTHDAY_Z, ISOMONTHDAY_DOY, SEEDORDINAL, UNIXEPOCH};
+  const nstime_t starts[] = {1084345689123456788, 1483228790000000000, -14182939012345679,
+                             951782400000000000, 0};
+  MSDayCache cache = MSDayCache_INITIALIZER;
+  nstime_t nstimes[200];
+  char timestrs[200][40];
+  char timestr[40];
+  char cachedstr[40];
+  uint16_t year, yday, cyear, cyday;
+  uint8_t hour, min, sec, chour, cmin, csec;
+  uint32_t nsec, cnsec;
+  int mismatches = 0;
+  int start;
+  int format;
+  int idx;
+  int rv;
+
+  /* Times stepping across day boundaries, forward and backward */
+  for (start = 0; start < (int)(sizeof (starts) / sizeof (starts[0])); start++)
+  {
+    for (idx = 0; idx < 200; idx++)
+      nstimes[idx] = starts[start] + (nstime_t)(idx - 100) * 3599123456789 * ((idx & 1) ? 1 : -1);
+
+    for (idx = 0; idx < 200; idx++)
+    {
+      ms_nstime2time (nstimes[idx], &year, &yday, &hour, &min, &sec, &nsec);
+      ms_nstime2time_cached (nstimes[idx], &cache, &cyear, &cyday, &chour, &cmin, &csec, &cnsec);
+
+      if (year != cyear || yday != cyday || hour != chour || min != cmin ||
+          sec != csec || nsec != cnsec)
+        mismatches++;
+    }
+
+    for (format = 0; format < (int)(sizeof (formats) / sizeof (formats[0])); format++)
+    {
+      rv = ms_nstime2timestr_bulk (nstimes, 200, timestrs[0], sizeof (timestrs[0]),
+                                   formats[format], NANO_MICRO_NONE);
+      CHECK (rv == 200, "ms_nstime2timestr_bulk() did not return expected count");
+
+      for (idx = 0; idx < 200; idx++)
+      {
+        ms_nstime2timestr (nstimes[idx], timestr, formats[format], NANO_MICRO_NONE);
+        ms_nstime2timestr_cached (nstimes[idx], &cache, cachedstr, formats[format], NANO_MICRO_NONE);
+
+        if (strcmp (timestr, timestrs[idx]) || strcmp (timestr, cachedstr))
+          mismatches++;
+      }
+    }
+  }
+
+  CHECK (mismatches == 0, "Cached time conversions do not match uncached conversions");
+
+  /* Stride too small for time strings */
+  rv = ms_nstime2timestr_bulk (nstimes, 2, timestrs[0], 20, ISOMONTHDAY_Z, NANO);
+  CHECK (rv == -1, "ms_nstime2timestr_bulk() with small stride did not fail");
+}
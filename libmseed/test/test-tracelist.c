@@ -181,4 +181,127 @@ TEST (read, recptr_buffer)
   CHECK (int32s[3951] == -146622, "Decoded sample value mismatch");
 
   mstl3_free (&mstl, 1);
-}
\ No newline at end of file
+}
+
+/* Add 10-sample records in given order of slots, with a gap after every third record */
+static MS3TraceList *
+add_gappy_records (const int *order, int count, int8_t autoheal)
+{
+  MS3TraceList *mstl = mstl3_init (NULL);
+  MS3Record *msr     = msr3_init (NULL);
+  int idx;
+
+  if (!mstl || !msr)
+    return NULL;
+
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate  = 1.0;
+  msr->samplecnt = 10;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    msr->starttime = (nstime_t)(order[idx] + order[idx] / 3) * 10 * NSTMODULUS;
+
+    if (!mstl3_addmsr (mstl, msr, 0, autoheal, 0, NULL))
+    {
+      mstl3_free (&mstl, 0);
+      break;
+    }
+  }
+
+  msr3_free (&msr);
+
+  return mstl;
+}
+
+TEST (trace, outoforder)
+{
+  MS3TraceList *inorder  = NULL;
+  MS3TraceList *shuffled = NULL;
+  MS3TraceSeg *seg;
+  MS3TraceSeg *shuffledseg;
+  uint64_t state = 1;
+  int order[3000];
+  int count = sizeof (order) / sizeof (order[0]);
+  int idx;
+  int swap;
+  int tmp;
+
+  for (idx = 0; idx < count; idx++)
+    order[idx] = idx;
+
+  inorder = add_gappy_records (order, count, 1);
+  REQUIRE (inorder != NULL, "Cannot add records in order");
+
+  /* Shuffle order of records */
+  for (idx = count - 1; idx > 0; idx--)
+  {
+    state       = 6364136223846793005ULL * state + 1;
+    swap        = (int)((state >> 33) % (uint64_t)(idx + 1));
+    tmp         = order[idx];
+    order[idx]  = order[swap];
+    order[swap] = tmp;
+  }
+
+  shuffled = add_gappy_records (order, count, 1);
+  REQUIRE (shuffled != NULL, "Cannot add records out of order");
+
+  REQUIRE (inorder->numtraceids == 1 && shuffled->numtraceids == 1, "Trace ID count is not expected 1");
+  CHECK (inorder->traces.next[0]->numsegments == (uint32_t)count / 3, "In order segment count is not expected");
+  CHECK (shuffled->traces.next[0]->numsegments == inorder->traces.next[0]->numsegments,
+         "Out of order segment count does not match in order");
+
+  /* Segments must match coverage of in order addition, in the same order */
+  shuffledseg = shuffled->traces.next[0]->first;
+  for (seg = inorder->traces.next[0]->first; seg && shuffledseg; seg = seg->next, shuffledseg = shuffledseg->next)
+  {
+    if (seg->starttime != shuffledseg->starttime || seg->endtime != shuffledseg->endtime ||
+        seg->samplecnt != shuffledseg->samplecnt)
+      break;
+  }
+
+  CHECK (seg == NULL && shuffledseg == NULL, "Out of order segments do not match in order segments");
+  CHECK (shuffled->traces.next[0]->last->next == NULL, "Last segment is not at end of list");
+
+  mstl3_free (&inorder, 0);
+  mstl3_free (&shuffled, 0);
+}
+
+TEST (trace, sidhandle)
+{
+  MS3TraceList *mstl = mstl3_init (NULL);
+  MS3Record *msr     = msr3_init (NULL);
+  MS3TraceID *id;
+  const char *sids[] = {"FDSN:XX_B__B_H_Z", "FDSN:XX_A__B_H_Z", "FDSN:XX_B__B_H_Z", "FDSN:XX_C__B_H_Z"};
+  uint8_t versions[] = {1, 1, 2, 1};
+  int idx;
+
+  REQUIRE (mstl != NULL && msr != NULL, "Cannot initialize structures");
+
+  msr->samprate  = 1.0;
+  msr->samplecnt = 10;
+  msr->starttime = 0;
+
+  /* Add SIDs with two publication versions of one SID kept separate */
+  for (idx = 0; idx < 4; idx++)
+  {
+    strcpy (msr->sid, sids[idx]);
+    msr->pubversion = versions[idx];
+
+    CHECK (mstl3_addmsr (mstl, msr, 1, 1, 0, NULL) != NULL, "mstl3_addmsr() returned unexpected NULL");
+  }
+
+  CHECK (mstl->numtraceids == 4, "mstl->numtraceids is not expected 4");
+  CHECK (mstl->numsids == 3, "mstl->numsids is not expected 3");
+
+  /* List order: A(1), B(1), B(2), C(1) */
+  id = mstl->traces.next[0];
+  REQUIRE (id && id->next[0] && id->next[0]->next[0] && id->next[0]->next[0]->next[0], "Trace IDs are not populated");
+  CHECK (id->sidhandle != id->next[0]->sidhandle, "Different SIDs have the same handle");
+  CHECK (id->next[0]->sidhandle == id->next[0]->next[0]->sidhandle, "Versions of SID do not share a handle");
+  CHECK (id->next[0]->next[0]->sidhandle != id->next[0]->next[0]->next[0]->sidhandle, "Different SIDs have the same handle");
+  CHECK (id->next[0]->sidhandle == 0, "Handle of first SID added is not 0");
+
+  msr3_free (&msr);
+  mstl3_free (&mstl, 0);
+}
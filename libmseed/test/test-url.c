@@ -0,0 +1,291 @@
+#include <tau/tau.h>
+#include <libmseed.h>
+
+/* URL tests use a minimal HTTP server on the loopback interface */
+#if defined(LIBMSEED_URL) && !defined(_WIN32)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern int cmpfiles (char *fileA, char *fileB);
+
+#define URL_TESTFILE "data/testdata-3channel-signal.mseed3"
+#define URL_SPOOLDIR "testdata-spool"
+#define URL_ETAG     "\"testdata-v1\""
+
+/* Server modes: serve file (with range support) or only confirm not modified */
+#define SERVE_FILE        0
+#define SERVE_NOTMODIFIED 1
+
+/* Handle HTTP requests on listening socket until killed */
+static void
+serve (int listenfd, int mode)
+{
+  char request[4096];
+  char header[512];
+  char *range;
+  char *data = NULL;
+  int head;
+  long start;
+  long end;
+  ssize_t length;
+  size_t filesize;
+  struct stat sb;
+  FILE *fp;
+  int fd;
+
+  if (stat (URL_TESTFILE, &sb) || (data = malloc (sb.st_size)) == NULL ||
+      (fp = fopen (URL_TESTFILE, "rb")) == NULL)
+    _exit (1);
+
+  filesize = fread (data, 1, sb.st_size, fp);
+  fclose (fp);
+
+  while ((fd = accept (listenfd, NULL, NULL)) >= 0)
+  {
+    /* Read request headers, sufficient for the small requests by libcurl */
+    length = 0;
+    while (length < (ssize_t)sizeof (request) - 1)
+    {
+      ssize_t rv = read (fd, request + length, sizeof (request) - 1 - length);
+
+      if (rv <= 0)
+        break;
+
+      length += rv;
+      request[length] = '\0';
+
+      if (strstr (request, "\r\n\r\n"))
+        break;
+    }
+    request[length] = '\0';
+    head = (strncmp (request, "HEAD ", 5) == 0);
+
+    if (strstr (request, "If-None-Match: " URL_ETAG))
+    {
+      snprintf (header, sizeof (header),
+                "HTTP/1.1 304 Not Modified\r\nETag: " URL_ETAG "\r\n"
+                "Connection: close\r\n\r\n");
+      write (fd, header, strlen (header));
+    }
+    else if (mode == SERVE_NOTMODIFIED)
+    {
+      snprintf (header, sizeof (header),
+                "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n"
+                "Connection: close\r\n\r\n");
+      write (fd, header, strlen (header));
+    }
+    else if ((range = strstr (request, "Range: bytes=")) != NULL)
+    {
+      start = strtol (range + 13, &range, 10);
+      end   = (*range == '-' && isdigit ((int)range[1])) ? strtol (range + 1, NULL, 10) : (long)filesize - 1;
+
+      if (end >= (long)filesize)
+        end = filesize - 1;
+
+      snprintf (header, sizeof (header),
+                "HTTP/1.1 206 Partial Content\r\nETag: " URL_ETAG "\r\nAccept-Ranges: bytes\r\n"
+                "Content-Range: bytes %ld-%ld/%zu\r\nContent-Length: %ld\r\n"
+                "Connection: close\r\n\r\n",
+                start, end, filesize, end - start + 1);
+      write (fd, header, strlen (header));
+      if (!head)
+        write (fd, data + start, end - start + 1);
+    }
+    else
+    {
+      snprintf (header, sizeof (header),
+                "HTTP/1.1 200 OK\r\nETag: " URL_ETAG "\r\nAccept-Ranges: bytes\r\nContent-Length: %zu\r\n"
+                "Connection: close\r\n\r\n",
+                filesize);
+      write (fd, header, strlen (header));
+      if (!head)
+        write (fd, data, filesize);
+    }
+
+    close (fd);
+  }
+
+  _exit (0);
+}
+
+/* Start server process on port (0 for any), returning PID and setting
+ * the base URL and port */
+static pid_t
+start_server (int mode, int *port, char *url, size_t size)
+{
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof (addr);
+  int reuse = 1;
+  pid_t pid;
+  int listenfd;
+
+  if ((listenfd = socket (AF_INET, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  setsockopt (listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port        = htons (*port);
+
+  if (bind (listenfd, (struct sockaddr *)&addr, sizeof (addr)) ||
+      listen (listenfd, 8) ||
+      getsockname (listenfd, (struct sockaddr *)&addr, &addrlen))
+  {
+    close (listenfd);
+    return -1;
+  }
+
+  *port = ntohs (addr.sin_port);
+  snprintf (url, size, "http://127.0.0.1:%d/testdata.mseed3", *port);
+
+  if ((pid = fork ()) == 0)
+    serve (listenfd, mode);
+
+  close (listenfd);
+
+  return pid;
+}
+
+static void
+stop_server (pid_t pid)
+{
+  if (pid > 0)
+  {
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+  }
+}
+
+/* Read all records from path, returning record count or -1 on error */
+static int
+read_records (const char *path)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int count = 0;
+  int rv;
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_PNAMERANGE, NULL, 0)) == MS_NOERROR)
+    count++;
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  return (rv == MS_ENDOFFILE) ? count : -1;
+}
+
+TEST (url, spool)
+{
+  char url[100];
+  char rangeurl[120];
+  char spoolfile[1024];
+  int filecount;
+  int port = 0;
+  pid_t pid;
+  int rv;
+
+  filecount = read_records (URL_TESTFILE);
+  REQUIRE (filecount > 0, "Cannot read records from test file");
+
+  mkdir (URL_SPOOLDIR, 0755);
+  rv = ms3_url_spooldir (URL_SPOOLDIR);
+  REQUIRE (rv == 0, "ms3_url_spooldir() did not return expected 0");
+
+  /* Read through spool, spool must match source */
+  pid = start_server (SERVE_FILE, &port, url, sizeof (url));
+  REQUIRE (pid > 0, "Cannot start test HTTP server");
+
+  /* Remove any spool from a previous run */
+  ms3_url_spoolfile (url, spoolfile, sizeof (spoolfile));
+  remove (spoolfile);
+
+  rv = read_records (url);
+  CHECK (rv == filecount, "Record count from URL does not match file");
+
+  rv = ms3_url_spoolfile (url, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() did not return expected 0");
+  CHECK (cmpfiles (spoolfile, URL_TESTFILE) == 0, "Spool file does not match source");
+
+  /* Byte range from offset of second record, spooled at same offsets */
+  snprintf (rangeurl, sizeof (rangeurl), "%s@478", url);
+  rv = read_records (rangeurl);
+  CHECK (rv == filecount - 1, "Record count from URL range is not expected");
+
+  rv = ms3_url_spoolfile (rangeurl, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() for range did not return expected 0");
+  CHECK (read_records (rangeurl) == filecount - 1, "Record count from re-read URL range is not expected");
+
+  stop_server (pid);
+
+  /* Server at same URL only confirms validity of cached data, records must come from spool */
+  pid = start_server (SERVE_NOTMODIFIED, &port, url, sizeof (url));
+  REQUIRE (pid > 0, "Cannot start test HTTP server");
+
+  rv = read_records (url);
+  CHECK (rv == filecount, "Record count from not modified URL does not match file");
+
+  stop_server (pid);
+
+  ms3_url_spooldir (NULL);
+}
+
+TEST (url, prefetch)
+{
+  char url[100];
+  char rangeurl[120];
+  char spoolfile[1024];
+  const char *urls[2];
+  int filecount;
+  int port = 0;
+  pid_t pid;
+  int rv;
+
+  filecount = read_records (URL_TESTFILE);
+  REQUIRE (filecount > 0, "Cannot read records from test file");
+
+  mkdir (URL_SPOOLDIR, 0755);
+  rv = ms3_url_spooldir (URL_SPOOLDIR);
+  REQUIRE (rv == 0, "ms3_url_spooldir() did not return expected 0");
+
+  pid = start_server (SERVE_FILE, &port, url, sizeof (url));
+  REQUIRE (pid > 0, "Cannot start test HTTP server");
+
+  snprintf (rangeurl, sizeof (rangeurl), "%s@478", url);
+  urls[0] = url;
+  urls[1] = rangeurl;
+
+  /* Remove any existing spool so the objects are fetched */
+  ms3_url_spoolfile (url, spoolfile, sizeof (spoolfile));
+  remove (spoolfile);
+  ms3_url_spoolfile (rangeurl, spoolfile, sizeof (spoolfile));
+  remove (spoolfile);
+
+  /* Fetch concurrently, split into many range requests */
+  rv = ms3_url_prefetch (urls, 2, 4, 5000, 0);
+  CHECK (rv == 2, "ms3_url_prefetch() did not return expected 2");
+
+  rv = ms3_url_spoolfile (url, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() did not return expected 0");
+  CHECK (cmpfiles (spoolfile, URL_TESTFILE) == 0, "Prefetched spool file does not match source");
+
+  stop_server (pid);
+
+  /* Prefetched URLs are read from spool without a server */
+  rv = read_records (url);
+  CHECK (rv == filecount, "Record count from prefetched URL does not match file");
+
+  rv = read_records (rangeurl);
+  CHECK (rv == filecount - 1, "Record count from prefetched URL range is not expected");
+
+  ms3_url_spooldir (NULL);
+}
+
+#endif /* defined(LIBMSEED_URL) && !defined(_WIN32) */
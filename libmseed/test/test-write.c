@@ -273,3 +273,51 @@ TEST (write, trace)
   msr->datasamples = NULL;
   msr3_free (&msr);
 }
+
+/* Repack each v2 record of a file to v3, comparing decoded samples */
+static int
+repack_file (const char *path)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  MS3Record *msr3 = NULL;
+  char record[8192];
+  int reclen;
+  int count = 0;
+  int rv;
+
+  while ((rv = ms3_readmsr_r (&msfp, &msr, path, MSF_UNPACKDATA, 0)) == MS_NOERROR)
+  {
+    if ((reclen = msr3_repack_mseed3 (msr, record, sizeof (record), 0)) < 0 ||
+        msr3_parse (record, reclen, &msr3, MSF_UNPACKDATA | MSF_VALIDATECRC, 0) != MS_NOERROR ||
+        msr3->formatversion != 3 ||
+        msr3->numsamples != msr->numsamples ||
+        memcmp (msr3->datasamples, msr->datasamples,
+                msr->numsamples * ms_samplesize (msr->sampletype)))
+    {
+      count = -1;
+      break;
+    }
+
+    count++;
+  }
+
+  ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+  msr3_free (&msr3);
+
+  return count;
+}
+
+TEST (write, repack_mseed3)
+{
+  /* Big endian integers and floats, little endian Steim */
+  CHECK (repack_file ("data/reference-testdata-int16.mseed2") > 0, "Repacked int16 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-int32.mseed2") > 0, "Repacked int32 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-float32.mseed2") > 0, "Repacked float32 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-float64.mseed2") > 0, "Repacked float64 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-steim1.mseed2") > 0, "Repacked Steim1 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-steim2.mseed2") > 0, "Repacked Steim2 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-steim1-LE.mseed2") > 0, "Repacked little endian Steim1 samples do not match");
+  CHECK (repack_file ("data/reference-testdata-steim2-LE.mseed2") > 0, "Repacked little endian Steim2 samples do not match");
+  CHECK (repack_file ("data/testdata-encoding-SRO.mseed2") > 0, "Repacked SRO samples do not match");
+}
@@ -0,0 +1,168 @@
+#include <tau/tau.h>
+#include <libmseed.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(LIBMSEED_ZSTD)
+#include <zstd.h>
+#endif
+
+extern int cmpfiles (char *fileA, char *fileB);
+
+#define ZSTD_TESTFILE "data/testdata-3channel-signal.mseed3"
+#define ZSTD_FILE     "testdata-zstd.mseed3.zst"
+#define ZSTD_SPOOLDIR "testdata-spool"
+
+/* Read all records from path, returning record count or -1 on error */
+static int
+read_records (const char *path)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  int count = 0;
+  int rv;
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_PNAMERANGE, NULL, 0)) == MS_NOERROR)
+    count++;
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  return (rv == MS_ENDOFFILE) ? count : -1;
+}
+
+#if defined(LIBMSEED_ZSTD)
+
+/* Write a zstd-compressed copy of a file as two frames, returning 0 on success */
+static int
+write_zstd (const char *source, const char *destination)
+{
+  char *data = NULL;
+  char *compressed = NULL;
+  size_t bound;
+  size_t split;
+  size_t length;
+  size_t rv;
+  struct stat sb;
+  FILE *fp;
+  int retval = -1;
+
+  if (stat (source, &sb) || (fp = fopen (source, "rb")) == NULL)
+    return -1;
+
+  length = (size_t)sb.st_size;
+  split = length / 3;
+  bound = ZSTD_compressBound (length);
+
+  if ((data = (char *)malloc (length)) != NULL &&
+      (compressed = (char *)malloc (bound)) != NULL &&
+      fread (data, length, 1, fp) == 1)
+  {
+    fclose (fp);
+
+    if ((fp = fopen (destination, "wb")) == NULL)
+    {
+      free (data);
+      free (compressed);
+      return -1;
+    }
+
+    /* Concatenated frames decompress to the concatenated data */
+    rv = ZSTD_compress (compressed, bound, data, split, 3);
+
+    if (!ZSTD_isError (rv) && fwrite (compressed, rv, 1, fp) == 1)
+    {
+      rv = ZSTD_compress (compressed, bound, data + split, length - split, 3);
+
+      if (!ZSTD_isError (rv) && fwrite (compressed, rv, 1, fp) == 1)
+        retval = 0;
+    }
+  }
+
+  if (fclose (fp))
+    retval = -1;
+
+  free (data);
+  free (compressed);
+
+  return retval;
+}
+
+TEST (zstd, read)
+{
+  char spoolfile[1024];
+  char rangepath[100];
+  int filecount;
+  int rv;
+
+  filecount = read_records (ZSTD_TESTFILE);
+  REQUIRE (filecount > 0, "Cannot read records from test file");
+
+  rv = write_zstd (ZSTD_TESTFILE, ZSTD_FILE);
+  REQUIRE (rv == 0, "Cannot write zstd test file");
+
+  /* Read without spooling */
+  rv = read_records (ZSTD_FILE);
+  CHECK (rv == filecount, "Record count from zstd file does not match file");
+
+  /* Read with spooling, spool must match decompressed source */
+  mkdir (ZSTD_SPOOLDIR, 0755);
+  rv = ms3_url_spooldir (ZSTD_SPOOLDIR);
+  REQUIRE (rv == 0, "ms3_url_spooldir() did not return expected 0");
+
+  rv = read_records (ZSTD_FILE);
+  CHECK (rv == filecount, "Record count from spooled zstd file does not match file");
+
+  rv = ms3_url_spoolfile (ZSTD_FILE, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() did not return expected 0");
+  CHECK (cmpfiles (spoolfile, ZSTD_TESTFILE) == 0, "Spool file does not match source");
+
+  /* Byte range from offset of second record in decompressed data */
+  snprintf (rangepath, sizeof (rangepath), "%s@478", ZSTD_FILE);
+  rv = read_records (rangepath);
+  CHECK (rv == filecount - 1, "Record count from zstd file range is not expected");
+
+  rv = ms3_url_spoolfile (rangepath, spoolfile, sizeof (spoolfile));
+  CHECK (rv == 0, "ms3_url_spoolfile() for range did not return expected 0");
+  CHECK (read_records (rangepath) == filecount - 1, "Record count from re-read zstd file range is not expected");
+
+  ms3_url_spooldir (NULL);
+}
+
+TEST (zstd, truncated)
+{
+  struct stat sb;
+  int rv;
+
+  rv = write_zstd (ZSTD_TESTFILE, ZSTD_FILE);
+  REQUIRE (rv == 0, "Cannot write zstd test file");
+  REQUIRE (stat (ZSTD_FILE, &sb) == 0, "Cannot stat zstd test file");
+
+  /* Reading a truncated frame must fail */
+  rv = truncate (ZSTD_FILE, sb.st_size - 10);
+  REQUIRE (rv == 0, "Cannot truncate zstd test file");
+
+  rv = read_records (ZSTD_FILE);
+  CHECK (rv == -1, "Reading truncated zstd file did not fail as expected");
+}
+
+#else
+
+TEST (zstd, unsupported)
+{
+  /* zstd frame magic followed by arbitrary data */
+  const unsigned char zstd[] = {0x28, 0xb5, 0x2f, 0xfd, 0x00, 0x00, 0x00, 0x00};
+  FILE *fp;
+  int rv;
+
+  fp = fopen (ZSTD_FILE, "wb");
+  REQUIRE (fp != NULL, "Cannot write zstd test file");
+  fwrite (zstd, sizeof (zstd), 1, fp);
+  fclose (fp);
+
+  /* Reading zstd-compressed data without library support must fail */
+  rv = read_records (ZSTD_FILE);
+  CHECK (rv == -1, "Reading zstd file did not fail as expected");
+}
+
+#endif /* defined(LIBMSEED_ZSTD) */
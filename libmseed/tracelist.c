@@ -34,6 +34,20 @@ MS3RecordPtr *mstl3_add_recordptr (MS3TraceSeg *seg, const MS3Record *msr, nstim
 static uint32_t lm_lcg_r (uint64_t *state);
 static uint8_t lm_random_height (uint8_t maximum, uint64_t *state);
 
+static int lm_segindex_build (MS3TraceID *id, uint64_t *prngstate);
+static void lm_segindex_free (MS3TraceID *id);
+static void lm_segindex_insert (MS3TraceID *id, MS3TraceSeg *seg, uint64_t *prngstate);
+static void lm_segindex_remove (MS3TraceID *id, MS3TraceSeg *seg);
+static void lm_segindex_extend (MS3TraceID *id, MS3TraceSeg *seg);
+static void lm_segindex_search (MS3TraceID *id, nstime_t starttime, nstime_t endtime,
+                                nstime_t nsperiod, nstime_t nstimetol, nstime_t nnstimetol,
+                                double sampratehz, double sampratetol, int8_t autoheal,
+                                MS3TraceSeg **segbefore, MS3TraceSeg **segafter,
+                                MS3TraceSeg **followseg);
+
+/* Maximum skip list height for the time index of MS3TraceSegs */
+#define MSTRACESEG_INDEX_HEIGHT 16
+
 /* Test if two sample rates are similar using either specified tolerance (if positive) or default tolerance */
 #define IS_SAMPRATE_SIMILAR(SR1, SR2, SRT) ((SRT > 0.0) ? fabs (SR1 - SR2) > SRT : MS_ISRATETOLERABLE (SR1, SR2))
 
@@ -118,6 +132,10 @@ mstl3_free (MS3TraceList **ppmstl, int8_t freeprvtptr)
       if (seg->datasamples)
         libmseed_memory.free (seg->datasamples);
 
+      /* Free time index node if allocated */
+      if (seg->indexnode)
+        libmseed_memory.free (seg->indexnode);
+
       /* Free associated record list and related private pointers */
       if (seg->recordlist)
       {
@@ -148,6 +166,10 @@ mstl3_free (MS3TraceList **ppmstl, int8_t freeprvtptr)
     if (freeprvtptr && id->prvtptr)
       libmseed_memory.free (id->prvtptr);
 
+    /* Free time index head if allocated */
+    if (id->segindex)
+      libmseed_memory.free (id->segindex);
+
     libmseed_memory.free (id);
 
     id = nextid;
@@ -240,6 +262,11 @@ mstl3_findID (MS3TraceList *mstl, const char *sid, uint8_t pubversion, MS3TraceI
  * mstl3_findID() which returns this list of pointers for use here.
  * If this value is NULL mstl3_findID() will be run to find the pointers.
  *
+ * The ::MS3TraceID.sidhandle is set to the handle of an adjacent ID
+ * with the same SID, which only differ by publication version, or
+ * a new handle for an SID not yet in the list.  Comparing handles is
+ * equivalent to comparing SIDs of IDs in the same list.
+ *
  * @param[in] mstl Add ID to this ::MS3TraceList
  * @param[in] id The ::MS3TraceID to add
  * @param[in] prev Pointers to previous entries in expected location, can be NULL
@@ -294,6 +321,14 @@ mstl3_addID (MS3TraceList *mstl, MS3TraceID *id, MS3TraceID **prev)
     prev[level]->next[level] = id;
   }
 
+  /* Intern SID, IDs with the same SID are adjacent in the list */
+  if (prev[0] != &(mstl->traces) && strcmp (prev[0]->sid, id->sid) == 0)
+    id->sidhandle = prev[0]->sidhandle;
+  else if (id->next[0] && strcmp (id->next[0]->sid, id->sid) == 0)
+    id->sidhandle = id->next[0]->sidhandle;
+  else
+    id->sidhandle = mstl->numsids++;
+
   mstl->numtraceids++;
 
   return id;
@@ -345,6 +380,12 @@ mstl3_addID (MS3TraceList *mstl, MS3TraceID *id, MS3TraceID **prev)
  * order of ascending version.  A ::MS3TraceID is always maintained
  * with ::MS3TraceSeg entries in data time time order.
  *
+ * When a record does not fit at either end of an ::MS3TraceID's
+ * coverage, the matching segments are found using a time index of
+ * the segments that is built when first needed and maintained as
+ * data is added.  The segment times should not be modified by the
+ * caller between additions to a list, except by mstl3_pack().
+ *
  * @param[in] mstl Destination ::MS3TraceList to add data to
  * @param[in] msr ::MS3Record containing the data to add to list
  * @param[in] pprecptr Pointer to pointer to a ::MS3RecordPtr for @ref record-list
@@ -387,6 +428,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
   double sampratehz;
   double sampratetol = -1.0;
 
+  int8_t moved = 0;
+
   if (!mstl || !msr)
   {
     ms_log (2, "%s(): Required input not defined: 'mstl' or 'msr'\n", __func__);
@@ -508,6 +551,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
       id->last = seg;
       id->numsegments++;
 
+      lm_segindex_insert (id, seg, &mstl->prngstate);
+
       if (endtime > id->latest)
         id->latest = endtime;
 
@@ -527,6 +572,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
       id->first = seg;
       id->numsegments++;
 
+      lm_segindex_insert (id, seg, &mstl->prngstate);
+
       if (msr->starttime < id->earliest)
         id->earliest = msr->starttime;
 
@@ -553,56 +600,67 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
     /* Search complete segment list for matches */
     else
     {
-      /* This search finds the following values if they exist: */
-      segbefore = NULL; /* The first segment end that matches the record start (within tolerance) */
-      segafter  = NULL; /* The first segment start that matches the record end (within tolerance) */
-      followseg = NULL; /* The segment with latest start time before the record start */
-      searchseg = id->first;
-      while (searchseg)
+      /* Search the time index of segments, building it if needed */
+      if (id->segindex || lm_segindex_build (id, &mstl->prngstate) == 0)
+      {
+        lm_segindex_search (id, msr->starttime, endtime, nsperiod, nstimetol, nnstimetol,
+                            sampratehz, sampratetol, autoheal,
+                            &segbefore, &segafter, &followseg);
+      }
+      /* Otherwise search the complete segment list */
+      else
       {
-        /* Done searching if autohealing and record exactly matches a segment.
-         *
-         * Rationale: autohealing would have combined this segment
-         * with another if that were possible, so this record will
-         * also not fit with any other segment. */
-        if (autoheal &&
-            msr->starttime == searchseg->starttime &&
-            endtime == searchseg->endtime)
+        /* This search finds the following values if they exist: */
+        segbefore = NULL; /* The first segment end that matches the record start (within tolerance) */
+        segafter  = NULL; /* The first segment start that matches the record end (within tolerance) */
+        followseg = NULL; /* The segment with latest start time before the record start */
+        searchseg = id->first;
+        while (searchseg)
         {
-          followseg = searchseg;
-          break;
-        }
+          /* Done searching if autohealing and record exactly matches a segment.
+           *
+           * Rationale: autohealing would have combined this segment
+           * with another if that were possible, so this record will
+           * also not fit with any other segment. */
+          if (autoheal &&
+              msr->starttime == searchseg->starttime &&
+              endtime == searchseg->endtime)
+          {
+            followseg = searchseg;
+            break;
+          }
 
-        if (msr->starttime > searchseg->starttime)
-          followseg = searchseg;
+          if (msr->starttime > searchseg->starttime)
+            followseg = searchseg;
 
-        if (!segbefore)
-        {
-          postgap = msr->starttime - searchseg->endtime - nsperiod;
+          if (!segbefore)
+          {
+            postgap = msr->starttime - searchseg->endtime - nsperiod;
 
-          if (postgap <= nstimetol && postgap >= nnstimetol &&
-              IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
-            segbefore = searchseg;
-        }
+            if (postgap <= nstimetol && postgap >= nnstimetol &&
+                IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
+              segbefore = searchseg;
+          }
 
-        if (!segafter)
-        {
-          pregap = searchseg->starttime - endtime - nsperiod;
+          if (!segafter)
+          {
+            pregap = searchseg->starttime - endtime - nsperiod;
 
-          if (pregap <= nstimetol && pregap >= nnstimetol &&
-              IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
-            segafter = searchseg;
-        }
+            if (pregap <= nstimetol && pregap >= nnstimetol &&
+                IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
+              segafter = searchseg;
+          }
 
-        /* Done searching if both before and after segments are found */
-        if (segbefore && segafter)
-          break;
-        /* Done searching if not autohealing and one match found */
-        else if (!autoheal && (segbefore || segafter))
-          break;
+          /* Done searching if both before and after segments are found */
+          if (segbefore && segafter)
+            break;
+          /* Done searching if not autohealing and one match found */
+          else if (!autoheal && (segbefore || segafter))
+            break;
 
-        searchseg = searchseg->next;
-      } /* Done looping through segments */
+          searchseg = searchseg->next;
+        } /* Done looping through segments */
+      }
 
       /* Add MS3Record coverage to end of segment before */
       if (segbefore)
@@ -627,6 +685,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
             return NULL;
           }
 
+          lm_segindex_remove (id, segafter);
+
           /* Shift last segment pointer if it's going to be removed */
           if (segafter == id->last)
             id->last = id->last->prev;
@@ -652,6 +712,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
           id->numsegments -= 1;
         }
 
+        lm_segindex_extend (id, segbefore);
+
         seg = segbefore;
       }
       /* Add MS3Record coverage to beginning of segment after */
@@ -708,6 +770,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
         }
 
         id->numsegments++;
+
+        lm_segindex_insert (id, seg, &mstl->prngstate);
       }
     } /* End of searching segment list */
 
@@ -728,6 +792,13 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
          (seg->starttime > seg->next->starttime ||
           (seg->starttime == seg->next->starttime && seg->endtime < seg->next->endtime)))
   {
+    /* Remove segment from time index while moving, re-inserted when in place */
+    if (!moved)
+    {
+      lm_segindex_remove (id, seg);
+      moved = 1;
+    }
+
     /* Move segment down list, swap seg and seg->next */
     segafter = seg->next;
 
@@ -752,6 +823,12 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
   while (seg->prev && (seg->starttime < seg->prev->starttime ||
                        (seg->starttime == seg->prev->starttime && seg->endtime > seg->prev->endtime)))
   {
+    if (!moved)
+    {
+      lm_segindex_remove (id, seg);
+      moved = 1;
+    }
+
     /* Move segment up list, swap seg and seg->prev */
     segbefore = seg->prev;
 
@@ -774,6 +851,9 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
       id->last = segbefore;
   }
 
+  if (moved)
+    lm_segindex_insert (id, seg, &mstl->prngstate);
+
   return seg;
 } /* End of mstl3_addmsr_recordptr() */
 
@@ -2035,6 +2115,9 @@ mstl3_pack (MS3TraceList *mstl, void (*record_handler) (char *, int, void *),
       /* If MSF_MAINTAINMSTL not set, adjust segment start time and reduce data array and sample counts */
       if (!(flags & MSF_MAINTAINMSTL) && segpackedsamples > 0)
       {
+        /* Segment start times are changed, the time index is rebuilt when next needed */
+        lm_segindex_free (id);
+
         /* Calculate new start time, shortcut when all samples have been packed */
         if (segpackedsamples == seg->numsamples)
           seg->starttime = seg->endtime;
@@ -2455,3 +2538,466 @@ lm_random_height (uint8_t maximum, uint64_t *state)
 
   return height;
 }
+
+/* Time index of trace segments.
+ *
+ * The index is a skip list with the segment list itself as level 0,
+ * which is sorted by start time (ascending) and end time (descending).
+ * Segments with a height above 1 have a node with links at the higher
+ * levels, the head node is at MS3TraceID.segindex.  Each link holds
+ * the latest end time of the segments it skips over, through and
+ * including the linked segment, to find segments by end time.
+ *
+ * The end time of links to the last segment is not maintained as
+ * coverage is appended to that segment without updating the index,
+ * searches always descend through such links.
+ */
+typedef struct LMSegLevel
+{
+  MS3TraceSeg *next;
+  MS3TraceSeg *prev;
+  nstime_t maxend;
+} LMSegLevel;
+
+typedef struct LMSegNode
+{
+  uint8_t height;
+  LMSegLevel level[]; /* Levels 1 through height - 1 */
+} LMSegNode;
+
+/* Return index node for a segment or the index head for NULL */
+#define LM_SEGNODE(ID, SEG) ((LMSegNode *)((SEG) ? (SEG)->indexnode : (ID)->segindex))
+
+static inline uint8_t
+lm_segheight (const MS3TraceID *id, const MS3TraceSeg *seg)
+{
+  LMSegNode *node = LM_SEGNODE (id, seg);
+
+  return (node) ? node->height : 1;
+}
+
+/* Return link at level (>= 1) for a segment or the index head for NULL */
+static inline LMSegLevel *
+lm_seglink (const MS3TraceID *id, const MS3TraceSeg *seg, int level)
+{
+  return &LM_SEGNODE (id, seg)->level[level - 1];
+}
+
+static inline MS3TraceSeg *
+lm_segnext (const MS3TraceID *id, const MS3TraceSeg *seg, int level)
+{
+  if (level == 0)
+    return (seg) ? seg->next : id->first;
+
+  return lm_seglink (id, seg, level)->next;
+}
+
+/* Find the last segment before seg at each index level, NULL for the head */
+static void
+lm_segindex_pred (const MS3TraceID *id, const MS3TraceSeg *seg, MS3TraceSeg **pred)
+{
+  MS3TraceSeg *node = seg->prev;
+  int level;
+
+  pred[0] = node;
+  for (level = 1; level < MSTRACESEG_INDEX_HEIGHT; level++)
+  {
+    while (node && lm_segheight (id, node) <= level)
+      node = (level == 1) ? node->prev : lm_seglink (id, node, level - 1)->prev;
+
+    pred[level] = node;
+  }
+}
+
+/* Set the latest end time of a link from the links at the level below */
+static void
+lm_segindex_span (const MS3TraceID *id, MS3TraceSeg *seg, int level)
+{
+  LMSegLevel *link = lm_seglink (id, seg, level);
+  MS3TraceSeg *node = seg;
+  MS3TraceSeg *next;
+  nstime_t maxend = NSTERROR;
+  nstime_t end;
+
+  /* Links to the end of the list are never skipped */
+  if (!link->next)
+    return;
+
+  do
+  {
+    next = lm_segnext (id, node, level - 1);
+    end = (level == 1) ? next->endtime : lm_seglink (id, node, level - 1)->maxend;
+
+    if (end > maxend)
+      maxend = end;
+
+    node = next;
+  } while (node != link->next);
+
+  link->maxend = maxend;
+}
+
+/* Build time index for the segments of an ID.
+ *
+ * Returns 0 on success and -1 if the segment list is not sorted or
+ * memory cannot be allocated, in which case no index is available.
+ */
+static int
+lm_segindex_build (MS3TraceID *id, uint64_t *prngstate)
+{
+  MS3TraceSeg *tail[MSTRACESEG_INDEX_HEIGHT] = {NULL};
+  MS3TraceSeg *seg;
+  LMSegNode *node;
+  uint8_t height;
+  int level;
+
+  /* An index requires the segment list be sorted */
+  for (seg = id->first; seg && seg->next; seg = seg->next)
+  {
+    if (seg->starttime > seg->next->starttime ||
+        (seg->starttime == seg->next->starttime && seg->endtime < seg->next->endtime))
+      return -1;
+  }
+
+  if (!(node = (LMSegNode *)libmseed_memory.malloc (sizeof (LMSegNode) +
+                                                     (MSTRACESEG_INDEX_HEIGHT - 1) * sizeof (LMSegLevel))))
+    return -1;
+
+  memset (node, 0, sizeof (LMSegNode) + (MSTRACESEG_INDEX_HEIGHT - 1) * sizeof (LMSegLevel));
+  node->height = MSTRACESEG_INDEX_HEIGHT;
+  id->segindex = node;
+
+  /* Link segments at their random heights */
+  for (seg = id->first; seg; seg = seg->next)
+  {
+    height = lm_random_height (MSTRACESEG_INDEX_HEIGHT, prngstate);
+
+    if (height == 1)
+      continue;
+
+    if (!(node = (LMSegNode *)libmseed_memory.malloc (sizeof (LMSegNode) +
+                                                       (height - 1) * sizeof (LMSegLevel))))
+    {
+      lm_segindex_free (id);
+      return -1;
+    }
+
+    node->height = height;
+    seg->indexnode = node;
+
+    for (level = 1; level < height; level++)
+    {
+      lm_seglink (id, seg, level)->next = NULL;
+      lm_seglink (id, seg, level)->prev = tail[level];
+      lm_seglink (id, tail[level], level)->next = seg;
+      tail[level] = seg;
+    }
+  }
+
+  /* Set link end times, bottom level first */
+  for (level = 1; level < MSTRACESEG_INDEX_HEIGHT; level++)
+  {
+    seg = NULL;
+    do
+    {
+      lm_segindex_span (id, seg, level);
+    } while ((seg = lm_segnext (id, seg, level)));
+  }
+
+  return 0;
+}
+
+/* Free time index for the segments of an ID */
+static void
+lm_segindex_free (MS3TraceID *id)
+{
+  MS3TraceSeg *seg;
+  MS3TraceSeg *next;
+
+  if (!id->segindex)
+    return;
+
+  /* All segments with index nodes are linked at level 1 */
+  for (seg = lm_segnext (id, NULL, 1); seg; seg = next)
+  {
+    next = lm_segnext (id, seg, 1);
+
+    libmseed_memory.free (seg->indexnode);
+    seg->indexnode = NULL;
+  }
+
+  libmseed_memory.free (id->segindex);
+  id->segindex = NULL;
+}
+
+/* Insert a segment into the time index at its position in the segment list.
+ *
+ * If memory cannot be allocated the index is freed, to be rebuilt
+ * when next needed.
+ */
+static void
+lm_segindex_insert (MS3TraceID *id, MS3TraceSeg *seg, uint64_t *prngstate)
+{
+  MS3TraceSeg *pred[MSTRACESEG_INDEX_HEIGHT];
+  LMSegLevel *link;
+  LMSegNode *node;
+  uint8_t height;
+  int level;
+
+  if (!id->segindex)
+    return;
+
+  height = lm_random_height (MSTRACESEG_INDEX_HEIGHT, prngstate);
+
+  if (height > 1)
+  {
+    if (!(node = (LMSegNode *)libmseed_memory.malloc (sizeof (LMSegNode) +
+                                                       (height - 1) * sizeof (LMSegLevel))))
+    {
+      lm_segindex_free (id);
+      return;
+    }
+
+    node->height = height;
+    seg->indexnode = node;
+  }
+
+  lm_segindex_pred (id, seg, pred);
+
+  for (level = 1; level < MSTRACESEG_INDEX_HEIGHT; level++)
+  {
+    link = lm_seglink (id, pred[level], level);
+
+    if (level < height)
+    {
+      lm_seglink (id, seg, level)->next = link->next;
+      lm_seglink (id, seg, level)->prev = pred[level];
+
+      if (link->next)
+        lm_seglink (id, link->next, level)->prev = seg;
+
+      link->next = seg;
+
+      lm_segindex_span (id, seg, level);
+      lm_segindex_span (id, pred[level], level);
+    }
+    else if (seg->endtime > link->maxend)
+    {
+      link->maxend = seg->endtime;
+    }
+  }
+
+  /* A replaced last segment was extended without updating the index */
+  if (seg == id->last && seg->prev)
+    lm_segindex_extend (id, seg->prev);
+}
+
+/* Remove a segment from the time index, the segment list is not changed */
+static void
+lm_segindex_remove (MS3TraceID *id, MS3TraceSeg *seg)
+{
+  MS3TraceSeg *pred[MSTRACESEG_INDEX_HEIGHT];
+  LMSegLevel *link;
+  LMSegLevel *seglink;
+  int level;
+
+  if (!id->segindex || !seg->indexnode)
+    return;
+
+  lm_segindex_pred (id, seg, pred);
+
+  for (level = 1; level < lm_segheight (id, seg); level++)
+  {
+    link    = lm_seglink (id, pred[level], level);
+    seglink = lm_seglink (id, seg, level);
+
+    link->next = seglink->next;
+
+    if (seglink->next)
+      lm_seglink (id, seglink->next, level)->prev = pred[level];
+
+    if (seglink->maxend > link->maxend)
+      link->maxend = seglink->maxend;
+  }
+
+  libmseed_memory.free (seg->indexnode);
+  seg->indexnode = NULL;
+}
+
+/* Update time index for a segment end time that has increased */
+static void
+lm_segindex_extend (MS3TraceID *id, MS3TraceSeg *seg)
+{
+  MS3TraceSeg *pred[MSTRACESEG_INDEX_HEIGHT];
+  LMSegLevel *link;
+  int level;
+
+  if (!id->segindex)
+    return;
+
+  lm_segindex_pred (id, seg, pred);
+
+  for (level = 1; level < MSTRACESEG_INDEX_HEIGHT; level++)
+  {
+    link = lm_seglink (id, pred[level], level);
+
+    if (seg->endtime > link->maxend)
+      link->maxend = seg->endtime;
+  }
+}
+
+/* Find the last segment with a start time before time, NULL if none */
+static MS3TraceSeg *
+lm_segindex_startbefore (const MS3TraceID *id, nstime_t time)
+{
+  MS3TraceSeg *seg = NULL;
+  MS3TraceSeg *next;
+  int level;
+
+  for (level = MSTRACESEG_INDEX_HEIGHT - 1; level >= 0; level--)
+  {
+    while ((next = lm_segnext (id, seg, level)) && next->starttime < time)
+      seg = next;
+  }
+
+  return seg;
+}
+
+/* Find the first segment after seg (NULL for the head) with an end
+ * time at or after time, NULL if none */
+static MS3TraceSeg *
+lm_segindex_nextend (const MS3TraceID *id, MS3TraceSeg *seg, nstime_t time)
+{
+  MS3TraceSeg *next;
+  int level;
+
+  for (level = lm_segheight (id, seg) - 1; level >= 0; level--)
+  {
+    if (!(next = lm_segnext (id, seg, level)))
+      continue;
+
+    if (level == 0)
+    {
+      if (next->endtime >= time)
+        return next;
+    }
+    else if (next == id->last || lm_seglink (id, seg, level)->maxend >= time)
+    {
+      continue;
+    }
+
+    /* Skip over segments ending before time, continue from top of next segment */
+    seg   = next;
+    level = lm_segheight (id, seg);
+  }
+
+  return NULL;
+}
+
+/* Return true if segment a is before segment b in the segment list */
+static int
+lm_segprecedes (const MS3TraceSeg *a, const MS3TraceSeg *b)
+{
+  if (a->starttime != b->starttime)
+    return (a->starttime < b->starttime);
+
+  if (a->endtime != b->endtime)
+    return (a->endtime > b->endtime);
+
+  /* Identical coverage, search following segments */
+  for (a = a->next; a && a->starttime == b->starttime && a->endtime == b->endtime; a = a->next)
+  {
+    if (a == b)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Search time index for segments matching record coverage.
+ *
+ * The results are the same as searching the segment list from the
+ * beginning, see mstl3_addmsr_recordptr():
+ * segbefore - the first segment end that matches the record start
+ * segafter  - the first segment start that matches the record end
+ * followseg - the segment with latest start time before the record start
+ *
+ * When autohealing, a segment that exactly matches the record ends the
+ * search in list order and is returned as followseg.  When not
+ * autohealing, only the first matching segment is returned.
+ */
+static void
+lm_segindex_search (MS3TraceID *id, nstime_t starttime, nstime_t endtime,
+                    nstime_t nsperiod, nstime_t nstimetol, nstime_t nnstimetol,
+                    double sampratehz, double sampratetol, int8_t autoheal,
+                    MS3TraceSeg **segbefore, MS3TraceSeg **segafter,
+                    MS3TraceSeg **followseg)
+{
+  MS3TraceSeg *before = NULL;
+  MS3TraceSeg *after  = NULL;
+  MS3TraceSeg *exact  = NULL;
+  MS3TraceSeg *seg;
+
+  *followseg = lm_segindex_startbefore (id, starttime);
+
+  /* Segment end time within tolerance of record start, as segments start
+   * before they end the search is done at later segment start times */
+  seg = lm_segindex_nextend (id, NULL, starttime - nsperiod - nstimetol);
+  while (seg && seg->starttime <= starttime - nsperiod - nnstimetol)
+  {
+    if (seg->endtime <= starttime - nsperiod - nnstimetol &&
+        IS_SAMPRATE_SIMILAR (sampratehz, seg->samprate, sampratetol))
+    {
+      before = seg;
+      break;
+    }
+
+    seg = lm_segindex_nextend (id, seg, starttime - nsperiod - nstimetol);
+  }
+
+  /* Segment start time within tolerance of record end */
+  seg = lm_segnext (id, lm_segindex_startbefore (id, endtime + nsperiod + nnstimetol), 0);
+  for (; seg && seg->starttime <= endtime + nsperiod + nstimetol; seg = seg->next)
+  {
+    if (IS_SAMPRATE_SIMILAR (sampratehz, seg->samprate, sampratetol))
+    {
+      after = seg;
+      break;
+    }
+  }
+
+  /* Segment with exactly the record coverage, end times descend for equal start times */
+  if (autoheal)
+  {
+    seg = lm_segnext (id, *followseg, 0);
+    for (; seg && seg->starttime == starttime && seg->endtime >= endtime; seg = seg->next)
+    {
+      if (seg->endtime == endtime)
+      {
+        exact = seg;
+        break;
+      }
+    }
+  }
+
+  /* Search in list order ends at an exact match unless both matches are before it */
+  if (exact && (!before || !after || !lm_segprecedes (before, exact) || !lm_segprecedes (after, exact)))
+  {
+    *segbefore = (before && lm_segprecedes (before, exact)) ? before : NULL;
+    *segafter  = (after && lm_segprecedes (after, exact)) ? after : NULL;
+    *followseg = exact;
+    return;
+  }
+
+  /* Search in list order ends at first match when not autohealing */
+  if (!autoheal && before && after && before != after)
+  {
+    if (lm_segprecedes (before, after))
+      after = NULL;
+    else
+      before = NULL;
+  }
+
+  *segbefore = before;
+  *segafter  = after;
+}
@@ -1501,6 +1501,157 @@ ms2_recordsid (const char *record, char *sid, int sidlen)
   return sid;
 } /* End of ms2_recordsid() */
 
+/***************************************************************************
+ * ms3_recordselectfields:
+ *
+ * Extract the fields used for record selection: source identifier,
+ * start and end times and publication version, from a raw miniSEED
+ * record at the start of a buffer without unpacking it.  The values
+ * are derived as in msr3_unpack_mseed3() and msr3_unpack_mseed2(),
+ * for format version 2 the blockette chain is only traversed for the
+ * sample rate (100), start time adjustment (1001) and record length
+ * (1000).
+ *
+ * Returns the record length on success and -1 if the record is not
+ * complete in the buffer or the fields cannot be determined without
+ * a complete parse, e.g. no blockette 1000 or a damaged blockette
+ * chain.
+ ***************************************************************************/
+int64_t
+ms3_recordselectfields (const char *record, uint64_t recbuflen,
+                        char *sid, int sidlen, nstime_t *starttime,
+                        nstime_t *endtime, uint8_t *pubversion)
+{
+  uint8_t swapflag;
+  uint8_t sidlength;
+  uint16_t blkt_offset;
+  uint16_t blkt_length;
+  uint16_t blkt_type;
+  uint16_t next_blkt;
+  uint16_t blkt_end = 0;
+  int B1001offset = 0;
+  int64_t reclen = -1;
+  int64_t samplecnt;
+  double samprate;
+  char quality;
+
+  if (!record || !sid || !starttime || !endtime || !pubversion || recbuflen < MINRECLEN)
+    return -1;
+
+  if (MS3_ISVALIDHEADER (record))
+  {
+    /* miniSEED 3 is little endian */
+    swapflag = (ms_bigendianhost ()) ? 1 : 0;
+
+    sidlength = *pMS3FSDH_SIDLENGTH (record);
+
+    reclen = MS3FSDH_LENGTH + sidlength
+             + HO2u (*pMS3FSDH_EXTRALENGTH (record), swapflag)
+             + HO4u (*pMS3FSDH_DATALENGTH (record), swapflag);
+
+    if ((uint64_t)reclen > recbuflen || sidlength >= sidlen)
+      return -1;
+
+    memcpy (sid, pMS3FSDH_SID (record), sidlength);
+    sid[sidlength] = '\0';
+
+    *starttime = ms_time2nstime (HO2u (*pMS3FSDH_YEAR (record), swapflag),
+                                 HO2u (*pMS3FSDH_DAY (record), swapflag),
+                                 *pMS3FSDH_HOUR (record),
+                                 *pMS3FSDH_MIN (record),
+                                 *pMS3FSDH_SEC (record),
+                                 HO4u (*pMS3FSDH_NSEC (record), swapflag));
+
+    samprate    = HO8f (*pMS3FSDH_SAMPLERATE (record), swapflag);
+    samplecnt   = HO4u (*pMS3FSDH_NUMSAMPLES (record), swapflag);
+    *pubversion = *pMS3FSDH_PUBVERSION (record);
+  }
+  else if (MS2_ISVALIDHEADER (record))
+  {
+    if (recbuflen < 64)
+      return -1;
+
+    swapflag = (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (record), *pMS2FSDH_DAY (record))) ? 1 : 0;
+
+    /* Traverse the blockettes for record length, sample rate and time
+     * adjustment, any irregularity is left to the complete parse */
+    samprate = ms_nomsamprate (HO2d (*pMS2FSDH_SAMPLERATEFACT (record), swapflag),
+                               HO2d (*pMS2FSDH_SAMPLERATEMULT (record), swapflag));
+
+    blkt_offset = HO2u (*pMS2FSDH_BLOCKETTEOFFSET (record), swapflag);
+
+    while (blkt_offset != 0)
+    {
+      if (blkt_offset < 48 || (uint64_t)blkt_offset + 4 > recbuflen)
+        return -1;
+
+      memcpy (&blkt_type, record + blkt_offset, 2);
+      memcpy (&next_blkt, record + blkt_offset + 2, 2);
+
+      if (swapflag)
+      {
+        ms_gswap2 (&blkt_type);
+        ms_gswap2 (&next_blkt);
+      }
+
+      blkt_length = ms2_blktlen (blkt_type, record + blkt_offset, swapflag);
+
+      if (blkt_length == 0 || (uint64_t)blkt_offset + blkt_length > recbuflen)
+        return -1;
+
+      blkt_end = blkt_offset + blkt_length;
+
+      if (blkt_type == 100)
+        samprate = HO4f (*pMS2B100_SAMPRATE (record + blkt_offset), swapflag);
+      else if (blkt_type == 1000 && *pMS2B1000_RECLEN (record + blkt_offset) < 32)
+        reclen = (int64_t)1 << *pMS2B1000_RECLEN (record + blkt_offset);
+      else if (blkt_type == 1001)
+        B1001offset = blkt_offset;
+
+      if (next_blkt && next_blkt < blkt_end)
+        return -1;
+
+      blkt_offset = next_blkt;
+    }
+
+    if (reclen < 64 || reclen > MAXRECLEN || (uint64_t)reclen > recbuflen || blkt_end > reclen)
+      return -1;
+
+    if (!ms2_recordsid (record, sid, sidlen))
+      return -1;
+
+    samplecnt = HO2u (*pMS2FSDH_NUMSAMPLES (record), swapflag);
+
+    quality     = *pMS2FSDH_DATAQUALITY (record);
+    *pubversion = (quality == 'M') ? 4 : (quality == 'Q') ? 3 : (quality == 'D') ? 2 : (quality == 'R') ? 1 : 0;
+
+    *starttime = ms_btime2nstime ((uint8_t *)pMS2FSDH_YEAR (record), swapflag);
+
+    if (*starttime == NSTERROR)
+      return -1;
+
+    if (HO4d (*pMS2FSDH_TIMECORRECT (record), swapflag) != 0 &&
+        !(*pMS2FSDH_ACTFLAGS (record) & 0x02))
+    {
+      *starttime += (nstime_t)HO4d (*pMS2FSDH_TIMECORRECT (record), swapflag) * (NSTMODULUS / 10000);
+    }
+
+    if (B1001offset)
+      *starttime += (nstime_t)*pMS2B1001_MICROSECOND (record + B1001offset) * (NSTMODULUS / 1000000);
+  }
+  else
+  {
+    return -1;
+  }
+
+  if (reclen < MINRECLEN || reclen > MAXRECLEN || *starttime == NSTERROR)
+    return -1;
+
+  *endtime = ms_sampletime (*starttime, (samplecnt > 0) ? samplecnt - 1 : 0, samprate);
+
+  return reclen;
+} /* End of ms3_recordselectfields() */
+
 /***************************************************************************
  * ms2_blktdesc():
  *
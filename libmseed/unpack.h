@@ -34,6 +34,9 @@ extern int64_t msr3_unpack_mseed2 (const char *record, int reclen, MS3Record **p
 
 extern double ms_nomsamprate (int factor, int multiplier);
 extern char *ms2_recordsid (const char *record, char *sid, int sidlen);
+extern int64_t ms3_recordselectfields (const char *record, uint64_t recbuflen,
+                                       char *sid, int sidlen, nstime_t *starttime,
+                                       nstime_t *endtime, uint8_t *pubversion);
 extern const char *ms2_blktdesc (uint16_t blkttype);
 uint16_t ms2_blktlen (uint16_t blkttype, const char *blkt, int8_t swapflag);
 
@@ -66,17 +66,28 @@
  * unpacking, sample removal and repacking.  After trimming or if no
  * trimming is required the data record is written to the appropriate
  * output file. In this way only the minimal number of records needing
- * modification (trimming) are repacked.
+ * modification (trimming) are repacked.  When writing a single output
+ * file with multiple threads the offset of every record in the output
+ * is planned first and the records are written in parallel, see
+ * writeplanned().
  *
  ***************************************************************************/
 
 /* _ISOC9X_SOURCE needed to get a declaration for llabs on some archs */
 #define _ISOC9X_SOURCE
 
+/* _GNU_SOURCE needed to get a declaration for copy_file_range on Linux */
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #define __STDC_FORMAT_MACROS
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -84,6 +95,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <libmseed.h>
 #include <mseedformat.h>
@@ -93,12 +105,41 @@
 #define VERSION "4.0.1"
 #define PACKAGE "dataselect"
 
+/* Size of concurrent range requests when prefetching large URL objects */
+#define PREFETCHSPLITSIZE 33554432
+
+/* Input file types determined from content by probefile() */
+#define INPUT_PLAIN      0
+#define INPUT_COMPRESSED 1
+#define INPUT_TARBUNDLE  2
+
+/* Size of tar header blocks */
+#define TARBLOCKSIZE 512
+
+/* Maximum number of records read in a batch when writing output */
+#define READBATCHRECORDS 256
+
+/* Length of time strings formatted in bulk, enough for any format */
+#define TIMESTRLEN 40
+
+/* Number of records claimed at a time by threads writing planned output */
+#define PLANCHUNKRECORDS 64
+
+/* Size of buffers used by threads to copy records to planned output */
+#define PLANBUFFERSIZE 1048576
+
+/* Capacity of log ring used while writing planned output with threads */
+#define LOGRINGSIZE 1024
+
 /* Input/output file selection information containers */
 typedef struct Filelink_s
 {
   char *infilename_raw;   /* Input file name with potential annotation (byte range) */
   char *infilename;       /* Input file name without annotation (byte range) */
+  int8_t isurl;           /* Flag indicating input is a URL, re-read from spool */
+  int8_t iscompressed;    /* Flag indicating input is compressed, re-read from spool */
   FILE *infp;             /* Input file descriptor */
+  struct Filelink_s *bundle; /* First member of tar bundle, owner of shared infp */
   struct Filelink_s *next;
 } Filelink;
 
@@ -116,6 +157,22 @@ typedef struct TimeRange_s
   nstime_t endtime;
 } TimeRange;
 
+/* Columnar table of record times used for pruning, in trace list order with
+ * the records of each segment contiguous.  The TimeRange of a record at
+ * MS3RecordPtr.prvtptr is the entry at the same index. */
+typedef struct RecordTable_s
+{
+  uint64_t count;
+  TimeRange *timeranges; /* New record limits, NSTUNSET if not set */
+  nstime_t *effstart;    /* Effective start times, new limit or record start */
+  nstime_t *effend;      /* Effective end times, new limit or record end */
+  uint8_t *removed;      /* Non-zero if record is marked non-contributing */
+  uint8_t *breaks;       /* Scratch flags for breaks in coverage */
+} RecordTable;
+
+/* Index of a record in the record table */
+#define RECINDEX(recptr) ((uint64_t)((TimeRange *)(recptr)->prvtptr - rectable.timeranges))
+
 /* Container for coverage entries used to prune data */
 typedef struct Coverage_s
 {
@@ -126,33 +183,108 @@ typedef struct Coverage_s
   struct Coverage_s *next;
 } Coverage;
 
+/* Output record of a single output file written at planned offsets */
+typedef struct OutputRecord_s
+{
+  MS3RecordPtr *recptr;
+  Filelink *flp;
+  int64_t offset;  /* Byte offset in output file */
+  int64_t length;  /* Length in output file, 0 if not written */
+  char *buffer;    /* Repacked record(s) when repacking, otherwise NULL */
+  int8_t repack;   /* Non-zero if the record is trimmed and repacked */
+} OutputRecord;
+
+/* Output plan shared by threads writing a single output file */
+typedef struct OutputPlan_s
+{
+  OutputRecord *records;
+  uint64_t count;
+  uint64_t next;        /* Next record to be claimed by a thread */
+  size_t buffersize;    /* Size of buffers for copying records */
+  uint32_t *crcs;       /* CRC32C of each chunk of records written, for the digest */
+  int fd;               /* Output file descriptor */
+  int8_t errflag;       /* Set by any thread on error */
+  pthread_mutex_t lock; /* Lock for next and errflag */
+  pthread_t mainthread; /* Thread printing logged messages */
+} OutputPlan;
+
 /* Holder for data passed to the record writer */
 typedef struct WriterData_s
 {
   FILE *ofp;
   MS3RecordPtr *recptr;
   Filelink *flp;
+  OutputRecord *output; /* Planned output record to collect repacked record(s) */
   int8_t *errflagp;
 } WriterData;
 
+/* Segment of contiguous output records for the written summary */
+typedef struct WrittenSeg_s
+{
+  nstime_t starttime;
+  nstime_t endtime;
+  double samprate;
+  int64_t samplecnt;
+  int64_t bytecount;
+} WrittenSeg;
+
+/* Time-ordered segments of output records for a source ID */
+typedef struct WrittenID_s
+{
+  char sid[LM_SIDLEN];
+  uint8_t pubversion;
+  nstime_t earliest;
+  nstime_t latest;
+  WrittenSeg *segs;
+  uint32_t numsegments;
+  uint32_t maxsegments;
+} WrittenID;
+
+/* Record sort key, effective start time ordered as unsigned integer */
+typedef struct SortKey_s
+{
+  uint64_t key;
+  MS3RecordPtr *recptr;
+} SortKey;
+
+static int initrecordtable (MS3TraceList *mstl);
 static int setselectionlimits (MS3TraceList *mstl);
 
 static int writetraces (MS3TraceList *mstl);
 static int trimrecord (MS3RecordPtr *rec, char *recbuf, WriterData *writerdata);
 static void writerecord (char *record, int reclen, void *handlerdata);
+static int setrecordpubver (char *record, int reclen);
+static int writeplanned (MS3TraceList *mstl, uint64_t *recsout, uint64_t *bytesout);
+static int runplanthreads (void *(*routine) (void *), OutputPlan *plan);
+static void *trimplanned (void *arg);
+static void *fillplanned (void *arg);
+static int claimplanned (OutputPlan *plan, uint64_t *first, uint64_t *end);
+static void failplanned (OutputPlan *plan);
+static int copyrange (int infd, int64_t inoffset, int outfd, int64_t outoffset,
+                      int64_t length, char *buffer, size_t buffersize);
+static int readrange (int fd, char *buffer, size_t length, int64_t offset);
+static int pwritefull (int fd, const char *buffer, size_t length, int64_t offset);
+static int convertrecord (MS3Record *msr, char *record);
+static void setsequence (MS3Record *msr, const char *record);
+static int validcrc (char *record, int reclen);
 
 static int prunetraces (MS3TraceList *mstl);
-static int findcoverage (MS3TraceList *mstl, MS3TraceID *targetid,
+static int findcoverage (MS3TraceID *groupid, MS3TraceID *targetid,
                          MS3TraceSeg *targetseg, Coverage **ppcoverage);
+static int addcoverage (uint64_t first, uint64_t count, uint8_t pubversion, double samprate,
+                        nstime_t nsperiod, nstime_t nstimetol,
+                        Coverage **pcoverage, Coverage **ppcoverage);
 static int trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid,
                       Coverage *coverage);
 static int reconcile_tracetimes (MS3TraceList *mstl);
 
 static void printtracelist (MS3TraceList *mstl, uint8_t details);
-static void printwritten (MS3TraceList *mstl);
+static int addwritten (MS3Record *msr, int reclen);
+static void printwritten (void);
+static void printmanifest (void);
 
 static int sortrecordlist (MS3RecordList *reclist);
-static int recordcmp (MS3RecordPtr *rec1, MS3RecordPtr *rec2);
+static size_t mergeruns (SortKey *keys, SortKey *temp, size_t count);
 
 static int processparam (int argcount, char **argvec);
 static char *getoptval (int argcount, char **argvec, int argopt);
@@ -160,15 +292,29 @@ static int setofilelimit (int limit);
 static int addfile (char *filename);
 static int addlistfile (char *filename);
 static int addarchive (const char *path, const char *layout);
+static int setspooldir (void);
+static int prefetchurls (void);
+static Filelink *openinput (MS3RecordPtr *recptr);
+static int readbatch (MS3RecordPtr *first);
+static void cleanspooldir (void);
+static int probefile (const char *filename);
+static int64_t tarnumber (const unsigned char *field, int length);
+static int tarchecksum (const unsigned char *header);
+static int addtarbundle (const char *filename);
+static void appendfile (Filelink *lp);
 static void usage (int level);
 
 static int8_t verbose = 0;
 static int8_t skipnotdata = 0;    /* Controls skipping of non-miniSEED data */
+static char crcpolicy = 'r';      /* CRC validation: 'r' = when reading, 'w' = when writing */
 static int8_t bestversion = 1;    /* Use publication version to retain the "best" data when pruning */
 static int8_t prunedata = 0;      /* Prune data: 'r= record level, 's' = sample level, 'e' = edges only */
 static uint8_t setpubver = 0;     /* Set publication version/quality indicator on output records */
+static int8_t convertv3 = 0;      /* Convert miniSEED 2 records to miniSEED 3 on output */
 static double timetol = -1.0;     /* Time tolerance for continuous traces */
 static double sampratetol = -1.0; /* Sample rate tolerance for continuous traces */
+static int iodepth = 0;           /* Reads in flight with io_uring, 0 for synchronous reads */
+static int outputthreads = 1;     /* Threads writing a single output file at planned offsets */
 static MS3Tolerance tolerance = {.time = NULL, .samprate = NULL};
 
 /* Trivial callback functions for fixed time and sample rate tolerances */
@@ -189,15 +335,31 @@ static char *outputfile = NULL;  /* Single output file */
 static int8_t outputmode = 0;    /* Mode for single output file: 0=overwrite, 1=append */
 static Archive *archiveroot = 0; /* Output file structures */
 
-static char recordbuf[MAXRECLEN]; /* Global record buffer */
+static char readbuf[MAXRECLEN];     /* Buffer for batches of records read for output */
+static char convertbuf[MAXRECLEN];  /* Buffer for records converted to miniSEED 3 */
+static char *recordbuf = readbuf;   /* Current record in read buffer */
+
+static RecordTable rectable = {0};  /* Table of record times for pruning */
+
+static MS3IOQueue *ioqueue = NULL;                /* Queue for reading batches of records */
+static MS3IORequest batchreqs[READBATCHRECORDS];  /* Read requests for batch of records */
+static Filelink *batchflp[READBATCHRECORDS];      /* Input file of each record in batch */
+static char *batchrecord[READBATCHRECORDS];       /* Location of each record in read buffer */
 
 static Filelink *filelist = NULL;        /* List of input files */
 static Filelink *filelisttail = NULL;    /* Tail of list of input files */
+static char *spooldir = NULL;            /* Directory for spooling URL input */
+static char spooltempdir[1024] = {0};    /* Temporary spool directory, removed on exit */
+static int prefetchconns = 4;            /* Concurrent connections for prefetching URL input */
 static MS3Selections *selections = NULL; /* Data selection criteria, SIDs and time ranges */
 
 static char *writtenfile = NULL;       /* File to write summary of output records */
 static char *writtenprefix = NULL;     /* Prefix for summary of output records */
-static MS3TraceList *writtentl = NULL; /* TraceList of output records */
+static WrittenID *writtenids = NULL;  /* Summary of output records by ID */
+static uint32_t writtencount = 0;      /* Count of IDs in written summary */
+static uint32_t writtenmax = 0;        /* Allocated IDs in written summary */
+static char *manifestfile = NULL;      /* File to write manifest of output files */
+static DataStreamFile *outputdigest = NULL; /* Digest of single output file */
 
 int
 main (int argc, char **argv)
@@ -223,22 +385,45 @@ main (int argc, char **argv)
   if (archiveroot)
     ds_maxopenfiles = 50;
 
-  /* Initialize written MS3TraceList */
-  if (writtenfile)
-    if ((writtentl = mstl3_init (writtentl)) == NULL)
-      return 1;
+  /* Track digests of archive files for the manifest */
+  if (manifestfile)
+  {
+    Archive *arch;
+
+    for (arch = archiveroot; arch; arch = arch->next)
+      arch->datastream.digest = 1;
+  }
 
   /* Set flags to:
-   * - validate CRCs (if present)
+   * - validate CRCs (if present) when reading, unless deferred to writing
    * - extract start-stop range from file names
    * - construct a record-list for each segment */
-  flags |= MSF_VALIDATECRC;
+  if (crcpolicy == 'r')
+    flags |= MSF_VALIDATECRC;
   flags |= MSF_PNAMERANGE;
   flags |= MSF_RECORDLIST;
 
   if (skipnotdata)
     flags |= MSF_SKIPNOTDATA;
 
+  /* Spool URL and compressed input for re-reading while writing output */
+  if (setspooldir ())
+    return 1;
+
+  /* Fetch URL input concurrently into the spool */
+  if (prefetchurls ())
+    return 1;
+
+  /* Keep reads in flight for input files when reading and writing */
+  if (iodepth > 0)
+  {
+    if ((retcode = ms3_io_readahead (iodepth)) < 0)
+      return 1;
+
+    if (retcode == 1 && verbose)
+      ms_log (1, "io_uring is not available, reading input synchronously\n");
+  }
+
   flp = filelist;
   while (flp)
   {
@@ -269,6 +454,10 @@ main (int argc, char **argv)
    * filecount + ds_maxopenfiles and some wiggle room. */
   setofilelimit (totalfiles + ds_maxopenfiles + 20);
 
+  /* Build table of record times when pruning */
+  if (prunedata && initrecordtable (mstl))
+    return 1;
+
   /* Set time limits based on selections when pruning to specific time limits */
   if ((prunedata == 's' || prunedata == 'e') &&
       selections && setselectionlimits (mstl))
@@ -313,10 +502,12 @@ main (int argc, char **argv)
 
   if (writtenfile)
   {
-    printwritten (writtentl);
-    mstl3_free (&writtentl, 1);
+    printwritten ();
   }
 
+  if (manifestfile)
+    printmanifest ();
+
   /* The main MS3TraceList (mstl) is not freed on purpose: the structure has a
    * potentially huge number of sub-structures which would take a long time to
    * iterate through.  This would be a waste of time given the program is now done.
@@ -326,6 +517,66 @@ main (int argc, char **argv)
   return 0;
 } /* End of main() */
 
+/***************************************************************************
+ * Build the record table for pruning with an entry for each record, in
+ * trace list order, and set each MS3RecordPtr.prvtptr to the TimeRange
+ * of its entry.  New record start and end times are unset until
+ * determined by pruning.
+ *
+ * The table is not freed, like the MS3TraceList it belongs to.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+initrecordtable (MS3TraceList *mstl)
+{
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3RecordPtr *recptr = NULL;
+  uint64_t reccount = 0;
+  uint64_t recindex = 0;
+
+  if (!mstl)
+    return 0;
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+    for (seg = id->first; seg; seg = seg->next)
+      reccount += seg->recordlist->recordcnt;
+
+  if (reccount == 0)
+    return 0;
+
+  if ((rectable.timeranges = (TimeRange *)malloc (reccount * sizeof (TimeRange))) == NULL ||
+      (rectable.effstart = (nstime_t *)malloc (reccount * sizeof (nstime_t))) == NULL ||
+      (rectable.effend = (nstime_t *)malloc (reccount * sizeof (nstime_t))) == NULL ||
+      (rectable.removed = (uint8_t *)malloc (reccount * sizeof (uint8_t))) == NULL ||
+      (rectable.breaks = (uint8_t *)malloc (reccount * sizeof (uint8_t))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return -1;
+  }
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      for (recptr = seg->recordlist->first; recptr && recindex < reccount; recptr = recptr->next)
+      {
+        rectable.timeranges[recindex].starttime = NSTUNSET;
+        rectable.timeranges[recindex].endtime = NSTUNSET;
+        rectable.effstart[recindex] = recptr->msr->starttime;
+        rectable.effend[recindex] = recptr->endtime;
+        rectable.removed[recindex] = (recptr->msr->reclen == 0);
+        recptr->prvtptr = &rectable.timeranges[recindex++];
+      }
+    }
+  }
+
+  rectable.count = recindex;
+
+  return 0;
+} /* End of initrecordtable() */
+
 /***************************************************************************
  * Determine selection limits for each record based on all
  * matching selection entries.
@@ -341,6 +592,7 @@ setselectionlimits (MS3TraceList *mstl)
 {
   const MS3Selections *select = NULL;
   const MS3SelectTime *selecttime = NULL;
+  const MS3SelectTime *timewindows = NULL;
   MS3TraceID *id = NULL;
   MS3TraceSeg *seg = NULL;
   MS3RecordPtr *recptr = NULL;
@@ -355,20 +607,18 @@ setselectionlimits (MS3TraceList *mstl)
   id = mstl->traces.next[0];
   while (id)
   {
-    seg = id->first;
-    while (seg)
+    /* Match selections by SourceID once for all records of the ID, time windows
+     * that do not intersect a record do not have limits within the record */
+    select = selections;
+    while ((select = ms3_matchselect (select, id->sid, NSTUNSET, NSTUNSET, 0, &timewindows)))
     {
-      recptr = seg->recordlist->first;
-      while (recptr)
+      seg = id->first;
+      while (seg)
       {
-        select = selections;
-        while ((select = ms3_matchselect (select,
-                                          recptr->msr->sid,
-                                          recptr->msr->starttime,
-                                          recptr->endtime,
-                                          0,
-                                          &selecttime)))
+        recptr = seg->recordlist->first;
+        while (recptr)
         {
+          selecttime = timewindows;
           while (selecttime)
           {
             /* Records are either completely or partially selected by time limits */
@@ -395,36 +645,23 @@ setselectionlimits (MS3TraceList *mstl)
               continue;
             }
 
-            /* Allocate TimeRange for new time boundaries */
-            if (recptr->prvtptr == NULL)
-            {
-              if ((recptr->prvtptr = (TimeRange *)malloc (sizeof (TimeRange))) == NULL)
-              {
-                ms_log (2, "%s(): Cannot allocate memory\n", __func__);
-                return -1;
-              }
-
-              ((TimeRange *)recptr->prvtptr)->starttime = NSTUNSET;
-              ((TimeRange *)recptr->prvtptr)->endtime = NSTUNSET;
-            }
-
             timerange = (TimeRange *)recptr->prvtptr;
 
             if (newstart != NSTUNSET &&
                 (timerange->starttime == NSTUNSET || newstart < timerange->starttime))
-              timerange->starttime = newstart;
+              rectable.effstart[RECINDEX (recptr)] = timerange->starttime = newstart;
 
             if (newend != NSTUNSET &&
                 (timerange->endtime == NSTUNSET || newend > timerange->endtime))
-              timerange->endtime = newend;
+              rectable.effend[RECINDEX (recptr)] = timerange->endtime = newend;
 
             selecttime = selecttime->next;
           }
-          select = select->next;
+          recptr = recptr->next;
         }
-        recptr = recptr->next;
+        seg = seg->next;
       }
-      seg = seg->next;
+      select = select->next;
     }
     id = id->next[0];
   }
@@ -453,6 +690,7 @@ writetraces (MS3TraceList *mstl)
   char *ab = "ab";
   char *mode;
   int8_t errflag = 0;
+  int8_t planned;
   int rv;
 
   MS3TraceID *id;
@@ -465,12 +703,14 @@ writetraces (MS3TraceList *mstl)
   MS3RecordList *groupreclist = NULL;
 
   TimeRange *newrange;
-  Filelink *flpsearch;
   Filelink *flp;
+  int batchcount;
+  int batchindex;
 
   FILE *ofp = NULL;
   WriterData writerdata;
 
+  writerdata.output = NULL;
   writerdata.errflagp = &errflag;
 
   if (!mstl)
@@ -482,8 +722,16 @@ writetraces (MS3TraceList *mstl)
   if (verbose)
     ms_log (1, "Writing output data\n");
 
+  /* Write a single output file at planned offsets when using threads,
+   * archives and records converted to miniSEED 3 are written sequentially */
+  planned = (outputthreads > 1 && outputfile && strcmp (outputfile, "-") &&
+             !archiveroot && !convertv3);
+
+  if (outputthreads > 1 && !planned && verbose)
+    ms_log (1, "Writing output sequentially, threads only used for a single output file\n");
+
   /* Open the output file if specified */
-  if (outputfile)
+  if (outputfile && !planned)
   {
     /* Decide if we are appending or overwriting */
     mode = (totalbytesout || outputmode) ? ab : wb;
@@ -498,6 +746,10 @@ writetraces (MS3TraceList *mstl)
               outputfile, strerror (errno));
       return 1;
     }
+
+    /* Track digest of output file for the manifest, after any truncation */
+    if (manifestfile && (outputdigest = ds_fileinit (outputfile)) == NULL)
+      return 1;
   }
 
   /* Re-link records into write lists, from per-segment lists to per-ID lists.
@@ -508,7 +760,7 @@ writetraces (MS3TraceList *mstl)
   while (id)
   {
     /* Check if new group ID is needed */
-    if (groupid != id && strcmp (groupid->sid, id->sid) != 0)
+    if (groupid->sidhandle != id->sidhandle)
     {
       groupid = id;
     }
@@ -591,8 +843,19 @@ writetraces (MS3TraceList *mstl)
     id = id->next[0];
   } /* Done combining pruned records into SourceID groups */
 
-  /* Loop through MS3TraceList and write records */
-  id = mstl->traces.next[0];
+  if (planned)
+  {
+    if (writeplanned (mstl, &totalrecsout, &totalbytesout))
+      errflag = 1;
+  }
+  /* Queue for reading records, registering the read buffer */
+  else if ((ioqueue = ms3_ioqueue_init (iodepth, readbuf, sizeof (readbuf))) == NULL)
+  {
+    return 1;
+  }
+
+  /* Loop through MS3TraceList and write records, unless written as planned */
+  id = (planned) ? NULL : mstl->traces.next[0];
   while (id && errflag == 0)
   {
     groupreclist = (MS3RecordList *)id->prvtptr;
@@ -603,69 +866,42 @@ writetraces (MS3TraceList *mstl)
        * pruned it is already in time order. */
       if (prunedata == 'r' || prunedata == 's')
       {
-        sortrecordlist (groupreclist);
+        if (sortrecordlist (groupreclist))
+        {
+          errflag = 1;
+          break;
+        }
       }
 
       /* Write each record.
-       * After records are read from the input files, perform any
-       * pre-identified pruning before writing data. */
+       * After records are read from the input files in batches, perform
+       * any pre-identified pruning before writing data. */
       recptr = groupreclist->first;
+      batchcount = 0;
+      batchindex = 0;
       while (recptr && errflag == 0)
       {
-        if ((size_t)recptr->msr->reclen > sizeof (recordbuf))
-        {
-          ms_log (2, "Record length (%d bytes) larger than buffer (%llu bytes)\n",
-                  recptr->msr->reclen, (long long unsigned int)sizeof (recordbuf));
-          errflag = 1;
-          break;
-        }
-
-        /* Find the matching input file entry */
-        flp = NULL;
-        flpsearch = filelist;
-        while (flpsearch)
-        {
-          if (flpsearch->infilename_raw == recptr->filename)
-          {
-            flp = flpsearch;
-            break;
-          }
-
-          flpsearch = flpsearch->next;
-        }
-
-        if (flp == NULL)
+        /* Read the next batch of records, starting with this record */
+        if (batchindex >= batchcount)
         {
-          ms_log (2, "Cannot find input file entry for %s\n", recptr->filename);
-          errflag = 1;
-          break;
-        }
-
-        /* Open file for reading if not already done */
-        if (!flp->infp)
-          if (!(flp->infp = fopen (flp->infilename, "rb")))
+          if ((batchcount = readbatch (recptr)) <= 0)
           {
-            ms_log (2, "Cannot open '%s' for reading: %s\n",
-                    flp->infilename, strerror (errno));
             errflag = 1;
             break;
           }
 
-        /* Seek to record offset */
-        if (lmp_fseek64 (flp->infp, recptr->fileoffset, SEEK_SET) == -1)
-        {
-          ms_log (2, "Cannot seek in '%s': %s\n",
-                  flp->infilename, strerror (errno));
-          errflag = 1;
-          break;
+          batchindex = 0;
         }
 
-        /* Read record into buffer */
-        if (fread (recordbuf, recptr->msr->reclen, 1, flp->infp) != 1)
+        flp = batchflp[batchindex];
+        recordbuf = batchrecord[batchindex];
+        batchindex++;
+
+        /* Validate CRC of record data to be written if deferred from reading */
+        if (crcpolicy == 'w' && !validcrc (recordbuf, recptr->msr->reclen))
         {
-          ms_log (2, "Cannot read %d bytes at offset %llu from '%s'\n",
-                  recptr->msr->reclen, (long long unsigned)recptr->fileoffset,
-                  flp->infilename);
+          ms_log (2, "%s: CRC is invalid for record at byte offset %" PRId64 " in %s\n",
+                  id->sid, recptr->fileoffset, flp->infilename);
           errflag = 1;
           break;
         }
@@ -716,6 +952,9 @@ writetraces (MS3TraceList *mstl)
     id = id->next[0];
   } /* Done looping through MS3TraceIDs */
 
+  ms3_ioqueue_free (ioqueue);
+  ioqueue = NULL;
+
   /* Close all open input & output files and remove backups if requested */
   flp = filelist;
   while (flp)
@@ -746,143 +985,929 @@ writetraces (MS3TraceList *mstl)
 } /* End of writetraces() */
 
 /***************************************************************************
- * Unpack a data record and trim samples, either from the beginning or
- * the end, to fit the TimeRange.starttime and TimeRange.endtime boundary
- * times and pack the record.
+ * Write all contributing records to the single output file at planned
+ * offsets using -threads threads.
  *
- * Data samples times are not modified.  The new start and end times
- * are treated as arbitrary boundaries, not as explicit new start/end
- * times, this routine calculates which samples fit within the new
- * boundaries.
+ * The records are gathered in output order into a plan, sorted as for
+ * sequential writing.  In a first pass the threads trim and repack the
+ * records that require it, keeping the repacked records in memory.
+ * The byte offset of every output record is then assigned in order,
+ * after which the threads copy the records to their offsets in the
+ * output file in parallel.  Messages logged by the threads are queued
+ * in a log ring and printed by the main thread.
  *
- * Return 0 on success, -1 on failure or skip and -2 on unpacking errors.
+ * Returns 0 on success and 1 on error.
  ***************************************************************************/
 static int
-trimrecord (MS3RecordPtr *recptr, char *recordbuf, WriterData *writerdata)
+writeplanned (MS3TraceList *mstl, uint64_t *recsout, uint64_t *bytesout)
 {
-  nstime_t nsperiod;
-  nstime_t ostarttime;
+  OutputPlan plan;
+  OutputRecord *output;
+  MS3TraceID *id;
+  MS3RecordList *groupreclist;
+  MS3RecordPtr *recptr;
   TimeRange *newrange;
+  int64_t offset = 0;
+  int64_t position;
+  int64_t reclen;
+  int64_t length;
+  uint64_t idx;
+  uint64_t end;
+  uint8_t formatversion;
+  int8_t errflag = 0;
 
-  char stime[32] = {0};
-  char etime[32] = {0};
-
-  int trimsamples;
-  uint8_t samplesize;
-  char sampletype;
-  int64_t packedsamples;
-  int packedrecords;
-  int retcode;
-
-  if (!recptr || !recordbuf)
-    return -1;
+  memset (&plan, 0, sizeof (plan));
+  plan.fd = -1;
+  plan.buffersize = PLANBUFFERSIZE;
+  plan.mainthread = pthread_self ();
 
-  ostarttime = recptr->msr->starttime;
-  newrange = (TimeRange *)(recptr->prvtptr);
+  if (pthread_mutex_init (&plan.lock, NULL))
+  {
+    ms_log (2, "Cannot initialize mutex\n");
+    return 1;
+  }
 
-  /* Sanity check for new start/end times */
-  if ((newrange->starttime != NSTUNSET && newrange->endtime != NSTUNSET && newrange->starttime > newrange->endtime) ||
-      (newrange->starttime != NSTUNSET && (newrange->starttime < recptr->msr->starttime || newrange->starttime > recptr->endtime)) ||
-      (newrange->endtime != NSTUNSET && (newrange->endtime > recptr->endtime || newrange->endtime < recptr->msr->starttime)))
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
   {
-    ms_log (2, "Problem with new start/end record bound times.\n");
-    ms_log (2, "  Original record %s from %s (byte offset: %llu)\n",
-            "SourceID", writerdata->flp->infilename, (unsigned long long)recptr->fileoffset);
-    ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_nstime2timestr (recptr->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_log (2, "       Start: %s       End: %s\n", stime, etime);
-    if (newrange->starttime == NSTUNSET)
-      strcpy (stime, "NONE");
-    else
-      ms_nstime2timestr (newrange->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-    if (newrange->endtime == NSTUNSET)
-      strcpy (etime, "NONE");
-    else
-      ms_nstime2timestr (newrange->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_log (2, " Start bound: %-24s End bound: %-24s\n", stime, etime);
+    if ((groupreclist = (MS3RecordList *)id->prvtptr))
+      plan.count += groupreclist->recordcnt;
+  }
 
-    return -1;
+  if (plan.count == 0)
+  {
+    pthread_mutex_destroy (&plan.lock);
+    return 0;
   }
 
-  if (ms_encoding_sizetype (recptr->msr->encoding, &samplesize, &sampletype))
+  if ((plan.records = (OutputRecord *)calloc (plan.count, sizeof (OutputRecord))) == NULL)
   {
-    ms_log (2, "Cannot determine sample size and type for encoding %d\n", recptr->msr->encoding);
-    return -1;
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    pthread_mutex_destroy (&plan.lock);
+    return 1;
   }
 
-  /* Check for supported samples types, can only trim what can be packed */
-  if (sampletype != 'i' && sampletype != 'f' && sampletype != 'd')
+  /* Gather records in output order, identifying records to be trimmed */
+  output = plan.records;
+  for (id = mstl->traces.next[0]; id && errflag == 0; id = id->next[0])
   {
-    if (verbose)
+    groupreclist = (MS3RecordList *)id->prvtptr;
+
+    if (!groupreclist || groupreclist->recordcnt == 0)
+      continue;
+
+    /* Sort record list if overlaps have been pruned */
+    if ((prunedata == 'r' || prunedata == 's') && sortrecordlist (groupreclist))
     {
-      ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-      ms_log (1, "Skipping trim of %s (%s), unsupported encoding (%d: %s)\n",
-              recptr->msr->sid, stime, recptr->msr->encoding, ms_encodingstr (recptr->msr->encoding));
+      errflag = 1;
+      break;
     }
 
-    return 0;
+    for (recptr = groupreclist->first; recptr && output < plan.records + plan.count;
+         recptr = recptr->next)
+    {
+      if ((output->flp = openinput (recptr)) == NULL)
+      {
+        errflag = 1;
+        break;
+      }
+
+      newrange = (TimeRange *)(recptr->prvtptr);
+
+      output->recptr = recptr;
+      output->repack = (newrange && (newrange->starttime != NSTUNSET || newrange->endtime != NSTUNSET));
+      output->length = (output->repack) ? 0 : recptr->msr->reclen;
+
+      if ((size_t)recptr->msr->reclen > plan.buffersize)
+        plan.buffersize = recptr->msr->reclen;
+
+      output++;
+    }
   }
 
-  /* Decode data samples */
-  recptr->msr->record = recordbuf;
-  if ((retcode = msr3_unpack_data (recptr->msr, 0)) < 0)
-  {
-    ms_log (2, "Cannot unpack miniSEED record: %s\n", ms_errorstr (retcode));
+  plan.count = output - plan.records;
 
-    return -2;
+  /* Open the output file, truncating unless appending */
+  if (errflag == 0 &&
+      (plan.fd = open (outputfile, ((manifestfile) ? O_RDWR : O_WRONLY) | O_CREAT |
+                                       ((*bytesout || outputmode) ? 0 : O_TRUNC),
+                       0666)) < 0)
+  {
+    ms_log (2, "Cannot open output file: %s (%s)\n", outputfile, strerror (errno));
+    errflag = 1;
   }
 
-  if (verbose > 1)
+  /* Track digest of output file for the manifest, after any truncation */
+  if (errflag == 0 && manifestfile)
   {
-    ms_log (1, "Triming record: %s (%u)\n", recptr->msr->sid, recptr->msr->pubversion);
-    ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_nstime2timestr (recptr->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_log (1, "       Start: %s        End: %s\n", stime, etime);
-    if (newrange->starttime == NSTUNSET)
-      strcpy (stime, "NONE");
-    else
-      ms_nstime2timestr (newrange->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-    if (newrange->endtime == NSTUNSET)
-      strcpy (etime, "NONE");
-    else
-      ms_nstime2timestr (newrange->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
-    ms_log (1, " Start bound: %-24s  End bound: %-24s\n", stime, etime);
+    if ((outputdigest = ds_fileinit (outputfile)) == NULL)
+      errflag = 1;
+    else if ((plan.crcs = (uint32_t *)calloc ((plan.count + PLANCHUNKRECORDS - 1) / PLANCHUNKRECORDS,
+                                              sizeof (uint32_t))) == NULL)
+    {
+      ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+      errflag = 1;
+    }
   }
 
-  /* Determine sample period in nanosecond time ticks */
-  nsperiod = msr3_nsperiod(recptr->msr);
+  if (errflag == 0 && (offset = lseek (plan.fd, 0, SEEK_END)) < 0)
+  {
+    ms_log (2, "Cannot seek in output file: %s (%s)\n", outputfile, strerror (errno));
+    errflag = 1;
+  }
 
-  /* Remove samples from the beginning of the record */
-  if (newrange->starttime != NSTUNSET && nsperiod)
+  if (errflag == 0 && ms_rlog_ring_init (LOGRINGSIZE, 0))
   {
-    nstime_t newstarttime;
+    ms_log (2, "Cannot initialize log ring\n");
+    errflag = 1;
+  }
 
-    /* Determine new start time and the number of samples to trim */
-    trimsamples = 0;
-    newstarttime = recptr->msr->starttime;
+  /* Trim and repack records in parallel */
+  if (errflag == 0 && runplanthreads (trimplanned, &plan))
+    errflag = 1;
+
+  /* Assign output offsets in order and add records to written summary */
+  for (idx = 0; errflag == 0 && idx < plan.count; idx++)
+  {
+    output = &plan.records[idx];
+    output->offset = offset;
+    offset += output->length;
 
-    while (newstarttime < newrange->starttime && trimsamples < recptr->msr->samplecnt)
+    if (output->length > 0)
     {
-      newstarttime += nsperiod;
-      trimsamples++;
+      (*recsout)++;
+      *bytesout += output->length;
     }
 
-    if (trimsamples >= recptr->msr->samplecnt)
+    if (!writtenfile)
+      continue;
+
+    if (!output->repack)
     {
-      if (verbose > 1)
-        ms_log (1, "All samples would be trimmed from record, skipping\n");
+      if (addwritten (output->recptr->msr, (int)output->length))
+        errflag = 1;
 
-      return -1;
+      continue;
     }
 
-    if (verbose > 2)
+    /* Repacked records, usually one, are added individually */
+    for (position = 0; position < output->length; position += reclen)
     {
-      ms_nstime2timestr (newstarttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-      ms_log (1, "Removing %d samples from the start, new start time: %s\n", trimsamples, stime);
+      reclen = ms3_detect (output->buffer + position, output->length - position, &formatversion);
+
+      if (reclen <= 0 || addwritten (output->recptr->msr, (int)reclen))
+      {
+        errflag = 1;
+        break;
+      }
     }
+  }
 
-    memmove (recptr->msr->datasamples,
-             (char *)recptr->msr->datasamples + (samplesize * trimsamples),
+  /* Copy records to the output file in parallel */
+  if (errflag == 0 && runplanthreads (fillplanned, &plan))
+    errflag = 1;
+
+  /* Update digest of output file in order, combining the CRC of each
+   * chunk of records calculated while writing */
+  for (idx = 0; errflag == 0 && outputdigest && idx < plan.count; idx++)
+  {
+    output = &plan.records[idx];
+
+    if (idx % PLANCHUNKRECORDS == 0)
+    {
+      end = (plan.count - idx > PLANCHUNKRECORDS) ? idx + PLANCHUNKRECORDS : plan.count;
+      length = plan.records[end - 1].offset + plan.records[end - 1].length - output->offset;
+
+      if (ds_fileappend (outputdigest, plan.crcs[idx / PLANCHUNKRECORDS], length))
+      {
+        ms_log (2, "Cannot update digest of '%s'\n", outputfile);
+        errflag = 1;
+        break;
+      }
+    }
+
+    if (output->length == 0)
+      continue;
+
+    if (!output->repack)
+    {
+      if (ds_filerecord (outputdigest, output->recptr->msr))
+        errflag = 1;
+
+      continue;
+    }
+
+    for (position = 0; position < output->length; position += reclen)
+    {
+      reclen = ms3_detect (output->buffer + position, output->length - position, &formatversion);
+
+      if (reclen <= 0 || ds_filerecord (outputdigest, output->recptr->msr))
+      {
+        errflag = 1;
+        break;
+      }
+    }
+  }
+
+  ms_rlog_ring_free (NULL);
+
+  if (plan.fd >= 0 && close (plan.fd))
+  {
+    ms_log (2, "Cannot close output file: %s (%s)\n", outputfile, strerror (errno));
+    errflag = 1;
+  }
+
+  pthread_mutex_destroy (&plan.lock);
+
+  for (idx = 0; idx < plan.count; idx++)
+    free (plan.records[idx].buffer);
+
+  free (plan.records);
+  free (plan.crcs);
+
+  return (errflag) ? 1 : 0;
+} /* End of writeplanned() */
+
+/***************************************************************************
+ * Run a routine over the output plan with -threads threads, the main
+ * thread being one of them, and print the messages logged meanwhile.
+ *
+ * Returns 0 on success and 1 on error.
+ ***************************************************************************/
+static int
+runplanthreads (void *(*routine) (void *), OutputPlan *plan)
+{
+  pthread_t *threads;
+  int started;
+  int idx;
+  int rv;
+
+  if ((threads = (pthread_t *)malloc (sizeof (pthread_t) * outputthreads)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return 1;
+  }
+
+  plan->next = 0;
+
+  for (started = 1; started < outputthreads; started++)
+  {
+    if ((rv = pthread_create (&threads[started], NULL, routine, plan)))
+    {
+      ms_log (2, "Cannot create thread: %s\n", strerror (rv));
+      failplanned (plan);
+      break;
+    }
+  }
+
+  routine (plan);
+
+  for (idx = 1; idx < started; idx++)
+    pthread_join (threads[idx], NULL);
+
+  free (threads);
+
+  ms_rlog_ring_drain (NULL);
+
+  return (plan->errflag) ? 1 : 0;
+} /* End of runplanthreads() */
+
+/***************************************************************************
+ * Thread routine to trim and repack the planned output records that
+ * require it, collecting the repacked record(s) in the output record.
+ ***************************************************************************/
+static void *
+trimplanned (void *arg)
+{
+  OutputPlan *plan = (OutputPlan *)arg;
+  OutputRecord *output;
+  MS3RecordPtr *recptr;
+  WriterData writerdata;
+  char *record;
+  uint64_t first;
+  uint64_t end;
+  uint64_t idx;
+  int8_t errflag = 0;
+  int rv;
+
+  if ((record = (char *)malloc (plan->buffersize)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    failplanned (plan);
+    return NULL;
+  }
+
+  writerdata.ofp = NULL;
+  writerdata.errflagp = &errflag;
+
+  while (errflag == 0 && claimplanned (plan, &first, &end))
+  {
+    for (idx = first; idx < end && errflag == 0; idx++)
+    {
+      output = &plan->records[idx];
+      recptr = output->recptr;
+
+      if (!output->repack)
+        continue;
+
+      if (readrange (fileno (output->flp->infp), record, recptr->msr->reclen, recptr->fileoffset))
+      {
+        ms_log (2, "Cannot read %d bytes at offset %" PRId64 " in %s: %s\n",
+                recptr->msr->reclen, recptr->fileoffset, output->flp->infilename, strerror (errno));
+        errflag = 1;
+        break;
+      }
+
+      /* Validate CRC of record data to be written if deferred from reading */
+      if (crcpolicy == 'w' && !validcrc (record, recptr->msr->reclen))
+      {
+        ms_log (2, "%s: CRC is invalid for record at byte offset %" PRId64 " in %s\n",
+                recptr->msr->sid, recptr->fileoffset, output->flp->infilename);
+        errflag = 1;
+        break;
+      }
+
+      writerdata.recptr = recptr;
+      writerdata.flp = output->flp;
+      writerdata.output = output;
+
+      rv = trimrecord (recptr, record, &writerdata);
+
+      if (rv == -2)
+      {
+        ms_log (1, "Cannot unpack miniSEED from byte offset %" PRId64 " in %s\n",
+                recptr->fileoffset, output->flp->infilename);
+        ms_log (1, "  Writing %s record without trimming\n", recptr->msr->sid);
+
+        writerecord (record, recptr->msr->reclen, &writerdata);
+      }
+    }
+  }
+
+  if (errflag)
+    failplanned (plan);
+
+  free (record);
+
+  return NULL;
+} /* End of trimplanned() */
+
+/***************************************************************************
+ * Thread routine to copy the planned output records to their offsets
+ * in the output file.  Repacked records are written from memory, runs
+ * of records adjacent in an input file are copied together and only
+ * passed through memory when they must be validated or modified, or
+ * for the digest of the output file.  The CRC32C of the records of
+ * each claimed chunk is then calculated as they are written.
+ ***************************************************************************/
+static void *
+fillplanned (void *arg)
+{
+  OutputPlan *plan = (OutputPlan *)arg;
+  OutputRecord *output;
+  OutputRecord *next;
+  char *buffer;
+  int64_t length;
+  int64_t position;
+  uint64_t first;
+  uint64_t end;
+  uint64_t idx;
+  uint64_t runend;
+  uint64_t run;
+  uint32_t crc;
+  int infd;
+  int8_t errflag = 0;
+
+  if ((buffer = (char *)malloc (plan->buffersize)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    failplanned (plan);
+    return NULL;
+  }
+
+  while (errflag == 0 && claimplanned (plan, &first, &end))
+  {
+    crc = 0;
+
+    for (idx = first; idx < end && errflag == 0; idx = runend)
+    {
+      output = &plan->records[idx];
+      runend = idx + 1;
+
+      if (output->length == 0)
+        continue;
+
+      if (output->repack)
+      {
+        if (pwritefull (plan->fd, output->buffer, output->length, output->offset))
+        {
+          ms_log (2, "Cannot write to '%s': %s\n", outputfile, strerror (errno));
+          errflag = 1;
+        }
+        else if (plan->crcs)
+        {
+          crc = ms_crc32c ((const uint8_t *)output->buffer, (int)output->length, crc);
+        }
+
+        continue;
+      }
+
+      /* Extend run with following records adjacent in the same input file */
+      infd = fileno (output->flp->infp);
+      length = output->length;
+      while (runend < end)
+      {
+        next = &plan->records[runend];
+
+        if (next->repack || fileno (next->flp->infp) != infd ||
+            next->recptr->fileoffset != output->recptr->fileoffset + length ||
+            (size_t)(length + next->length) > plan->buffersize)
+          break;
+
+        length += next->length;
+        runend++;
+      }
+
+      /* Copy unmodified records directly */
+      if (crcpolicy != 'w' && !setpubver && !plan->crcs)
+      {
+        if (copyrange (infd, output->recptr->fileoffset, plan->fd, output->offset,
+                       length, buffer, plan->buffersize))
+        {
+          ms_log (2, "Cannot copy %" PRId64 " bytes from %s to '%s': %s\n",
+                  length, output->flp->infilename, outputfile, strerror (errno));
+          errflag = 1;
+        }
+
+        continue;
+      }
+
+      if (readrange (infd, buffer, length, output->recptr->fileoffset))
+      {
+        ms_log (2, "Cannot read %" PRId64 " bytes at offset %" PRId64 " in %s: %s\n",
+                length, output->recptr->fileoffset, output->flp->infilename, strerror (errno));
+        errflag = 1;
+        break;
+      }
+
+      for (run = idx, position = 0; run < runend; position += plan->records[run].length, run++)
+      {
+        next = &plan->records[run];
+
+        /* Validate CRC of record data to be written if deferred from reading */
+        if (crcpolicy == 'w' && !validcrc (buffer + position, (int)next->length))
+        {
+          ms_log (2, "%s: CRC is invalid for record at byte offset %" PRId64 " in %s\n",
+                  next->recptr->msr->sid, next->recptr->fileoffset, next->flp->infilename);
+          errflag = 1;
+          break;
+        }
+
+        if (setpubver && setrecordpubver (buffer + position, (int)next->length))
+        {
+          errflag = 1;
+          break;
+        }
+      }
+
+      if (errflag == 0 && pwritefull (plan->fd, buffer, length, output->offset))
+      {
+        ms_log (2, "Cannot write to '%s': %s\n", outputfile, strerror (errno));
+        errflag = 1;
+      }
+      else if (errflag == 0 && plan->crcs)
+      {
+        crc = ms_crc32c ((const uint8_t *)buffer, (int)length, crc);
+      }
+    }
+
+    if (errflag == 0 && plan->crcs)
+      plan->crcs[first / PLANCHUNKRECORDS] = crc;
+  }
+
+  if (errflag)
+    failplanned (plan);
+
+  free (buffer);
+
+  return NULL;
+} /* End of fillplanned() */
+
+/***************************************************************************
+ * Claim the next PLANCHUNKRECORDS records of the output plan for a
+ * thread, setting the range from 'first' up to 'end'.  When called
+ * from the main thread any logged messages are printed.
+ *
+ * Returns 1 when records were claimed and 0 when none remain or an
+ * error occurred in any thread.
+ ***************************************************************************/
+static int
+claimplanned (OutputPlan *plan, uint64_t *first, uint64_t *end)
+{
+  int claimed = 0;
+
+  if (pthread_equal (pthread_self (), plan->mainthread))
+    ms_rlog_ring_drain (NULL);
+
+  pthread_mutex_lock (&plan->lock);
+
+  if (plan->errflag == 0 && plan->next < plan->count)
+  {
+    *first = plan->next;
+    *end = (plan->count - plan->next > PLANCHUNKRECORDS) ? plan->next + PLANCHUNKRECORDS : plan->count;
+    plan->next = *end;
+    claimed = 1;
+  }
+
+  pthread_mutex_unlock (&plan->lock);
+
+  return claimed;
+} /* End of claimplanned() */
+
+/***************************************************************************
+ * Flag an error in writing the output plan, stopping all threads.
+ ***************************************************************************/
+static void
+failplanned (OutputPlan *plan)
+{
+  pthread_mutex_lock (&plan->lock);
+  plan->errflag = 1;
+  pthread_mutex_unlock (&plan->lock);
+} /* End of failplanned() */
+
+/***************************************************************************
+ * Copy 'length' bytes from an input file to an output file at the
+ * specified offsets.  On Linux copy_file_range() is used, allowing the
+ * kernel or file system to copy without passing the data through
+ * memory.  If not supported for the files or on other systems, the
+ * data are copied through 'buffer' with pread() and pwrite().
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+copyrange (int infd, int64_t inoffset, int outfd, int64_t outoffset,
+           int64_t length, char *buffer, size_t buffersize)
+{
+  size_t count;
+
+#if defined(__linux__)
+  loff_t inoff = inoffset;
+  loff_t outoff = outoffset;
+  ssize_t copied = 0;
+
+  while (length > 0 &&
+         (copied = copy_file_range (infd, &inoff, outfd, &outoff, (size_t)length, 0)) > 0)
+    length -= copied;
+
+  if (copied < 0 && errno != EXDEV && errno != ENOSYS &&
+      errno != EINVAL && errno != EOPNOTSUPP)
+    return -1;
+
+  inoffset = inoff;
+  outoffset = outoff;
+#endif
+
+  while (length > 0)
+  {
+    count = ((size_t)length < buffersize) ? (size_t)length : buffersize;
+
+    if (readrange (infd, buffer, count, inoffset) ||
+        pwritefull (outfd, buffer, count, outoffset))
+      return -1;
+
+    inoffset += count;
+    outoffset += count;
+    length -= count;
+  }
+
+  return 0;
+} /* End of copyrange() */
+
+/***************************************************************************
+ * Read 'length' bytes from a file at 'offset' with ms3_pread(), which
+ * retries short and interrupted reads.
+ *
+ * Returns 0 on success and -1 on error or end of file, with errno set.
+ ***************************************************************************/
+static int
+readrange (int fd, char *buffer, size_t length, int64_t offset)
+{
+  int64_t count = ms3_pread (fd, buffer, length, offset);
+
+  if (count == (int64_t)length)
+    return 0;
+
+  errno = (count < 0) ? (int)-count : EIO;
+  return -1;
+} /* End of readrange() */
+
+/***************************************************************************
+ * Write 'length' bytes to a file at 'offset', retrying short writes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+pwritefull (int fd, const char *buffer, size_t length, int64_t offset)
+{
+  ssize_t count;
+
+  while (length > 0)
+  {
+    if ((count = pwrite (fd, buffer, length, (off_t)offset)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return -1;
+    }
+
+    buffer += count;
+    length -= count;
+    offset += count;
+  }
+
+  return 0;
+} /* End of pwritefull() */
+
+/***************************************************************************
+ * Find the input file entry of a record and open it for reading if not
+ * already done.  URLs and compressed files are read from spool and
+ * members of a tar bundle share the stream of the first member.
+ *
+ * Returns the input file entry on success and NULL on error.
+ ***************************************************************************/
+static Filelink *
+openinput (MS3RecordPtr *recptr)
+{
+  char spoolfile[1024];
+  Filelink *flp;
+
+  /* Find the matching input file entry */
+  for (flp = filelist; flp; flp = flp->next)
+  {
+    if (flp->infilename_raw == recptr->filename)
+      break;
+  }
+
+  if (flp == NULL)
+  {
+    ms_log (2, "Cannot find input file entry for %s\n", recptr->filename);
+    return NULL;
+  }
+
+  if (flp->bundle)
+    flp = flp->bundle;
+
+  if (!flp->infp)
+  {
+    if ((flp->isurl || flp->iscompressed) &&
+        ms3_url_spoolfile (flp->infilename_raw, spoolfile, sizeof (spoolfile)))
+    {
+      ms_log (2, "Cannot find spooled data for '%s'\n", flp->infilename_raw);
+      return NULL;
+    }
+
+    if (!(flp->infp = fopen ((flp->isurl || flp->iscompressed) ? spoolfile : flp->infilename, "rb")))
+    {
+      ms_log (2, "Cannot open '%s' for reading: %s\n",
+              flp->infilename, strerror (errno));
+      return NULL;
+    }
+  }
+
+  return flp;
+} /* End of openinput() */
+
+/***************************************************************************
+ * Read a batch of records from the input files into the read buffer,
+ * starting with the record 'first' and following the record list until
+ * READBATCHRECORDS records are read or the buffer is full.  Records
+ * adjacent in the same input file are read with a single request and
+ * the requests are read with the I/O queue, keeping up to -iodepth
+ * reads in flight.
+ *
+ * The input file entry and the location in the read buffer of each
+ * record are set in batchflp[] and batchrecord[].
+ *
+ * Returns the number of records read on success and -1 on error.
+ ***************************************************************************/
+static int
+readbatch (MS3RecordPtr *first)
+{
+  MS3IORequest *request = NULL;
+  MS3RecordPtr *recptr;
+  size_t used = 0;
+  int reqcount = 0;
+  int count = 0;
+  int idx;
+
+  for (recptr = first; recptr && count < READBATCHRECORDS; recptr = recptr->next)
+  {
+    if ((size_t)recptr->msr->reclen > sizeof (readbuf))
+    {
+      ms_log (2, "Record length (%d bytes) larger than buffer (%llu bytes)\n",
+              recptr->msr->reclen, (long long unsigned int)sizeof (readbuf));
+      return -1;
+    }
+
+    if (used + recptr->msr->reclen > sizeof (readbuf))
+      break;
+
+    if ((batchflp[count] = openinput (recptr)) == NULL)
+      return -1;
+
+    batchrecord[count] = readbuf + used;
+
+    /* Extend the previous request if this record follows it in the same file */
+    if (request && request->fd == fileno (batchflp[count]->infp) &&
+        request->offset + (int64_t)request->length == recptr->fileoffset)
+    {
+      request->length += recptr->msr->reclen;
+    }
+    else
+    {
+      request         = &batchreqs[reqcount++];
+      request->fd     = fileno (batchflp[count]->infp);
+      request->offset = recptr->fileoffset;
+      request->length = recptr->msr->reclen;
+      request->buffer = batchrecord[count];
+    }
+
+    used += recptr->msr->reclen;
+    count++;
+  }
+
+  if (ms3_ioqueue_read (ioqueue, batchreqs, reqcount) != reqcount)
+  {
+    for (idx = 0; idx < reqcount; idx++)
+    {
+      if (batchreqs[idx].result != (int64_t)batchreqs[idx].length)
+        ms_log (2, "Cannot read %llu bytes at offset %" PRId64 ": %s\n",
+                (long long unsigned)batchreqs[idx].length, batchreqs[idx].offset,
+                (batchreqs[idx].result < 0) ? strerror ((int)-batchreqs[idx].result) : "short read");
+    }
+
+    return -1;
+  }
+
+  return count;
+} /* End of readbatch() */
+
+/***************************************************************************
+ * Validate the CRC of a miniSEED 3 record, records of other formats
+ * do not contain a CRC and are considered valid.
+ *
+ * Returns 1 if valid and 0 otherwise.
+ ***************************************************************************/
+static int
+validcrc (char *record, int reclen)
+{
+  uint32_t headercrc;
+  uint32_t crc;
+
+  if (reclen < MS3FSDH_LENGTH || !MS3_ISVALIDHEADER (record))
+    return 1;
+
+  /* Save header CRC, set value to 0, calculate CRC, restore CRC */
+  headercrc = HO4u (*pMS3FSDH_CRC (record), ms_bigendianhost ());
+  memset (pMS3FSDH_CRC (record), 0, sizeof (uint32_t));
+  crc = ms_crc32c ((uint8_t *)record, reclen, 0);
+  *pMS3FSDH_CRC (record) = HO4u (headercrc, ms_bigendianhost ());
+
+  return (crc == headercrc);
+} /* End of validcrc() */
+
+/***************************************************************************
+ * Unpack a data record and trim samples, either from the beginning or
+ * the end, to fit the TimeRange.starttime and TimeRange.endtime boundary
+ * times and pack the record.
+ *
+ * Data samples times are not modified.  The new start and end times
+ * are treated as arbitrary boundaries, not as explicit new start/end
+ * times, this routine calculates which samples fit within the new
+ * boundaries.
+ *
+ * Return 0 on success, -1 on failure or skip and -2 on unpacking errors.
+ ***************************************************************************/
+static int
+trimrecord (MS3RecordPtr *recptr, char *recordbuf, WriterData *writerdata)
+{
+  nstime_t nsperiod;
+  nstime_t ostarttime;
+  TimeRange *newrange;
+
+  char stime[32] = {0};
+  char etime[32] = {0};
+
+  int trimsamples;
+  uint8_t samplesize;
+  char sampletype;
+  int64_t packedsamples;
+  int packedrecords;
+  int retcode;
+
+  if (!recptr || !recordbuf)
+    return -1;
+
+  ostarttime = recptr->msr->starttime;
+  newrange = (TimeRange *)(recptr->prvtptr);
+
+  /* Sanity check for new start/end times */
+  if ((newrange->starttime != NSTUNSET && newrange->endtime != NSTUNSET && newrange->starttime > newrange->endtime) ||
+      (newrange->starttime != NSTUNSET && (newrange->starttime < recptr->msr->starttime || newrange->starttime > recptr->endtime)) ||
+      (newrange->endtime != NSTUNSET && (newrange->endtime > recptr->endtime || newrange->endtime < recptr->msr->starttime)))
+  {
+    ms_log (2, "Problem with new start/end record bound times.\n");
+    ms_log (2, "  Original record %s from %s (byte offset: %llu)\n",
+            "SourceID", writerdata->flp->infilename, (unsigned long long)recptr->fileoffset);
+    ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_nstime2timestr (recptr->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_log (2, "       Start: %s       End: %s\n", stime, etime);
+    if (newrange->starttime == NSTUNSET)
+      strcpy (stime, "NONE");
+    else
+      ms_nstime2timestr (newrange->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+    if (newrange->endtime == NSTUNSET)
+      strcpy (etime, "NONE");
+    else
+      ms_nstime2timestr (newrange->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_log (2, " Start bound: %-24s End bound: %-24s\n", stime, etime);
+
+    return -1;
+  }
+
+  if (ms_encoding_sizetype (recptr->msr->encoding, &samplesize, &sampletype))
+  {
+    ms_log (2, "Cannot determine sample size and type for encoding %d\n", recptr->msr->encoding);
+    return -1;
+  }
+
+  /* Check for supported samples types, can only trim what can be packed */
+  if (sampletype != 'i' && sampletype != 'f' && sampletype != 'd')
+  {
+    if (verbose)
+    {
+      ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+      ms_log (1, "Skipping trim of %s (%s), unsupported encoding (%d: %s)\n",
+              recptr->msr->sid, stime, recptr->msr->encoding, ms_encodingstr (recptr->msr->encoding));
+    }
+
+    return 0;
+  }
+
+  /* Decode data samples */
+  recptr->msr->record = recordbuf;
+  if ((retcode = msr3_unpack_data (recptr->msr, 0)) < 0)
+  {
+    ms_log (2, "Cannot unpack miniSEED record: %s\n", ms_errorstr (retcode));
+
+    return -2;
+  }
+
+  if (verbose > 1)
+  {
+    ms_log (1, "Triming record: %s (%u)\n", recptr->msr->sid, recptr->msr->pubversion);
+    ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_nstime2timestr (recptr->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_log (1, "       Start: %s        End: %s\n", stime, etime);
+    if (newrange->starttime == NSTUNSET)
+      strcpy (stime, "NONE");
+    else
+      ms_nstime2timestr (newrange->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+    if (newrange->endtime == NSTUNSET)
+      strcpy (etime, "NONE");
+    else
+      ms_nstime2timestr (newrange->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+    ms_log (1, " Start bound: %-24s  End bound: %-24s\n", stime, etime);
+  }
+
+  /* Determine sample period in nanosecond time ticks */
+  nsperiod = msr3_nsperiod(recptr->msr);
+
+  /* Remove samples from the beginning of the record */
+  if (newrange->starttime != NSTUNSET && nsperiod)
+  {
+    nstime_t newstarttime;
+
+    /* Determine new start time and the number of samples to trim */
+    trimsamples = (int)ms_trimsamples (recptr->msr->starttime, newrange->starttime, nsperiod,
+                                       recptr->msr->samplecnt, 0, &newstarttime);
+
+    if (trimsamples >= recptr->msr->samplecnt)
+    {
+      if (verbose > 1)
+        ms_log (1, "All samples would be trimmed from record, skipping\n");
+
+      return -1;
+    }
+
+    if (verbose > 2)
+    {
+      ms_nstime2timestr (newstarttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+      ms_log (1, "Removing %d samples from the start, new start time: %s\n", trimsamples, stime);
+    }
+
+    memmove (recptr->msr->datasamples,
+             (char *)recptr->msr->datasamples + (samplesize * trimsamples),
              samplesize * (recptr->msr->numsamples - trimsamples));
 
     recptr->msr->numsamples -= trimsamples;
@@ -897,14 +1922,8 @@ trimrecord (MS3RecordPtr *recptr, char *recordbuf, WriterData *writerdata)
     nstime_t newendtime;
 
     /* Determine new end time and the number of samples to trim */
-    trimsamples = 0;
-    newendtime = recptr->endtime;
-
-    while (newendtime > newrange->endtime && trimsamples < recptr->msr->samplecnt)
-    {
-      newendtime -= nsperiod;
-      trimsamples++;
-    }
+    trimsamples = (int)ms_trimsamples (recptr->endtime, newrange->endtime, nsperiod,
+                                       recptr->msr->samplecnt, 1, &newendtime);
 
     if (trimsamples >= recptr->msr->samplecnt)
     {
@@ -927,28 +1946,30 @@ trimrecord (MS3RecordPtr *recptr, char *recordbuf, WriterData *writerdata)
 
   /* Add the v2 "sequence number" to extra headers so it is included in output */
   if (recptr->msr->formatversion == 2)
+    setsequence (recptr->msr, recordbuf);
+
+  /* Pack the data record into the global record buffer used by writetraces(),
+   * as miniSEED 3 if converting, allowing for the larger header */
+  if (convertv3 && recptr->msr->formatversion == 2)
   {
-    int64_t seqnum = 0;
-    char seqstr[7];
-    char *endptr;
+    int32_t reclen = recptr->msr->reclen;
 
-    memcpy (seqstr, recordbuf, 6);
-    seqstr[6] = '\0';
+    recptr->msr->formatversion = 3;
+    recptr->msr->reclen += MS3FSDH_LENGTH + strlen (recptr->msr->sid) + recptr->msr->extralength;
+    if (recptr->msr->reclen > MAXRECLEN)
+      recptr->msr->reclen = MAXRECLEN;
 
-    seqnum = (int64_t)strtoll (seqstr, &endptr, 10);
+    packedrecords = msr3_pack (recptr->msr, &writerecord, writerdata,
+                               &packedsamples, MSF_FLUSHDATA, verbose - 1);
 
-    if (endptr != seqstr)
-    {
-      if (mseh_set (recptr->msr, "/FDSN/Sequence", &seqnum, 'i'))
-      {
-        ms_log (2, "Cannot set sequence number in extra headers\n");
-      }
-    }
+    recptr->msr->formatversion = 2;
+    recptr->msr->reclen = reclen;
+  }
+  else
+  {
+    packedrecords = msr3_pack (recptr->msr, &writerecord, writerdata,
+                               &packedsamples, MSF_FLUSHDATA, verbose - 1);
   }
-
-  /* Pack the data record into the global record buffer used by writetraces() */
-  packedrecords = msr3_pack (recptr->msr, &writerecord, writerdata,
-                             &packedsamples, MSF_FLUSHDATA, verbose - 1);
 
   if (packedrecords <= 0)
   {
@@ -969,7 +1990,8 @@ trimrecord (MS3RecordPtr *recptr, char *recordbuf, WriterData *writerdata)
 
 /***************************************************************************
  * Used by writetraces() directly, and trimrecord() when called, to save
- * repacked miniSEED to global record buffer.
+ * repacked miniSEED to global record buffer.  When trimming for a
+ * planned output record the record(s) are collected in its buffer.
  ***************************************************************************/
 static void
 writerecord (char *record, int reclen, void *handlerdata)
@@ -980,44 +2002,41 @@ writerecord (char *record, int reclen, void *handlerdata)
   if (!record || reclen <= 0 || !handlerdata)
     return;
 
-  /* Set v3 publication version or v2 data quality indicator */
-  if (setpubver)
+  /* Convert miniSEED 2 to 3, records packed after trimming are already converted */
+  if (convertv3 && !MS3_ISVALIDHEADER (record))
   {
-    if (writerdata->recptr->msr->formatversion == 2)
+    if ((reclen = convertrecord (writerdata->recptr->msr, record)) < 0)
     {
-      unsigned char dataquality;
-
-      if (setpubver == 1)
-        dataquality = 'R';
-      else if (setpubver == 2)
-        dataquality = 'D';
-      else if (setpubver == 3)
-        dataquality = 'Q';
-      else
-        dataquality = 'M';
+      ms_log (2, "Cannot convert %s record to miniSEED 3\n", writerdata->recptr->msr->sid);
+      *writerdata->errflagp = 1;
+      return;
+    }
 
-      if (verbose > 2)
-        ms_log (1, "Setting v2 data quality indicator to '%c'\n", setpubver);
+    record = convertbuf;
+  }
 
-      *pMS2FSDH_DATAQUALITY (recordbuf) = dataquality;
-    }
-    else if (writerdata->recptr->msr->formatversion == 3)
-    {
-      if (verbose > 2)
-        ms_log (1, "Setting publication version to %u\n", setpubver);
+  /* Set v3 publication version or v2 data quality indicator */
+  if (setpubver && setrecordpubver (record, reclen))
+    *writerdata->errflagp = 1;
 
-      *pMS3FSDH_PUBVERSION (record) = setpubver;
+  /* Collect record(s) for a planned output record, written later */
+  if (writerdata->output)
+  {
+    char *buffer;
 
-      /* Recalculate CRC */
-      *pMS3FSDH_CRC (record) = 0;
-      uint32_t crc = ms_crc32c ((uint8_t *)record, reclen, 0);
-      *pMS3FSDH_CRC (record) = HO4u (crc, ms_bigendianhost ());
-    }
-    else
+    if ((buffer = (char *)realloc (writerdata->output->buffer,
+                                   writerdata->output->length + reclen)) == NULL)
     {
-      ms_log (2, "Cannot set publication version for format version %d\n",
-              writerdata->recptr->msr->formatversion);
+      ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+      *writerdata->errflagp = 1;
+      return;
     }
+
+    memcpy (buffer + writerdata->output->length, record, reclen);
+    writerdata->output->buffer = buffer;
+    writerdata->output->length += reclen;
+
+    return;
   }
 
   /* Write to a single output file if specified */
@@ -1028,6 +2047,11 @@ writerecord (char *record, int reclen, void *handlerdata)
       ms_log (2, "Cannot write to '%s'\n", outputfile);
       *writerdata->errflagp = 1;
     }
+    else if (outputdigest &&
+             ds_fileupdate (outputdigest, writerdata->recptr->msr, record, reclen))
+    {
+      *writerdata->errflagp = 1;
+    }
   }
 
   /* Write to Archive(s) if specified and/or add to written list */
@@ -1040,6 +2064,7 @@ writerecord (char *record, int reclen, void *handlerdata)
       {
         if (ds_streamproc (&arch->datastream,
                            writerdata->recptr->msr,
+                           record, reclen,
                            verbose - 1, NULL))
         {
           *writerdata->errflagp = 1;
@@ -1049,34 +2074,96 @@ writerecord (char *record, int reclen, void *handlerdata)
       }
     }
 
-    if (writtenfile)
-    {
-      MS3TraceSeg *seg;
+    if (writtenfile && addwritten (writerdata->recptr->msr, reclen))
+      *writerdata->errflagp = 1;
+  }
+} /* End of writerecord() */
 
-      if ((seg = mstl3_addmsr (writtentl, writerdata->recptr->msr, 0, 0, 0, NULL)) == NULL)
-      {
-        ms_log (2, "Error adding MS3Record to MS3TraceList, bah humbug.\n");
-      }
-      else
-      {
-        if (!seg->prvtptr)
-        {
-          if ((seg->prvtptr = malloc (sizeof (int64_t))) == NULL)
-          {
-            ms_log (2, "Error allocating memory for written count, bah humbug.\n");
-            *writerdata->errflagp = 1;
-          }
-          else
-          {
-            *((int64_t *)seg->prvtptr) = 0;
-          }
-        }
+/***************************************************************************
+ * Set the publication version of a miniSEED 3 record or the data
+ * quality indicator of a miniSEED 2 record to the -Q value.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+setrecordpubver (char *record, int reclen)
+{
+  if (!MS3_ISVALIDHEADER (record))
+  {
+    char dataquality;
+
+    if (setpubver == 1)
+      dataquality = 'R';
+    else if (setpubver == 2)
+      dataquality = 'D';
+    else if (setpubver == 3)
+      dataquality = 'Q';
+    else
+      dataquality = 'M';
 
-        *((int64_t *)seg->prvtptr) += reclen;
-      }
+    if (verbose > 2)
+      ms_log (1, "Setting v2 data quality indicator to '%c'\n", dataquality);
+
+    if (ms3_patchheader (record, reclen, pMS2FSDH_DATAQUALITY (record), &dataquality, 1))
+      return -1;
+  }
+  else
+  {
+    if (verbose > 2)
+      ms_log (1, "Setting publication version to %u\n", setpubver);
+
+    /* Patch header and update CRC for the changed byte */
+    if (ms3_patchheader (record, reclen, pMS3FSDH_PUBVERSION (record), &setpubver, 1))
+      return -1;
+  }
+
+  return 0;
+} /* End of setrecordpubver() */
+
+/***************************************************************************
+ * Convert a miniSEED 2 record to miniSEED 3 by transcoding the header,
+ * including blockettes already mapped to extra headers when parsed,
+ * and copying the encoded data.  The record must be the raw record
+ * parsed into the MS3Record.  The converted record is placed in
+ * convertbuf.
+ *
+ * Returns the length of the converted record on success and -1 on error.
+ ***************************************************************************/
+static int
+convertrecord (MS3Record *msr, char *record)
+{
+  setsequence (msr, record);
+
+  msr->record = record;
+
+  return msr3_repack_mseed3 (msr, convertbuf, sizeof (convertbuf), verbose - 1);
+} /* End of convertrecord() */
+
+/***************************************************************************
+ * Set the sequence number of a raw miniSEED 2 record in the extra
+ * headers of the MS3Record as /FDSN/Sequence, so it is included in
+ * records packed from the MS3Record.
+ ***************************************************************************/
+static void
+setsequence (MS3Record *msr, const char *record)
+{
+  int64_t seqnum = 0;
+  char seqstr[7];
+  char *endptr;
+
+  memcpy (seqstr, record, 6);
+  seqstr[6] = '\0';
+
+  seqnum = (int64_t)strtoll (seqstr, &endptr, 10);
+
+  if (endptr != seqstr)
+  {
+    if (mseh_set (msr, "/FDSN/Sequence", &seqnum, 'i'))
+    {
+      ms_log (2, "Cannot set sequence number in extra headers\n");
     }
   }
-} /* End of writerecord() */
+} /* End of setsequence() */
 
 /***************************************************************************
  * Prune all redundant data from the records list entries associated with
@@ -1094,6 +2181,7 @@ static int
 prunetraces (MS3TraceList *mstl)
 {
   MS3TraceID *id = NULL;
+  MS3TraceID *groupid = NULL;
   MS3TraceSeg *seg = NULL;
   Coverage *coverage = NULL;
   int retval;
@@ -1113,11 +2201,15 @@ prunetraces (MS3TraceList *mstl)
   id = mstl->traces.next[0];
   while (id)
   {
+    /* IDs with the same SourceID are adjacent, track first of each group */
+    if (!groupid || groupid->sidhandle != id->sidhandle)
+      groupid = id;
+
     seg = id->first;
     while (seg)
     {
       /* Determine overlapping trace coverage */
-      retval = findcoverage (mstl, id, seg, &coverage);
+      retval = findcoverage (groupid, id, seg, &coverage);
 
       if (retval)
       {
@@ -1151,7 +2243,8 @@ prunetraces (MS3TraceList *mstl)
 } /* End of prunetraces() */
 
 /***************************************************************************
- * Search an MS3TraceList for entries that overlap the target MS3TraceSeg
+ * Search the MS3TraceIDs of a SourceID group, starting with the first
+ * ID of the group, for entries that overlap the target MS3TraceSeg
  * and, from the record entries of the overlapping MS3TraceSegs, build a
  * coverage list.
  *
@@ -1170,21 +2263,16 @@ prunetraces (MS3TraceList *mstl)
  * Returns 0 on success and -1 on error.
  ***************************************************************************/
 static int
-findcoverage (MS3TraceList *mstl, MS3TraceID *targetid, MS3TraceSeg *targetseg,
+findcoverage (MS3TraceID *groupid, MS3TraceID *targetid, MS3TraceSeg *targetseg,
               Coverage **ppcoverage)
 {
   MS3TraceID *id = NULL;
   MS3TraceSeg *seg = NULL;
-  MS3RecordPtr *recptr;
   Coverage *coverage = NULL;
-  Coverage *prevcoverage = NULL;
-  TimeRange *newrange;
   nstime_t nsperiod, nstimetol;
-  nstime_t effstarttime, effendtime;
   int priority;
-  int newsegment;
 
-  if (!mstl || !targetid || !targetseg || !ppcoverage)
+  if (!groupid || !targetid || !targetseg || !ppcoverage)
     return -1;
 
   *ppcoverage = NULL;
@@ -1195,20 +2283,10 @@ findcoverage (MS3TraceList *mstl, MS3TraceID *targetid, MS3TraceSeg *targetseg,
   /* Determine time tolerance in high precision time ticks */
   nstimetol = (timetol == -1.0) ? (nsperiod / 2) : (nstime_t)(NSTMODULUS * timetol);
 
-  /* Loop through each MS3TraceID in the list */
-  id = mstl->traces.next[0];
-  while (id)
+  /* Loop through each MS3TraceID in the group with the same SourceID */
+  id = groupid;
+  while (id && id->sidhandle == targetid->sidhandle)
   {
-    /* Continue with next if SourceID is different */
-    if (targetid != id)
-    {
-      if (strcmp (id->sid, targetid->sid))
-      {
-        id = id->next[0];
-        continue;
-      }
-    }
-
     seg = id->first;
     while (seg)
     {
@@ -1285,70 +2363,130 @@ findcoverage (MS3TraceList *mstl, MS3TraceID *targetid, MS3TraceSeg *targetseg,
         /* If overlapping trace is a higher priority than targetseg add to coverage */
         if (priority == -1)
         {
-          /* Loop through list of records, and determine contiguous coverage */
-          recptr = seg->recordlist->first;
-          newsegment = 1;
-          while (recptr)
-          {
-            /* Check if record has been marked as non-contributing */
-            if (recptr->msr->reclen == 0)
-            {
-              recptr = recptr->next;
-              continue;
-            }
+          if (addcoverage (RECINDEX (seg->recordlist->first), seg->recordlist->recordcnt,
+                           id->pubversion, seg->samprate, nsperiod, nstimetol,
+                           &coverage, ppcoverage))
+            return -1;
+        }
+      }
 
-            newrange = (TimeRange *)recptr->prvtptr;
+      seg = seg->next;
+    }
 
-            /* Determine effective record start and end times */
-            effstarttime = (newrange && newrange->starttime != NSTUNSET) ? newrange->starttime : recptr->msr->starttime;
-            effendtime = (newrange && newrange->endtime != NSTUNSET) ? newrange->endtime : recptr->endtime;
+    id = id->next[0];
+  }
 
-            /* Create a new segment if a break in the time-series is detected */
-            if (coverage)
-              if (llabs ((coverage->endtime + nsperiod) - effstarttime) > nstimetol)
-                newsegment = 1;
+  return 0;
+} /* End of findcoverage() */
 
-            if (newsegment)
-            {
-              newsegment = 0;
+/***************************************************************************
+ * Add the contiguous coverage of a run of records in the record table
+ * to a coverage list.  Records marked as non-contributing are skipped
+ * and the first contributing record always starts a new entry.
+ *
+ * Breaks in the time-series are flagged for all records in one pass over
+ * the time columns before any entries are created.  Without removed
+ * records, the common case, this pass has no branches and can be
+ * vectorized by the compiler.
+ *
+ * The last entry in the list is tracked in *pcoverage, new entries are
+ * appended to it or set as the list head at *ppcoverage.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addcoverage (uint64_t first, uint64_t count, uint8_t pubversion, double samprate,
+             nstime_t nsperiod, nstime_t nstimetol,
+             Coverage **pcoverage, Coverage **ppcoverage)
+{
+  const nstime_t *effstart;
+  const nstime_t *effend;
+  const uint8_t *removed;
+  uint8_t *breaks;
+  Coverage *coverage;
+  nstime_t gap;
+  uint64_t idx;
+  uint64_t prev;
+  uint8_t anyremoved = 0;
+
+  if (count == 0 || first + count > rectable.count)
+    return 0;
 
-              prevcoverage = coverage;
+  effstart = rectable.effstart + first;
+  effend = rectable.effend + first;
+  removed = rectable.removed + first;
+  breaks = rectable.breaks + first;
 
-              if ((coverage = (Coverage *)malloc (sizeof (Coverage))) == NULL)
-              {
-                ms_log (2, "Cannot allocate memory for coverage, bah humbug.\n");
-                return -1;
-              }
+  for (idx = 0; idx < count; idx++)
+    anyremoved |= removed[idx];
 
-              if (*ppcoverage == NULL)
-                *ppcoverage = coverage;
-              else
-                prevcoverage->next = coverage;
+  if (!anyremoved)
+  {
+    /* Flag breaks between adjacent records */
+    breaks[0] = 1;
+    for (idx = 1; idx < count; idx++)
+    {
+      gap = effend[idx - 1] + nsperiod - effstart[idx];
+      breaks[idx] = (gap > nstimetol) | (gap < -nstimetol);
+    }
+  }
+  else
+  {
+    /* Flag breaks between adjacent contributing records */
+    prev = count;
+    for (idx = 0; idx < count; idx++)
+    {
+      breaks[idx] = 0;
 
-              coverage->pubversion = id->pubversion;
-              coverage->samprate = seg->samprate;
-              coverage->starttime = effstarttime;
-              coverage->next = NULL;
-            }
+      if (removed[idx])
+        continue;
 
-            if (coverage)
-              coverage->endtime = effendtime;
-            else
-              ms_log (2, "ACK! covergage is not allocated!?  PLEASE REPORT\n");
+      if (prev == count)
+      {
+        breaks[idx] = 1;
+      }
+      else
+      {
+        gap = effend[prev] + nsperiod - effstart[idx];
+        breaks[idx] = (gap > nstimetol) | (gap < -nstimetol);
+      }
 
-            recptr = recptr->next;
-          }
-        }
+      prev = idx;
+    }
+  }
+
+  /* Add an entry for each contiguous run of records */
+  for (idx = 0; idx < count; idx++)
+  {
+    if (removed[idx])
+      continue;
+
+    if (breaks[idx])
+    {
+      if ((coverage = (Coverage *)malloc (sizeof (Coverage))) == NULL)
+      {
+        ms_log (2, "Cannot allocate memory for coverage, bah humbug.\n");
+        return -1;
       }
 
-      seg = seg->next;
+      if (*ppcoverage == NULL)
+        *ppcoverage = coverage;
+      else
+        (*pcoverage)->next = coverage;
+
+      coverage->pubversion = pubversion;
+      coverage->samprate = samprate;
+      coverage->starttime = effstart[idx];
+      coverage->next = NULL;
+
+      *pcoverage = coverage;
     }
 
-    id = id->next[0];
+    (*pcoverage)->endtime = effend[idx];
   }
 
   return 0;
-} /* End of findcoverage() */
+} /* End of addcoverage() */
 
 /***************************************************************************
  * Adjust Record entries associated with the target MS3TraceSeg that
@@ -1372,6 +2510,7 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
   MS3RecordPtr *recptr;
   TimeRange *newrange;
   Coverage *cov;
+  uint64_t recindex;
   nstime_t effstarttime, effendtime;
   nstime_t nsperiod, nstimetol;
   char stime[32] = {0};
@@ -1392,17 +2531,17 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
   recptr = targetseg->recordlist->first;
   while (recptr)
   {
+    recindex = RECINDEX (recptr);
+
     cov = coverage;
     while (cov)
     {
-      if (!recptr->msr->reclen) /* Skip if marked non-contributing */
+      if (rectable.removed[recindex]) /* Skip if marked non-contributing */
         break;
 
-      newrange = (TimeRange *)recptr->prvtptr;
-
-      /* Determine effective record start and end times for comparison */
-      effstarttime = (newrange && newrange->starttime != NSTUNSET) ? newrange->starttime : recptr->msr->starttime;
-      effendtime = (newrange && newrange->endtime != NSTUNSET) ? newrange->endtime : recptr->endtime;
+      /* Effective record start and end times for comparison */
+      effstarttime = rectable.effstart[recindex];
+      effendtime = rectable.effend[recindex];
 
       /* Mark record if it is completely overlapped by the coverage including tolerance */
       if (effstarttime >= (cov->starttime - nstimetol) &&
@@ -1418,32 +2557,21 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
         }
 
         recptr->msr->reclen = 0;
+        rectable.removed[recindex] = 1;
         modcount++;
       }
 
       /* Determine the new start/end times if pruning at the sample level */
-      if (prunedata == 's' && recptr->msr->reclen != 0)
+      if (prunedata == 's' && !rectable.removed[recindex])
       {
         /* Record intersects beginning of coverage */
         if (effstarttime < cov->starttime &&
             (effendtime + nstimetol) >= cov->starttime)
         {
-          if (recptr->prvtptr == NULL)
-          {
-            if ((recptr->prvtptr = (TimeRange *)malloc (sizeof (TimeRange))) == NULL)
-            {
-              ms_log (2, "Cannot allocate memory for TimeRange, bah humbug.\n");
-              return -1;
-            }
-
-            ((TimeRange *)recptr->prvtptr)->starttime = NSTUNSET;
-            ((TimeRange *)recptr->prvtptr)->endtime = NSTUNSET;
-          }
-
           newrange = (TimeRange *)recptr->prvtptr;
 
           /* Set new end time boundary including specified time tolerance */
-          newrange->endtime = cov->starttime - nsperiod + nstimetol;
+          rectable.effend[recindex] = newrange->endtime = cov->starttime - nsperiod + nstimetol;
 
           if (newrange->starttime != NSTUNSET && newrange->endtime < newrange->starttime)
           {
@@ -1456,6 +2584,7 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
             }
 
             recptr->msr->reclen = 0;
+            rectable.removed[recindex] = 1;
             modcount++;
           }
           else
@@ -1469,22 +2598,10 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
         if ((effstarttime - nstimetol) <= cov->endtime &&
             effendtime > cov->endtime)
         {
-          if (recptr->prvtptr == NULL)
-          {
-            if ((recptr->prvtptr = (TimeRange *)malloc (sizeof (TimeRange))) == NULL)
-            {
-              ms_log (2, "Cannot allocate memory for TimeRange, bah humbug.\n");
-              return -1;
-            }
-
-            ((TimeRange *)recptr->prvtptr)->starttime = NSTUNSET;
-            ((TimeRange *)recptr->prvtptr)->endtime = NSTUNSET;
-          }
-
           newrange = (TimeRange *)recptr->prvtptr;
 
           /* Set Record new start time boundary including specified time tolerance */
-          newrange->starttime = cov->endtime + nsperiod - nstimetol;
+          rectable.effstart[recindex] = newrange->starttime = cov->endtime + nsperiod - nstimetol;
 
           if (newrange->endtime != NSTUNSET && newrange->starttime > newrange->endtime)
           {
@@ -1497,6 +2614,7 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
             }
 
             recptr->msr->reclen = 0;
+            rectable.removed[recindex] = 1;
             modcount++;
           }
           else
@@ -1524,6 +2642,7 @@ trimtrace (MS3TraceSeg *targetseg, const char *targetsourceid, Coverage *coverag
           }
 
           recptr->msr->reclen = 0;
+          rectable.removed[recindex] = 1;
           modcount++;
         }
 
@@ -1638,6 +2757,7 @@ printtracelist (MS3TraceList *mstl, uint8_t details)
   TimeRange *newrange = NULL;
   char stime[32] = {0};
   char etime[32] = {0};
+  MSDayCache daycache = MSDayCache_INITIALIZER;
   int segcnt = 0;
 
   if (!mstl)
@@ -1654,10 +2774,10 @@ printtracelist (MS3TraceList *mstl, uint8_t details)
     while (seg)
     {
       /* Create formatted time strings */
-      if (ms_nstime2timestr (seg->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
+      if (ms_nstime2timestr_cached (seg->starttime, &daycache, stime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
         ms_log (2, "Cannot convert trace start time for %s\n", id->sid);
 
-      if (ms_nstime2timestr (seg->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
+      if (ms_nstime2timestr_cached (seg->endtime, &daycache, etime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
         ms_log (2, "Cannot convert trace end time for %s\n", id->sid);
 
       /* Print MS3TraceSeg header */
@@ -1677,22 +2797,24 @@ printtracelist (MS3TraceList *mstl, uint8_t details)
                   (recptr->filename) ? recptr->filename : "NONE", recptr->fileoffset,
                   recptr->msr->reclen, recptr->msr->pubversion);
 
-          ms_nstime2timestr (recptr->msr->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
-          ms_nstime2timestr (recptr->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+          ms_nstime2timestr_cached (recptr->msr->starttime, &daycache, stime, ISOMONTHDAY_Z, NANO_MICRO);
+          ms_nstime2timestr_cached (recptr->endtime, &daycache, etime, ISOMONTHDAY_Z, NANO_MICRO);
           ms_log (0, "        Start: %s        End: %s\n", stime, etime);
 
-          if (details && recptr->prvtptr != NULL)
+          newrange = (TimeRange *)recptr->prvtptr;
+
+          if (details && newrange &&
+              (newrange->starttime != NSTUNSET || newrange->endtime != NSTUNSET))
           {
-            newrange = (TimeRange *)recptr->prvtptr;
 
             if (newrange->starttime == NSTUNSET)
               strcpy (stime, "NONE");
             else
-              ms_nstime2timestr (newrange->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO);
+              ms_nstime2timestr_cached (newrange->starttime, &daycache, stime, ISOMONTHDAY_Z, NANO_MICRO);
             if (newrange->endtime == NSTUNSET)
               strcpy (etime, "NONE");
             else
-              ms_nstime2timestr (newrange->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO);
+              ms_nstime2timestr_cached (newrange->endtime, &daycache, etime, ISOMONTHDAY_Z, NANO_MICRO);
 
             ms_log (0, " Select start: %-24s Select end: %-24s\n", stime, etime);
           }
@@ -1712,21 +2834,220 @@ printtracelist (MS3TraceList *mstl, uint8_t details)
 
 } /* End of printtracelist() */
 
+/***************************************************************************
+ * Add an output record to the written summary.
+ *
+ * Records are written grouped by source ID, so the summary for an ID
+ * is complete when the next ID starts and only the last ID is
+ * searched.  Within an ID records are written in time order and
+ * nearly always extend the last segment or start a new one after it.
+ * Segments are otherwise matched and ordered as mstl3_addmsr() does
+ * without healing, merging publication versions, with a tolerance of
+ * 1/2 sample period.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addwritten (MS3Record *msr, int reclen)
+{
+  WrittenID *wid;
+  WrittenSeg *seg;
+  WrittenSeg swap;
+  nstime_t endtime;
+  nstime_t nsperiod;
+  nstime_t nstimetol;
+  nstime_t nnstimetol;
+  nstime_t gap;
+  double sampratehz;
+  uint32_t idx;
+  uint32_t insert;
+  int8_t whence = 0;
+
+  if ((endtime = msr3_endtime (msr)) == NSTERROR)
+  {
+    ms_log (2, "Error calculating record end time\n");
+    return -1;
+  }
+
+  nsperiod = msr3_nsperiod (msr);
+  nstimetol = (nstime_t)(0.5 * nsperiod);
+  nnstimetol = (nstimetol) ? -nstimetol : 0;
+  sampratehz = msr3_sampratehz (msr);
+
+  /* Start a new ID when the source ID changes */
+  if (!writtencount || strcmp (writtenids[writtencount - 1].sid, msr->sid))
+  {
+    if (writtencount == writtenmax)
+    {
+      uint32_t newmax = (writtenmax) ? writtenmax * 2 : 64;
+      WrittenID *newids = realloc (writtenids, newmax * sizeof (WrittenID));
+
+      if (!newids)
+      {
+        ms_log (2, "Cannot allocate memory for written summary\n");
+        return -1;
+      }
+
+      writtenids = newids;
+      writtenmax = newmax;
+    }
+
+    wid = &writtenids[writtencount++];
+    memset (wid, 0, sizeof (WrittenID));
+    memcpy (wid->sid, msr->sid, sizeof (wid->sid));
+    wid->pubversion = msr->pubversion;
+    wid->earliest = msr->starttime;
+    wid->latest = endtime;
+    insert = 0;
+  }
+  else
+  {
+    wid = &writtenids[writtencount - 1];
+    seg = &wid->segs[wid->numsegments - 1];
+    gap = msr->starttime - seg->endtime - nsperiod;
+    insert = wid->numsegments;
+
+    /* Record fits at end of last segment */
+    if (gap <= nstimetol && gap >= nnstimetol &&
+        MS_ISRATETOLERABLE (sampratehz, seg->samprate))
+    {
+      idx = wid->numsegments - 1;
+      whence = 1;
+    }
+    /* Record is after all other coverage */
+    else if ((msr->starttime - nsperiod - nstimetol) > wid->latest)
+    {
+      insert = wid->numsegments;
+    }
+    /* Record is before all other coverage */
+    else if ((endtime + nsperiod + nstimetol) < wid->earliest)
+    {
+      insert = 0;
+    }
+    /* Search segments for one to extend, otherwise insert after the
+     * segment with the latest start time before the record */
+    else
+    {
+      insert = 0;
+      for (idx = 0; idx < wid->numsegments; idx++)
+      {
+        seg = &wid->segs[idx];
+
+        if (msr->starttime > seg->starttime)
+          insert = idx + 1;
+
+        if (!MS_ISRATETOLERABLE (sampratehz, seg->samprate))
+          continue;
+
+        gap = msr->starttime - seg->endtime - nsperiod;
+        if (gap <= nstimetol && gap >= nnstimetol)
+        {
+          whence = 1;
+          break;
+        }
+
+        gap = seg->starttime - endtime - nsperiod;
+        if (gap <= nstimetol && gap >= nnstimetol)
+        {
+          whence = 2;
+          break;
+        }
+      }
+    }
+
+    if (msr->pubversion > wid->pubversion)
+      wid->pubversion = msr->pubversion;
+
+    if (msr->starttime < wid->earliest)
+      wid->earliest = msr->starttime;
+
+    if (endtime > wid->latest)
+      wid->latest = endtime;
+  }
+
+  /* Extend matching segment */
+  if (whence)
+  {
+    seg = &wid->segs[idx];
+
+    if (whence == 1)
+      seg->endtime = endtime;
+    else
+      seg->starttime = msr->starttime;
+  }
+  /* Insert new segment */
+  else
+  {
+    if (wid->numsegments == wid->maxsegments)
+    {
+      uint32_t newmax = (wid->maxsegments) ? wid->maxsegments * 2 : 4;
+      WrittenSeg *newsegs = realloc (wid->segs, newmax * sizeof (WrittenSeg));
+
+      if (!newsegs)
+      {
+        ms_log (2, "Cannot allocate memory for written summary\n");
+        return -1;
+      }
+
+      wid->segs = newsegs;
+      wid->maxsegments = newmax;
+    }
+
+    idx = insert;
+    memmove (&wid->segs[idx + 1], &wid->segs[idx],
+             (wid->numsegments - idx) * sizeof (WrittenSeg));
+    wid->numsegments++;
+
+    seg = &wid->segs[idx];
+    seg->starttime = msr->starttime;
+    seg->endtime = endtime;
+    seg->samprate = sampratehz;
+    seg->samplecnt = 0;
+    seg->bytecount = 0;
+  }
+
+  seg->samplecnt += msr->samplecnt;
+  seg->bytecount += reclen;
+
+  /* Keep segments ordered by start time, longest first for equal start times */
+  while (idx + 1 < wid->numsegments &&
+         (wid->segs[idx].starttime > wid->segs[idx + 1].starttime ||
+          (wid->segs[idx].starttime == wid->segs[idx + 1].starttime &&
+           wid->segs[idx].endtime < wid->segs[idx + 1].endtime)))
+  {
+    swap = wid->segs[idx];
+    wid->segs[idx] = wid->segs[idx + 1];
+    wid->segs[++idx] = swap;
+  }
+  while (idx > 0 &&
+         (wid->segs[idx].starttime < wid->segs[idx - 1].starttime ||
+          (wid->segs[idx].starttime == wid->segs[idx - 1].starttime &&
+           wid->segs[idx].endtime > wid->segs[idx - 1].endtime)))
+  {
+    swap = wid->segs[idx];
+    wid->segs[idx] = wid->segs[idx - 1];
+    wid->segs[--idx] = swap;
+  }
+
+  return 0;
+} /* End of addwritten() */
+
 /***************************************************************************
  * Print summary of output records.
  ***************************************************************************/
 static void
-printwritten (MS3TraceList *mstl)
+printwritten (void)
 {
-  MS3TraceID *id = NULL;
-  MS3TraceSeg *seg = NULL;
-  char stime[32] = {0};
-  char etime[32] = {0};
+  WrittenID *wid;
+  WrittenSeg *seg;
+  nstime_t *times = NULL;
+  char *timestrs = NULL;
+  char *stime;
+  char *etime;
+  uint32_t maxsegments = 0;
+  uint32_t idx;
   FILE *ofp;
 
-  if (!mstl)
-    return;
-
   if (strcmp (writtenfile, "-") == 0)
   {
     ofp = stdout;
@@ -1742,32 +3063,51 @@ printwritten (MS3TraceList *mstl)
     return;
   }
 
-  /* Loop through trace list */
-  id = mstl->traces.next[0];
-  while (id)
+  /* Loop through IDs, formatting the start and end times of all segments together */
+  for (wid = writtenids; wid < writtenids + writtencount; wid++)
   {
-    /* Loop through segment list */
-    seg = id->first;
-    while (seg)
+    if (wid->numsegments > maxsegments)
     {
-      if (ms_nstime2timestr (seg->starttime, stime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
-        ms_log (2, "Cannot convert trace start time for %s\n", id->sid);
+      maxsegments = wid->numsegments;
+      free (times);
+      free (timestrs);
 
-      if (ms_nstime2timestr (seg->endtime, etime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
-        ms_log (2, "Cannot convert trace end time for %s\n", id->sid);
+      if ((times = malloc (2 * maxsegments * sizeof (nstime_t))) == NULL ||
+          (timestrs = malloc (2 * maxsegments * TIMESTRLEN)) == NULL)
+      {
+        ms_log (2, "Cannot allocate memory for written summary times\n");
+        break;
+      }
+    }
 
-      fprintf (ofp, "%s%s|%u|%s|%s|%" PRId64 "|%" PRId64 "\n",
-               (writtenprefix) ? writtenprefix : "",
-               id->sid, id->pubversion, stime, etime,
-               *((int64_t *)seg->prvtptr),
-               seg->samplecnt);
+    for (idx = 0; idx < wid->numsegments; idx++)
+    {
+      times[2 * idx] = wid->segs[idx].starttime;
+      times[2 * idx + 1] = wid->segs[idx].endtime;
+    }
 
-      seg = seg->next;
+    if (ms_nstime2timestr_bulk (times, 2 * wid->numsegments, timestrs, TIMESTRLEN,
+                                ISOMONTHDAY_Z, NANO_MICRO) < 0)
+    {
+      ms_log (2, "Cannot convert trace times for %s\n", wid->sid);
+      continue;
     }
 
-    id = id->next[0];
+    for (idx = 0, seg = wid->segs; idx < wid->numsegments; idx++, seg++)
+    {
+      stime = timestrs + (2 * idx) * TIMESTRLEN;
+      etime = timestrs + (2 * idx + 1) * TIMESTRLEN;
+
+      fprintf (ofp, "%s%s|%u|%s|%s|%" PRId64 "|%" PRId64 "\n",
+               (writtenprefix) ? writtenprefix : "",
+               wid->sid, wid->pubversion, stime, etime,
+               seg->bytecount, seg->samplecnt);
+    }
   }
 
+  free (times);
+  free (timestrs);
+
   if (ofp != stdout && fclose (ofp))
     ms_log (2, "Cannot close output file: %s (%s)\n",
             writtenfile, strerror (errno));
@@ -1775,146 +3115,259 @@ printwritten (MS3TraceList *mstl)
 } /* End of printwritten() */
 
 /***************************************************************************
- * Sort a record list so that records are in time order using a
- * mergesort algorithm.
+ * Print manifest of output files, one line per file with the path,
+ * byte count, record count, CRC32C digest, time span and SIDs of the
+ * records written.  Digests are computed as records are written.
+ ***************************************************************************/
+static void
+printmanifest (void)
+{
+  DataStreamFile *file;
+  Archive *arch;
+  char stime[32] = {0};
+  char etime[32] = {0};
+  MSDayCache daycache = MSDayCache_INITIALIZER;
+  FILE *ofp;
+
+  if (strcmp (manifestfile, "-") == 0)
+  {
+    ofp = stdout;
+  }
+  else if (strcmp (manifestfile, "--") == 0)
+  {
+    ofp = stderr;
+  }
+  else if ((ofp = fopen (manifestfile, "ab")) == NULL)
+  {
+    ms_log (2, "Cannot open output file: %s (%s)\n",
+            manifestfile, strerror (errno));
+    return;
+  }
+
+  /* Single output file followed by files of each archive */
+  file = outputdigest;
+  arch = archiveroot;
+  while (file || arch)
+  {
+    if (!file)
+    {
+      file = arch->datastream.fileroot;
+      arch = arch->next;
+      continue;
+    }
+
+    stime[0] = etime[0] = '\0';
+
+    if (file->records)
+    {
+      if (ms_nstime2timestr_cached (file->starttime, &daycache, stime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
+        ms_log (2, "Cannot convert start time for %s\n", file->path);
+
+      if (ms_nstime2timestr_cached (file->endtime, &daycache, etime, ISOMONTHDAY_Z, NANO_MICRO) == NULL)
+        ms_log (2, "Cannot convert end time for %s\n", file->path);
+    }
+
+    fprintf (ofp, "%s%s|%" PRIu64 "|%" PRIu64 "|%08" PRIx32 "|%s|%s|%s\n",
+             (writtenprefix) ? writtenprefix : "",
+             file->path, file->bytes, file->records, file->crc32c,
+             stime, etime, (file->sids) ? file->sids : "");
+
+    file = file->next;
+  }
+
+  if (ofp != stdout && fclose (ofp))
+    ms_log (2, "Cannot close output file: %s (%s)\n",
+            manifestfile, strerror (errno));
+
+} /* End of printmanifest() */
+
+/***************************************************************************
+ * Sort a record list so that records are in time order, records with
+ * the same effective start time are kept in list order.
  *
- * The mergesort implementation was inspired by the listsort function
- * published and copyright 2001 by Simon Tatham.
+ * Effective start times and record pointers are gathered into an
+ * array.  A list already in time order is left as is, a list of few
+ * ordered runs, e.g. concatenated segment lists, is sorted by merging
+ * the runs and otherwise an LSD radix sort of the start times is used.
+ * The list is then relinked in sorted order.
  *
  * Return 0 on success and -1 on error.
  ***************************************************************************/
 static int
 sortrecordlist (MS3RecordList *reclist)
 {
-  MS3RecordPtr *p, *q, *e, *top, *tail;
-  int nmerges;
-  int insize, psize, qsize, i;
+  uint64_t counts[8][256];
+  uint64_t offset;
+  uint64_t total;
+  SortKey *keys = NULL;
+  SortKey *temp = NULL;
+  SortKey *swap;
+  MS3RecordPtr *recptr;
+  TimeRange *newrange;
+  nstime_t starttime;
+  size_t count = 0;
+  size_t runs = 1;
+  size_t idx;
+  int mergepasses;
+  int radixpasses = 0;
+  int byte;
+
+  if (reclist == NULL)
+    return -1;
+
+  /* Done if no records in list */
+  if (reclist->recordcnt == 0)
+    return 0;
+
+  if ((keys = (SortKey *)malloc (reclist->recordcnt * sizeof (SortKey))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return -1;
+  }
+
+  /* Gather effective start times, counting ordered runs */
+  for (recptr = reclist->first; recptr; recptr = recptr->next)
+  {
+    if (count >= reclist->recordcnt)
+    {
+      ms_log (2, "%s(): Record list is longer than record count\n", __func__);
+      free (keys);
+      return -1;
+    }
+
+    newrange = (TimeRange *)recptr->prvtptr;
+    starttime = (newrange && newrange->starttime != NSTUNSET) ? newrange->starttime : recptr->msr->starttime;
+
+    /* Flip sign bit to order signed times as unsigned keys */
+    keys[count].key = (uint64_t)starttime ^ (UINT64_C (1) << 63);
+    keys[count].recptr = recptr;
+
+    if (count > 0 && keys[count].key < keys[count - 1].key)
+      runs++;
+
+    count++;
+  }
+
+  /* Nothing to do if already in order */
+  if (runs == 1)
+  {
+    free (keys);
+    return 0;
+  }
 
-  if (reclist == NULL)
+  if ((temp = (SortKey *)malloc (count * sizeof (SortKey))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    free (keys);
     return -1;
+  }
 
-  /* Done if no records in list */
-  if (reclist->recordcnt == 0)
-    return 0;
+  /* Count key bytes for all radix passes, passes where all keys have the
+   * same byte value are skipped */
+  memset (counts, 0, sizeof (counts));
+  for (idx = 0; idx < count; idx++)
+    for (byte = 0; byte < 8; byte++)
+      counts[byte][(keys[idx].key >> (byte * 8)) & 0xff]++;
 
-  top = reclist->first;
-  insize = 1;
+  for (byte = 0; byte < 8; byte++)
+    if (counts[byte][(keys[0].key >> (byte * 8)) & 0xff] != count)
+      radixpasses++;
 
-  for (;;)
-  {
-    p = top;
-    top = NULL;
-    tail = NULL;
+  for (mergepasses = 0; ((size_t)1 << mergepasses) < runs; mergepasses++)
+    ;
 
-    nmerges = 0; /* count number of merges we do in this pass */
+  /* Merge runs if fewer passes are needed than for radix sort */
+  if (mergepasses <= radixpasses)
+  {
+    while (runs > 1)
+    {
+      runs = mergeruns (keys, temp, count);
 
-    while (p)
+      swap = keys;
+      keys = temp;
+      temp = swap;
+    }
+  }
+  else
+  {
+    for (byte = 0; byte < 8; byte++)
     {
-      nmerges++; /* there exists a merge to be done */
+      if (counts[byte][(keys[0].key >> (byte * 8)) & 0xff] == count)
+        continue;
 
-      /* step `insize' places along from p */
-      q = p;
-      psize = 0;
-      for (i = 0; i < insize; i++)
+      /* Convert counts to bucket offsets and distribute keys, stable within buckets */
+      for (offset = 0, idx = 0; idx < 256; idx++)
       {
-        psize++;
-        q = q->next;
-        if (!q)
-          break;
+        total = counts[byte][idx];
+        counts[byte][idx] = offset;
+        offset += total;
       }
 
-      /* if q hasn't fallen off end, we have two lists to merge */
-      qsize = insize;
-
-      /* now we have two lists; merge them */
-      while (psize > 0 || (qsize > 0 && q))
-      {
-        /* decide whether next element of merge comes from p or q */
-        if (psize == 0)
-        { /* p is empty; e must come from q. */
-          e = q;
-          q = q->next;
-          qsize--;
-        }
-        else if (qsize == 0 || !q)
-        { /* q is empty; e must come from p. */
-          e = p;
-          p = p->next;
-          psize--;
-        }
-        else if (recordcmp (p, q) <= 0)
-        { /* First element of p is lower (or same), e must come from p. */
-          e = p;
-          p = p->next;
-          psize--;
-        }
-        else
-        { /* First element of q is lower; e must come from q. */
-          e = q;
-          q = q->next;
-          qsize--;
-        }
-
-        /* add the next element to the merged list */
-        if (tail)
-          tail->next = e;
-        else
-          top = e;
-
-        tail = e;
-      }
+      for (idx = 0; idx < count; idx++)
+        temp[counts[byte][(keys[idx].key >> (byte * 8)) & 0xff]++] = keys[idx];
 
-      /* now p has stepped `insize' places along, and q has too */
-      p = q;
+      swap = keys;
+      keys = temp;
+      temp = swap;
     }
+  }
 
-    tail->next = NULL;
+  /* Relink list in sorted order */
+  for (idx = 0; idx + 1 < count; idx++)
+    keys[idx].recptr->next = keys[idx + 1].recptr;
 
-    /* If we have done only one merge, we're finished. */
-    if (nmerges <= 1) /* allow for nmerges==0, the empty list case */
-    {
-      reclist->first = top;
-      reclist->last = tail;
+  keys[count - 1].recptr->next = NULL;
+  reclist->first = keys[0].recptr;
+  reclist->last = keys[count - 1].recptr;
 
-      return 0;
-    }
+  free (keys);
+  free (temp);
 
-    /* Otherwise repeat, merging lists twice the size */
-    insize *= 2;
-  }
+  return 0;
 } /* End of sortrecordlist() */
 
 /***************************************************************************
- * Compare the start times of each Record for the purposes of sorting
- * a record list.
+ * Merge pairs of adjacent ordered runs of sort keys into temp, keys
+ * from the earlier run are first when equal.
  *
- * Return 1 if rec1 is "greater" than rec2, otherwise return 0.
+ * Return the number of ordered runs in temp.
  ***************************************************************************/
-static int
-recordcmp (MS3RecordPtr *rec1, MS3RecordPtr *rec2)
+static size_t
+mergeruns (SortKey *keys, SortKey *temp, size_t count)
 {
-  TimeRange *newrange1;
-  TimeRange *newrange2;
-  nstime_t start1;
-  nstime_t start2;
-
-  if (!rec1 || !rec2)
-    return -1;
-
-  /* Determine effective start times */
-  newrange1 = (TimeRange *)rec1->prvtptr;
-  start1 = (newrange1 && newrange1->starttime != NSTUNSET) ? newrange1->starttime : rec1->msr->starttime;
-
-  newrange2 = (TimeRange *)rec2->prvtptr;
-  start2 = (newrange2 && newrange2->starttime != NSTUNSET) ? newrange2->starttime : rec2->msr->starttime;
-
-  if (start1 > start2)
+  size_t runs = 0;
+  size_t start = 0;
+  size_t middle;
+  size_t end;
+  size_t left;
+  size_t right;
+  size_t out;
+
+  while (start < count)
   {
-    return 1;
+    /* Find end of first run and end of second run */
+    for (middle = start + 1; middle < count && keys[middle].key >= keys[middle - 1].key; middle++)
+      ;
+    for (end = middle; end < count && (end == middle || keys[end].key >= keys[end - 1].key); end++)
+      ;
+
+    left = start;
+    right = middle;
+    out = start;
+
+    while (left < middle && right < end)
+      temp[out++] = (keys[right].key < keys[left].key) ? keys[right++] : keys[left++];
+    while (left < middle)
+      temp[out++] = keys[left++];
+    while (right < end)
+      temp[out++] = keys[right++];
+
+    runs++;
+    start = end;
   }
 
-  return 0;
-} /* End of recordcmp() */
+  return runs;
+} /* End of mergeruns() */
 
 /***************************************************************************
  * Process the command line parameters.
@@ -1973,6 +3426,48 @@ processparam (int argcount, char **argvec)
     {
       bestversion = 0;
     }
+    else if (strcmp (argvec[optind], "-crc") == 0)
+    {
+      const char *policy = getoptval (argcount, argvec, optind++);
+
+      if (strcmp (policy, "read") == 0)
+      {
+        crcpolicy = 'r';
+      }
+      else if (strcmp (policy, "write") == 0)
+      {
+        crcpolicy = 'w';
+      }
+      else
+      {
+        ms_log (2, "Unrecognized CRC validation policy: %s\n", policy);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-spool") == 0)
+    {
+      spooldir = getoptval (argcount, argvec, optind++);
+    }
+    else if (strcmp (argvec[optind], "-prefetch") == 0)
+    {
+      prefetchconns = strtol (getoptval (argcount, argvec, optind++), &endptr, 10);
+
+      if (*endptr || prefetchconns < 0)
+      {
+        ms_log (2, "Invalid prefetch connection count: %s\n", argvec[optind]);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-iodepth") == 0)
+    {
+      iodepth = strtol (getoptval (argcount, argvec, optind++), &endptr, 10);
+
+      if (*endptr || iodepth < 0 || iodepth > 4096)
+      {
+        ms_log (2, "Invalid I/O queue depth: %s\n", argvec[optind]);
+        exit (1);
+      }
+    }
     else if (strcmp (argvec[optind], "-s") == 0)
     {
       selectfile = getoptval (argcount, argvec, optind++);
@@ -2035,6 +3530,20 @@ processparam (int argcount, char **argvec)
     {
       prunedata = 'e';
     }
+    else if (strcmp (argvec[optind], "-ms3") == 0)
+    {
+      convertv3 = 1;
+    }
+    else if (strcmp (argvec[optind], "-threads") == 0)
+    {
+      outputthreads = strtol (getoptval (argcount, argvec, optind++), &endptr, 10);
+
+      if (*endptr || outputthreads < 1 || outputthreads > 256)
+      {
+        ms_log (2, "Invalid thread count: %s\n", argvec[optind]);
+        exit (1);
+      }
+    }
     else if (strcmp (argvec[optind], "-Q") == 0)
     {
       tptr = getoptval (argcount, argvec, optind++);
@@ -2070,6 +3579,10 @@ processparam (int argcount, char **argvec)
     {
       writtenprefix = getoptval (argcount, argvec, optind++);
     }
+    else if (strcmp (argvec[optind], "-manifest") == 0)
+    {
+      manifestfile = getoptval (argcount, argvec, optind++);
+    }
     else if (strcmp (argvec[optind], "-CHAN") == 0)
     {
       if (addarchive (getoptval (argcount, argvec, optind++), CHANLAYOUT) == -1)
@@ -2239,8 +3752,9 @@ getoptval (int argcount, char **argvec, int argopt)
     if (strcmp (argvec[argopt + 1], "-") == 0)
       return argvec[argopt + 1];
 
-  /* Special case of '-out -' or '-out --' usage */
-  if ((argopt + 1) < argcount && strcmp (argvec[argopt], "-out") == 0)
+  /* Special case of '-out -', '-out --', '-manifest -' or '-manifest --' usage */
+  if ((argopt + 1) < argcount && (strcmp (argvec[argopt], "-out") == 0 ||
+                                  strcmp (argvec[argopt], "-manifest") == 0))
     if (strcmp (argvec[argopt + 1], "-") == 0 ||
         strcmp (argvec[argopt + 1], "--") == 0)
       return argvec[argopt + 1];
@@ -2308,6 +3822,8 @@ addfile (char *filename)
   Filelink *newlp;
   char *at;
   char *colon;
+  int filetype;
+  int rv;
 
   if (!filename)
   {
@@ -2346,21 +3862,241 @@ addfile (char *filename)
     return -1;
   }
 
-  /* Add new file to the end of the list */
-  if (filelisttail == NULL)
+  /* URLs are identified by scheme, "file://" is a local file */
+  if (strstr (newlp->infilename, "://") && strncasecmp (newlp->infilename, "file://", 7))
   {
-    filelist = newlp;
-    filelisttail = newlp;
+    newlp->isurl = 1;
   }
   else
   {
-    filelisttail->next = newlp;
-    filelisttail = newlp;
+    filetype = probefile (newlp->infilename);
+
+    newlp->iscompressed = (filetype == INPUT_COMPRESSED);
+
+    /* Tar bundles, without a byte range, are added as their members */
+    if (filetype == INPUT_TARBUNDLE && !at)
+    {
+      rv = addtarbundle (newlp->infilename);
+
+      free (newlp->infilename_raw);
+      free (newlp->infilename);
+      free (newlp);
+
+      return (rv < 0) ? -1 : 0;
+    }
   }
 
+  appendfile (newlp);
+
   return 0;
 } /* End of addfile() */
 
+
+/***************************************************************************
+ * Add an entry to the end of the global input file list.
+ ***************************************************************************/
+static void
+appendfile (Filelink *lp)
+{
+  if (filelisttail == NULL)
+  {
+    filelist = lp;
+    filelisttail = lp;
+  }
+  else
+  {
+    filelisttail->next = lp;
+    filelisttail = lp;
+  }
+} /* End of appendfile() */
+
+
+/***************************************************************************
+ * Parse a numeric tar header field, either octal or base-256 (GNU
+ * extension for large values) when the high bit of the first byte is
+ * set.
+ *
+ * Returns the value.
+ ***************************************************************************/
+static int64_t
+tarnumber (const unsigned char *field, int length)
+{
+  int64_t value = 0;
+  int idx;
+
+  if (field[0] & 0x80)
+  {
+    value = field[0] & 0x7f;
+    for (idx = 1; idx < length; idx++)
+      value = (value << 8) | field[idx];
+
+    return value;
+  }
+
+  for (idx = 0; idx < length && field[idx] == ' '; idx++)
+    ;
+
+  for (; idx < length && field[idx] >= '0' && field[idx] <= '7'; idx++)
+    value = (value << 3) | (field[idx] - '0');
+
+  return value;
+} /* End of tarnumber() */
+
+
+/***************************************************************************
+ * Verify a tar header block checksum, calculated with the checksum
+ * field itself treated as spaces.
+ *
+ * Returns 1 if valid and 0 otherwise.
+ ***************************************************************************/
+static int
+tarchecksum (const unsigned char *header)
+{
+  int64_t sum = 0;
+  int idx;
+
+  for (idx = 0; idx < TARBLOCKSIZE; idx++)
+    sum += (idx >= 148 && idx < 156) ? ' ' : header[idx];
+
+  return (sum == tarnumber (header + 148, 8));
+} /* End of tarchecksum() */
+
+
+/***************************************************************************
+ * Add the members of a tar bundle to the global input file list.
+ *
+ * The member headers are indexed once and each regular file member is
+ * added as a byte range input of the bundle, i.e. "bundle.tar@start-end",
+ * so that data are read directly from the bundle without extraction.
+ * All members share the input stream of the first member when writing
+ * output.  POSIX (pax) size records and GNU long names are supported.
+ *
+ * Returns count of members added on success and -1 on error.
+ ***************************************************************************/
+static int
+addtarbundle (const char *filename)
+{
+  unsigned char header[TARBLOCKSIZE];
+  char rangename[1024];
+  char *paxdata = NULL;
+  char *paxsize;
+  const char *path = filename;
+  Filelink *first = NULL;
+  Filelink *newlp;
+  int64_t offset = 0;
+  int64_t size;
+  int64_t membersize = -1;
+  int count = 0;
+  char typeflag;
+  FILE *fp;
+
+  if (!strncasecmp (path, "file://", 7))
+    path += 7;
+
+  if (verbose >= 1)
+    ms_log (1, "Indexing tar bundle '%s'\n", filename);
+
+  if (!(fp = fopen (path, "rb")))
+  {
+    ms_log (2, "Cannot open tar bundle %s: %s\n", filename, strerror (errno));
+    return -1;
+  }
+
+  while (fread (header, sizeof (header), 1, fp) == 1)
+  {
+    offset += TARBLOCKSIZE;
+
+    /* End of archive is marked with zero blocks */
+    if (header[0] == '\0')
+      break;
+
+    if (!tarchecksum (header))
+    {
+      ms_log (2, "Invalid tar header in %s at offset %" PRId64 "\n", filename, offset - TARBLOCKSIZE);
+      count = -1;
+      break;
+    }
+
+    size = tarnumber (header + 124, 12);
+    typeflag = header[156];
+
+    /* POSIX extended header for the next member, may contain the size */
+    if (typeflag == 'x' && size > 0 && size < 1048576)
+    {
+      if (!(paxdata = (char *)malloc (size + 1)) || fread (paxdata, size, 1, fp) != 1)
+      {
+        ms_log (2, "Cannot read tar extended header in %s\n", filename);
+        free (paxdata);
+        count = -1;
+        break;
+      }
+      paxdata[size] = '\0';
+
+      /* Records are "length keyword=value\n" */
+      if ((paxsize = strstr (paxdata, " size=")))
+        membersize = strtoll (paxsize + 6, NULL, 10);
+
+      free (paxdata);
+      paxdata = NULL;
+    }
+    /* Regular file members */
+    else if (typeflag == '0' || typeflag == '\0' || typeflag == '7')
+    {
+      if (membersize >= 0)
+        size = membersize;
+
+      if (size > 0)
+      {
+        snprintf (rangename, sizeof (rangename), "%s@%" PRId64 "-%" PRId64,
+                  filename, offset, offset + size - 1);
+
+        if (verbose > 1)
+          ms_log (1, "Adding tar member '%.100s' as '%s'\n", header, rangename);
+
+        if (!(newlp = (Filelink *)calloc (1, sizeof (Filelink))) ||
+            !(newlp->infilename_raw = strdup (rangename)) ||
+            !(newlp->infilename = strdup (filename)))
+        {
+          ms_log (2, "%s(): Cannot allocate memory, out of memory?\n", __func__);
+          count = -1;
+          break;
+        }
+
+        if (!first)
+          first = newlp;
+        newlp->bundle = first;
+
+        appendfile (newlp);
+        count++;
+      }
+
+      membersize = -1;
+    }
+    /* Other member types, GNU long names apply to the next member */
+    else if (typeflag != 'L' && typeflag != 'K' && typeflag != 'g')
+    {
+      membersize = -1;
+    }
+
+    /* Skip member data, padded to block size */
+    offset += (size + TARBLOCKSIZE - 1) / TARBLOCKSIZE * TARBLOCKSIZE;
+
+    if (lmp_fseek64 (fp, offset, SEEK_SET))
+    {
+      ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", filename, offset);
+      count = -1;
+      break;
+    }
+  }
+
+  fclose (fp);
+
+  if (verbose >= 1 && count >= 0)
+    ms_log (1, "Added %d member(s) of tar bundle '%s'\n", count, filename);
+
+  return count;
+} /* End of addtarbundle() */
+
 /***************************************************************************
  * Add files listed in the specified file to the global input file list.
  *
@@ -2455,7 +4191,10 @@ addarchive (const char *path, const char *layout)
     snprintf (newarch->datastream.path, pathlayout, "%s", path);
 
   newarch->datastream.idletimeout = 60;
+  newarch->datastream.digest = 0;
+  newarch->datastream.daycache = (MSDayCache)MSDayCache_INITIALIZER;
   newarch->datastream.grouproot = NULL;
+  newarch->datastream.fileroot = NULL;
 
   newarch->next = archiveroot;
   archiveroot = newarch;
@@ -2464,6 +4203,172 @@ addarchive (const char *path, const char *layout)
 } /* End of addarchive() */
 
 
+/***************************************************************************
+ * Set the directory for spooling input when any input is a URL or a
+ * compressed file.
+ *
+ * Records are read twice, once to construct the trace list and again
+ * when writing output.  The library spools URL and decompressed data
+ * to local files during the first read, which are then used for the
+ * second.  If no spool directory was specified a temporary directory
+ * is created and removed at exit.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+setspooldir (void)
+{
+  Filelink *flp;
+  const char *tmpdir;
+
+  for (flp = filelist; flp; flp = flp->next)
+    if (flp->isurl || flp->iscompressed)
+      break;
+
+  if (!flp)
+    return 0;
+
+  if (!spooldir)
+  {
+    if (!(tmpdir = getenv ("TMPDIR")))
+      tmpdir = "/tmp";
+
+    snprintf (spooltempdir, sizeof (spooltempdir), "%s/%s-spool-XXXXXX", tmpdir, PACKAGE);
+
+    if (!mkdtemp (spooltempdir))
+    {
+      ms_log (2, "Cannot create spool directory %s: %s\n", spooltempdir, strerror (errno));
+      spooltempdir[0] = '\0';
+      return -1;
+    }
+
+    atexit (cleanspooldir);
+    spooldir = spooltempdir;
+  }
+
+  if (verbose > 1)
+    ms_log (1, "Spooling URL and compressed input in %s\n", spooldir);
+
+  if (ms3_url_spooldir (spooldir))
+    return -1;
+
+  return 0;
+} /* End of setspooldir() */
+
+/***************************************************************************
+ * Fetch all URL input concurrently into the spool directory.
+ *
+ * URLs that cannot be prefetched are fetched when read, where any
+ * errors are reported.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+prefetchurls (void)
+{
+  Filelink *flp;
+  const char **urls;
+  int urlcount = 0;
+  int spooled;
+
+  if (prefetchconns <= 0)
+    return 0;
+
+  for (flp = filelist; flp; flp = flp->next)
+    if (flp->isurl)
+      urlcount++;
+
+  if (urlcount == 0)
+    return 0;
+
+  if (!(urls = (const char **)malloc (sizeof (char *) * urlcount)))
+  {
+    ms_log (2, "%s(): Cannot allocate memory, out of memory?\n", __func__);
+    return -1;
+  }
+
+  urlcount = 0;
+  for (flp = filelist; flp; flp = flp->next)
+    if (flp->isurl)
+      urls[urlcount++] = flp->infilename_raw;
+
+  spooled = ms3_url_prefetch (urls, urlcount, prefetchconns, PREFETCHSPLITSIZE, verbose);
+
+  if (verbose && spooled >= 0)
+    ms_log (1, "Prefetched %d of %d URL(s)\n", spooled, urlcount);
+
+  free (urls);
+
+  return 0;
+} /* End of prefetchurls() */
+
+/***************************************************************************
+ * Remove the temporary spool directory and its contents.
+ ***************************************************************************/
+static void
+cleanspooldir (void)
+{
+  char path[sizeof (spooltempdir) + 256];
+  struct dirent *de;
+  DIR *dir;
+
+  if (!spooltempdir[0])
+    return;
+
+  if ((dir = opendir (spooltempdir)))
+  {
+    while ((de = readdir (dir)))
+    {
+      if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, ".."))
+        continue;
+
+      snprintf (path, sizeof (path), "%s/%s", spooltempdir, de->d_name);
+      remove (path);
+    }
+
+    closedir (dir);
+  }
+
+  if (rmdir (spooltempdir))
+    ms_log (1, "Cannot remove spool directory %s: %s\n", spooltempdir, strerror (errno));
+} /* End of cleanspooldir() */
+
+
+/***************************************************************************
+ * Determine the type of an input file from content: gzip or zstd
+ * compressed by magic bytes, or a tar bundle by a valid ustar header.
+ *
+ * Returns INPUT_COMPRESSED, INPUT_TARBUNDLE or INPUT_PLAIN, including
+ * when the file cannot be read.
+ ***************************************************************************/
+static int
+probefile (const char *filename)
+{
+  unsigned char header[TARBLOCKSIZE];
+  size_t length;
+  FILE *fp;
+
+  if (!strncasecmp (filename, "file://", 7))
+    filename += 7;
+
+  if (!strcmp (filename, "-") || !(fp = fopen (filename, "rb")))
+    return INPUT_PLAIN;
+
+  length = fread (header, 1, sizeof (header), fp);
+  fclose (fp);
+
+  if (length >= 2 && header[0] == 0x1f && header[1] == 0x8b)
+    return INPUT_COMPRESSED;
+
+  if (length >= 4 && header[0] == 0x28 && header[1] == 0xb5 && header[2] == 0x2f && header[3] == 0xfd)
+    return INPUT_COMPRESSED;
+
+  if (length == TARBLOCKSIZE && !memcmp (header + 257, "ustar", 5) && tarchecksum (header))
+    return INPUT_TARBUNDLE;
+
+  return INPUT_PLAIN;
+} /* End of probefile() */
+
 /***************************************************************************
  * Print the usage message.
  ***************************************************************************/
@@ -2482,6 +4387,10 @@ usage (int level)
            " -rt diff     Specify a sample rate tolerance for continuous traces\n"
            " -snd         Skip non-miniSEED data, otherwise quit on unrecognized input\n"
            " -E           Consider all qualities equal instead of 'best' prioritization\n"
+           " -crc policy  Validate CRCs when 'read' (default) or only records to 'write'\n"
+           " -spool dir   Spool URL and decompressed input in dir\n"
+           " -prefetch #  Fetch URL input concurrently with # connections, default 4\n"
+           " -iodepth #   Keep # file reads in flight with io_uring, default 0 (synchronous)\n"
            "\n"
            " ## Data selection options ##\n"
            " -s file      Specify a file containing selection criteria\n"
@@ -2498,10 +4407,13 @@ usage (int level)
            " -Ps          Prune data at the sample level using 'best' version priority\n"
            " -Pe          Prune traces at user specified edges only, leave overlaps\n"
            " -Q #DRQM     Specify publication version of all output records\n"
+           " -ms3         Convert miniSEED 2 records to miniSEED 3 on output\n"
+           " -threads #   Write a single output file with # threads, default 1\n"
            "\n"
            " ## Logging ##\n"
            " -out file    Write a summary of output records to specified file\n"
            " -outprefix X Include prefix on summary output lines for identification\n"
+           " -manifest file Write a manifest with digests of output files\n"
            "\n"
            " ## Input data ##\n"
            " file#        Files(s) of miniSEED records\n"
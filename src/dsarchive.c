@@ -57,16 +57,22 @@ static int dsverbose;
  *
  * Save miniSEED records in a custom directory/file structure.  The
  * appropriate directories and files are created if nesecessary.  If
- * files already exist they are appended to.  If 'msr' is NULL then
- * ds_shutdown() will be called to close all open files and free all
- * associated memory.
+ * files already exist they are appended to.  The 'record' of 'reclen'
+ * bytes is written, 'msr' provides the values used to build the file
+ * path and name.  If 'msr' is NULL then ds_shutdown() will be called
+ * to close all open files and free all associated memory.
+ *
+ * If 'datastream->digest' is set a DataStreamFile is maintained in
+ * 'datastream->fileroot' for each file written, with a digest that is
+ * updated as each record is written.
  *
  * NOTE: the expand_code() callback function is not yet implemented.
  *
  * Returns 0 on success, -1 on error.
  ***************************************************************************/
 int
-ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
+ds_streamproc (DataStream *datastream, MS3Record *msr,
+               const char *record, int reclen, int verbose,
                int (expand_code) (const char *code, MS3Record *msr,
                                   char *expanded, int expandedlen))
 {
@@ -89,6 +95,7 @@ ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
   char pathformat[600] = {0};
   char tstr[20] = {0};
   int fnlen = 0;
+  ssize_t written;
 
   /* Set Verbosity for ds_ functions */
   dsverbose = verbose;
@@ -134,7 +141,8 @@ ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
   }
 
   /* Decompose start time to date-time values */
-  if (ms_nstime2time (msr->starttime, &year, &yday, &hour, &min, &sec, &nsec))
+  if (ms_nstime2time_cached (msr->starttime, &datastream->daycache,
+                             &year, &yday, &hour, &min, &sec, &nsec))
   {
     fprintf (stderr, "%s(): cannot convert start time to separate fields\n", __func__);
     strparse (NULL, NULL, &fnlist);
@@ -300,7 +308,7 @@ ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
         p = w + 1;
         break;
       case 'L':
-        snprintf (tstr, sizeof (tstr), "%d", msr->reclen);
+        snprintf (tstr, sizeof (tstr), "%d", reclen);
         strncat (filename, tstr, (sizeof (filename) - fnlen));
         if (def)
           strncat (definition, tstr, (sizeof (definition) - fnlen));
@@ -386,39 +394,24 @@ ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
 
   if (foundgroup != NULL)
   {
-    /* Write binary data samples to approriate file */
-    if (msr->datasamples && msr->numsamples)
-    {
-      if (dsverbose >= 3)
-        fprintf (stderr, "Writing binary data samples to data stream file %s\n", filename);
-
-      if (!write (foundgroup->filed, msr->datasamples, msr->numsamples * ms_samplesize (msr->sampletype)))
-      {
-        fprintf (stderr, "%s(): failed to write binary data samples\n", __func__);
-        return -1;
-      }
-      else
-      {
-        foundgroup->modtime = time (NULL);
-      }
-    }
     /* Write the data record to the appropriate file */
-    else
-    {
-      if (dsverbose >= 3)
-        fprintf (stderr, "Writing data record to data stream file %s\n", filename);
+    if (dsverbose >= 3)
+      fprintf (stderr, "Writing data record to data stream file %s\n", filename);
 
-      if (!write (foundgroup->filed, msr->record, msr->reclen))
-      {
-        fprintf (stderr, "%s: failed to write data record\n", __func__);
-        return -1;
-      }
-      else
-      {
-        foundgroup->modtime = time (NULL);
-      }
+    if ((written = write (foundgroup->filed, record, reclen)) != reclen)
+    {
+      fprintf (stderr, "%s: failed to write data record to %s: %s\n", __func__, filename,
+               (written < 0) ? strerror (errno) : "short write");
+      return -1;
     }
 
+    foundgroup->modtime = time (NULL);
+
+    /* Update running digest of file content after a complete write */
+    if (foundgroup->file &&
+        ds_fileupdate (foundgroup->file, msr, record, reclen))
+      return -1;
+
     return 0;
   }
 
@@ -494,6 +487,7 @@ ds_getstream (DataStream *datastream, const char *defkey, const char *filename)
     foundgroup->defkey = strdup (defkey);
     foundgroup->filed = 0;
     foundgroup->modtime = -curtime;
+    foundgroup->file = NULL;
     foundgroup->next = NULL;
 
     /* Set the stream root if this is the first entry */
@@ -521,6 +515,32 @@ ds_getstream (DataStream *datastream, const char *defkey, const char *filename)
   {
     off_t filepos;
 
+    /* Find or start digest of file content, persistent across file closures */
+    if (datastream->digest && !foundgroup->file)
+    {
+      DataStreamFile *file = datastream->fileroot;
+      DataStreamFile *prevfile = NULL;
+
+      while (file && strcmp (file->path, filename))
+      {
+        prevfile = file;
+        file = file->next;
+      }
+
+      if (!file)
+      {
+        if ((file = ds_fileinit (filename)) == NULL)
+          return NULL;
+
+        if (prevfile)
+          prevfile->next = file;
+        else
+          datastream->fileroot = file;
+      }
+
+      foundgroup->file = file;
+    }
+
     if (dsverbose >= 1)
       fprintf (stderr, "Opening data stream file %s\n", filename);
 
@@ -542,6 +562,186 @@ ds_getstream (DataStream *datastream, const char *defkey, const char *filename)
   return foundgroup;
 } /* End of ds_getstream() */
 
+/***************************************************************************
+ * ds_fileinit:
+ *
+ * Allocate and initialize a DataStreamFile for tracking the digest
+ * and content of the specified output file.  If the file already
+ * exists, e.g. it will be appended to, the digest and byte count are
+ * seeded from the existing content so they describe the complete
+ * file, while the record count, time span and SIDs describe only the
+ * records added with ds_fileupdate().
+ *
+ * Returns a pointer to a DataStreamFile on success or NULL on error.
+ ***************************************************************************/
+DataStreamFile *
+ds_fileinit (const char *path)
+{
+  DataStreamFile *file;
+  struct stat sb;
+  uint8_t buffer[65536];
+  ssize_t readbytes;
+  int fd;
+
+  if (!path)
+    return NULL;
+
+  if ((file = (DataStreamFile *)calloc (1, sizeof (DataStreamFile))) == NULL ||
+      (file->path = strdup (path)) == NULL)
+  {
+    fprintf (stderr, "%s(): ERROR, Cannot allocate memory for DataStreamFile\n",
+             __func__);
+    free (file);
+    return NULL;
+  }
+
+  file->starttime = NSTUNSET;
+  file->endtime = NSTUNSET;
+
+  /* Seed digest with existing content of a regular file */
+  if (stat (path, &sb) == 0 && S_ISREG (sb.st_mode) && sb.st_size > 0)
+  {
+    if (dsverbose >= 1)
+      fprintf (stderr, "Reading existing content of %s for digest\n", path);
+
+    if ((fd = open (path, O_RDONLY)) == -1)
+    {
+      fprintf (stderr, "%s(): ERROR, cannot open %s, %s\n",
+               __func__, path, strerror (errno));
+      free (file->path);
+      free (file);
+      return NULL;
+    }
+
+    while ((readbytes = read (fd, buffer, sizeof (buffer))) > 0)
+    {
+      file->crc32c = ms_crc32c (buffer, (int)readbytes, file->crc32c);
+      file->bytes += readbytes;
+    }
+
+    close (fd);
+
+    if (readbytes < 0)
+    {
+      fprintf (stderr, "%s(): ERROR, cannot read %s, %s\n",
+               __func__, path, strerror (errno));
+      free (file->path);
+      free (file);
+      return NULL;
+    }
+  }
+
+  return file;
+} /* End of ds_fileinit() */
+
+/***************************************************************************
+ * ds_fileupdate:
+ *
+ * Update the digest and content summary of a DataStreamFile with a
+ * record of 'reclen' bytes that was written to the file, 'msr'
+ * provides the SID and time span of the record.
+ *
+ * Returns 0 on success, -1 on error.
+ ***************************************************************************/
+int
+ds_fileupdate (DataStreamFile *file, MS3Record *msr,
+               const char *record, int reclen)
+{
+  if (!file || !msr || !record || reclen <= 0)
+    return -1;
+
+  file->crc32c = ms_crc32c ((const uint8_t *)record, reclen, file->crc32c);
+  file->bytes += reclen;
+
+  return ds_filerecord (file, msr);
+} /* End of ds_fileupdate() */
+
+/***************************************************************************
+ * ds_fileappend:
+ *
+ * Update the digest of a DataStreamFile with 'length' bytes written to
+ * the end of the file, given their CRC32C calculated separately.  The
+ * records written are added to the content summary with
+ * ds_filerecord().
+ *
+ * Returns 0 on success, -1 on error.
+ ***************************************************************************/
+int
+ds_fileappend (DataStreamFile *file, uint32_t crc32c, int64_t length)
+{
+  if (!file || length < 0)
+    return -1;
+
+  file->crc32c = ms_crc32c_combine (file->crc32c, crc32c, (uint64_t)length);
+  file->bytes += length;
+
+  return 0;
+} /* End of ds_fileappend() */
+
+/***************************************************************************
+ * ds_filerecord:
+ *
+ * Update the content summary of a DataStreamFile with a record written
+ * to the file, 'msr' provides the SID and time span of the record.
+ *
+ * Returns 0 on success, -1 on error.
+ ***************************************************************************/
+int
+ds_filerecord (DataStreamFile *file, MS3Record *msr)
+{
+  nstime_t endtime;
+  size_t sidlen;
+  size_t length;
+  char *sids;
+  char *cp;
+
+  if (!file || !msr)
+    return -1;
+
+  file->records++;
+
+  endtime = msr3_endtime (msr);
+
+  if (file->starttime == NSTUNSET || msr->starttime < file->starttime)
+    file->starttime = msr->starttime;
+
+  if (file->endtime == NSTUNSET || endtime > file->endtime)
+    file->endtime = endtime;
+
+  /* Records usually arrive grouped by SID, only search the list when
+   * the SID differs from that of the previous record */
+  if (file->sids && !strcmp (msr->sid, file->lastsid))
+    return 0;
+
+  memcpy (file->lastsid, msr->sid, sizeof (file->lastsid));
+
+  /* Add SID to comma-separated list if not already present */
+  sidlen = strlen (msr->sid);
+  for (cp = file->sids; cp; cp = strchr (cp, ','))
+  {
+    if (*cp == ',')
+      cp++;
+
+    if (!strncmp (cp, msr->sid, sidlen) && (cp[sidlen] == ',' || cp[sidlen] == '\0'))
+      return 0;
+  }
+
+  length = (file->sids) ? strlen (file->sids) + 1 : 0;
+
+  if ((sids = (char *)realloc (file->sids, length + sidlen + 1)) == NULL)
+  {
+    fprintf (stderr, "%s(): ERROR, Cannot allocate memory for SID list\n", __func__);
+    return -1;
+  }
+
+  if (length)
+    sids[length - 1] = ',';
+  memcpy (sids + length, msr->sid, sidlen + 1);
+  file->sids = sids;
+
+  return 0;
+} /* End of ds_filerecord() */
+
 /***************************************************************************
  * ds_openfile:
  *
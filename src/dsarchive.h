@@ -16,11 +16,27 @@
 #define CSSLAYOUT   "%Y/%j/%s.%c.%Y:%j:#H:#M:#S"
 #define SDSLAYOUT   "%Y/%n/%s/%c.D/%n.%s.%l.%c.D.%Y.%j"
 
+/* Running digest and summary of the content of an output file */
+typedef struct DataStreamFile_s
+{
+  char    *path;
+  uint64_t bytes;
+  uint64_t records;
+  uint32_t crc32c;
+  nstime_t starttime;
+  nstime_t endtime;
+  char    *sids;
+  char     lastsid[LM_SIDLEN]; /* SID of the last record, in sids */
+  struct  DataStreamFile_s *next;
+}
+DataStreamFile;
+
 typedef struct DataStreamGroup_s
 {
   char   *defkey;
   int     filed;
   time_t  modtime;
+  struct  DataStreamFile_s *file;
   struct  DataStreamGroup_s *next;
 }
 DataStreamGroup;
@@ -29,15 +45,25 @@ typedef struct DataStream_s
 {
   char   *path;
   int     idletimeout;
+  int     digest;
+  MSDayCache daycache;
   struct  DataStreamGroup_s *grouproot;
+  struct  DataStreamFile_s *fileroot;
 }
 DataStream;
 
 /* Maximum number of open files for all DataStreams */
 extern int ds_maxopenfiles;
 
-extern int ds_streamproc (DataStream *datastream, MS3Record *msr, int verbose,
+extern int ds_streamproc (DataStream *datastream, MS3Record *msr,
+                          const char *record, int reclen, int verbose,
                           int (expand_code) (const char *code, MS3Record *msr,
                                              char *expanded, int expandedlen));
 
+extern DataStreamFile *ds_fileinit (const char *path);
+extern int ds_fileupdate (DataStreamFile *file, MS3Record *msr,
+                          const char *record, int reclen);
+extern int ds_fileappend (DataStreamFile *file, uint32_t crc32c, int64_t length);
+extern int ds_filerecord (DataStreamFile *file, MS3Record *msr);
+
 #endif /* DSARCHIVE_H */